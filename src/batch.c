@@ -0,0 +1,191 @@
+//-----------------------------------------------------
+//
+// BATCH: RUN A CORPUS OF THROW SCENARIOS ON A POOL OF WORKERS
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ptask.h"
+#include "spsc.h"
+#include "scn.h"
+
+#define BATCH_MAXWORKER	64			// max worker threads
+#define BATCH_CLAIM		16			// scenarios claimed at once by a worker
+#define BATCH_QLEN		1024		// results a worker ring holds (power of 2)
+#define BATCH_POLL		1			// wait of reader when rings are empty (ms)
+
+struct batch {						// corpus shared by workers
+	const struct scn* sc;			// scenarios
+	uint32_t n;						// number of scenarios
+	_Atomic uint32_t next;			// next scenario to be claimed
+	struct 	spsc* out[BATCH_MAXWORKER];	// results of each worker
+};
+
+struct worker {						// argument of a worker
+	struct 	batch* b;				// corpus
+	int 	id;						// worker index
+};
+
+//--------------------------------
+// PRIVATE: WORKERS
+//--------------------------------
+
+// ---
+// Return the current time of the monotonic clock in seconds
+// return: double - seconds elapsed from an unspecified point
+// ---
+static double now() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1E9;
+}
+
+// ---
+// Worker: claim BATCH_CLAIM scenarios at a time until none is left and
+// push a result for each one in its own ring
+// void* arg: pointer to worker
+// return: void
+// ---
+static void* batch_worker(void* arg) {
+	struct 	worker* w = arg;		// worker
+	struct 	batch* b = w->b;		// corpus
+	struct 	scn_result r;			// result of a scenario
+	uint32_t first, i;				// first scenario claimed, scenario
+
+	while((first = atomic_fetch_add(&b->next, BATCH_CLAIM)) < b->n)
+		for(i = first; i < first + BATCH_CLAIM && i < b->n; i++) {
+			r.idx = i;
+			scn_run(&b->sc[i], &r);
+			while(spsc_push(b->out[w->id], &r))
+				sched_yield();
+		}
+	return NULL;
+}
+
+//--------------------------------
+// PRIVATE: RESULTS
+//--------------------------------
+
+// ---
+// Print a result as soon as it arrives
+// scn* sc: pointer to scenario
+// scn_result* r: pointer to result
+// return: void
+// ---
+static void print_result(const struct scn* sc, struct scn_result* r) {
+	printf("%s %s %s %s %.3f %.2f\n", sc->name,
+		scn_outcome_name(r->outcome), scn_outcome_name(sc->expect),
+		r->pass ? "PASS" : "FAIL", r->miss, r->t);
+}
+
+// ---
+// Print what the corpus gave and how fast
+// long* num: results of each SIM_* outcome
+// long fail: scenarios failed
+// uint32_t n: number of scenarios
+// int workers: number of workers
+// double sim_t: simulated time of every scenario (s)
+// double wall: time taken (s)
+// return: void
+// ---
+static void batch_report(long* num, long fail, uint32_t n, int workers,
+		double sim_t, double wall) {
+	printf("-----------------------------------------------\n");
+	printf("BATCH OF SCENARIOS:\n");
+	printf("\tscenarios: %u - workers: %d\n", n, workers);
+	printf("\tcaught: %ld - missed: %ld - timeout: %ld\n",
+		num[SIM_CAUGHT], num[SIM_MISSED], num[SIM_TIMEOUT]);
+	printf("\tpassed: %ld - failed: %ld\n", n - fail, fail);
+	printf("\twall: %.3f s - %.0f scenarios/s - %.0fx real time\n",
+		wall, n / wall, sim_t / wall);
+	printf("-----------------------------------------------\n");
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+// ---
+// Print command line usage
+// char* name: program name
+// return: void
+// ---
+static void usage(char* name) {
+	printf("usage: %s [-w workers] [-f] scenario_file\n", name);
+}
+
+int main(int argc, char** argv) {
+	static struct batch b;			// corpus
+	struct 	worker w[BATCH_MAXWORKER];	// workers
+	struct 	scn_result r;			// result of a scenario
+	pthread_t id;					// worker id
+	long 	num[SIM_TIMEOUT + 1] = {0};	// results of each outcome
+	long 	fail = 0;				// scenarios failed
+	double 	t0, sim_t = 0;			// start time, simulated time (s)
+	uint32_t got = 0;				// results received
+	int 	workers, only_fail = 0;	// number of workers, print failed only
+	int 	opt, i, any;			// option, worker, results in a poll
+
+	// -w: number of workers, -f: print failed scenarios only
+	workers = sysconf(_SC_NPROCESSORS_ONLN);
+	while((opt = getopt(argc, argv, "w:f")) != -1) {
+		switch(opt) {
+			case 'w':
+				workers = atoi(optarg);
+				break;
+			case 'f':
+				only_fail = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	if(workers < 1)
+		workers = 1;
+	if(workers > BATCH_MAXWORKER)
+		workers = BATCH_MAXWORKER;
+
+	b.sc = scn_load(argv[optind], &b.n);
+	if(b.sc == NULL)
+		return 1;
+
+	t0 = now();
+	for(i = 0; i < workers; i++) {
+		b.out[i] = spsc_create(NULL, BATCH_QLEN, sizeof(struct scn_result));
+		w[i].b = &b;
+		w[i].id = i;
+		bg_task_create(&id, batch_worker, &w[i]);
+	}
+
+	// results streamed in order of completion
+	printf("# name outcome expect result miss_m time_s\n");
+	while(got < b.n) {
+		any = 0;
+		for(i = 0; i < workers; i++)
+			while(spsc_pop(b.out[i], &r) == 0) {
+				any = 1;
+				got++;
+				num[r.outcome]++;
+				sim_t += r.t;
+				fail += !r.pass;
+				if(!only_fail || !r.pass)
+					print_result(&b.sc[r.idx], &r);
+			}
+		if(!any)
+			usleep(BATCH_POLL * 1000);
+	}
+
+	batch_report(num, fail, b.n, workers, sim_t, now() - t0);
+	return fail ? 1 : 0;
+}
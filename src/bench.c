@@ -0,0 +1,495 @@
+//-----------------------------------------------------
+//
+// BENCH: MICROBENCHMARKS OF PHYSICS, CONTROLLER AND UDP ENCODING
+//
+//-----------------------------------------------------
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "physics.h"
+#include "udp.h"
+#include "sim.h"
+#include "scn.h"
+
+#define BENCH_CORPUS	4096		// states of corpus (ops of a pass)
+#define BENCH_STRIDE	3			// ticks of a rollout between two samples
+#define BENCH_WARMUP	200			// ms of warmup of each benchmark
+#define BENCH_REPS		21			// timed repetitions of each benchmark
+#define BENCH_REP_NS	2000000		// min time of a repetition (ns)
+#define BENCH_NOISE		5.0			// default regression threshold (%)
+#define BENCH_SIGMA		3.0			// noise multiples also required (MAD)
+#define BENCH_MAXLEN	(64 << 10)	// max length of a baseline file (byte)
+#define BENCH_SCN		"regress.scn"	// default scenarios of corpus
+
+struct corpus {						// realistic inputs, one entry an op
+	int 	n;						// entries
+	struct 	dstate d[BENCH_CORPUS];	// drone states
+	struct 	bstate b[BENCH_CORPUS];	// ball states
+	struct 	cstate c[BENCH_CORPUS];	// controller states
+	float 	des_ang[BENCH_CORPUS][SP_DIM];	// attitude for stabilization
+	float 	th[BENCH_CORPUS];		// thrust for stabilization
+};
+
+struct work {						// copies of corpus changed by a pass
+	struct 	dstate d[BENCH_CORPUS];	// drone states
+	struct 	bstate b[BENCH_CORPUS];	// ball states
+	struct 	cstate c[BENCH_CORPUS];	// controller states
+	float 	out[BENCH_CORPUS][SP_DIM];	// catch points predicted
+	struct 	udp_graph_data pk[BENCH_CORPUS];	// packets encoded
+	int 	sink;					// collisions counted
+};
+
+struct bench {						// a benchmark
+	const char* name;				// function measured
+	void 	(*pass)(int n);			// run the function on n entries
+};
+
+struct result {						// statistics of a benchmark
+	const char* name;				// function measured
+	double 	ns_op;					// median time of an op (ns)
+	double 	ns_min;					// min time of an op (ns)
+	double 	cyc_op;					// median cycles of an op (0 if none)
+	double 	noise;					// median absolute deviation / median
+};
+
+static struct corpus cp;			// inputs
+static struct work wk;				// inputs being changed
+
+//--------------------------------
+// PRIVATE: PASSES (one call per entry of corpus)
+//--------------------------------
+
+// ---
+// Step drone states with their controller (d_up_state)
+// int n: number of entries
+// return: void
+// ---
+static void pass_d_up_state(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		d_up_state(&wk.d[i], &wk.c[i], SIM_DRN_PER / 1000.0);
+}
+
+// ---
+// Step ball states with their drone (b_up_state)
+// int n: number of entries
+// return: void
+// ---
+static void pass_b_up_state(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		b_up_state(&wk.b[i], &wk.d[i], SIM_BLL_PER / 1000.0);
+}
+
+// ---
+// Check collision of ball states with their drone (b_check_collision)
+// int n: number of entries
+// return: void
+// ---
+static void pass_b_check_collision(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		wk.sink += b_check_collision(&wk.b[i], &wk.d[i]);
+}
+
+// ---
+// Predict catch point of ball states (c_calc_ball_pos)
+// int n: number of entries
+// return: void
+// ---
+static void pass_c_calc_ball_pos(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		c_calc_ball_pos(wk.b[i].position, wk.b[i].velocity, DFINALH, wk.out[i]);
+}
+
+// ---
+// Drive drone states towards their ball (c_driver_control)
+// int n: number of entries
+// return: void
+// ---
+static void pass_c_driver_control(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		c_driver_control(&wk.d[i], &wk.b[i], &wk.c[i]);
+}
+
+// ---
+// Stabilize drone states to their attitude (c_stab_control)
+// int n: number of entries
+// return: void
+// ---
+static void pass_c_stab_control(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		c_stab_control(&wk.d[i], &wk.c[i], cp.des_ang[i], cp.th[i]);
+}
+
+// ---
+// Encode graphic packets of drone and ball states (udp_grap_pack)
+// int n: number of entries
+// return: void
+// ---
+static void pass_udp_grap_pack(int n) {
+	int 	i;	// entry of corpus
+
+	for(i = 0; i < n; i++)
+		udp_grap_pack(&wk.pk[i], -1, wk.d[i].fx_lin_pos, wk.d[i].fx_ang_pos,
+			wk.b[i].position);
+}
+
+static const struct bench benches[] = {
+	{"d_up_state", pass_d_up_state},
+	{"b_up_state", pass_b_up_state},
+	{"b_check_collision", pass_b_check_collision},
+	{"c_calc_ball_pos", pass_c_calc_ball_pos},
+	{"c_driver_control", pass_c_driver_control},
+	{"c_stab_control", pass_c_stab_control},
+	{"udp_grap_pack", pass_udp_grap_pack},
+	{NULL, NULL}};
+
+//--------------------------------
+// PRIVATE: CORPUS
+//--------------------------------
+
+// ---
+// Fill corpus with the states met by the rollouts of scenarios, a sample
+// every BENCH_STRIDE ticks, scenarios run again until corpus is full
+// scn* sc: scenarios
+// uint32_t nsc: number of scenarios
+// return: void
+// ---
+static void corpus_fill(const struct scn* sc, uint32_t nsc) {
+	struct 	sim s;		// rollout of a scenario
+	uint32_t k;			// scenario
+	int 	i, prev;	// rotor or axis, entries before a round
+
+	do {
+		prev = cp.n;
+		for(k = 0; k < nsc && cp.n < BENCH_CORPUS; k++) {
+			sim_init(&s, (float*)sc[k].d_pos, (float*)sc[k].b_pos,
+				sc[k].pw, sc[k].dir);
+			sim_disturb(&s, sc[k].dist, sc[k].ndist);
+			while(cp.n < BENCH_CORPUS && !sim_step(&s) &&
+					s.tick * SIM_TICK < SIM_MAXTIME) {
+				if(s.tick % BENCH_STRIDE)
+					continue;
+				cp.d[cp.n] = s.d;
+				cp.b[cp.n] = s.b;
+				cp.c[cp.n] = s.c;
+
+				// attitude reached at this tick, thrust commanded
+				for(i = 0; i < SP_DIM; i++)
+					cp.des_ang[cp.n][i] = s.d.fx_ang_pos[i];
+				for(i = 0; i < NROTOR; i++)
+					cp.th[cp.n] += s.c.rotor_dc[i] * ROTMAXFORCE;
+				cp.n++;
+			}
+		}
+	} while(cp.n < BENCH_CORPUS && cp.n > prev);
+}
+
+//--------------------------------
+// PRIVATE: MEASURE
+//--------------------------------
+
+// ---
+// Return the current time of the monotonic clock in nanoseconds
+// return: uint64_t - nanoseconds elapsed from an unspecified point
+// ---
+static uint64_t now_ns() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// ---
+// Return the time stamp counter, 0 where there is none
+// return: uint64_t - cycles elapsed from an unspecified point
+// ---
+static uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// ---
+// Compare two doubles for qsort
+// void* a: pointer to first double
+// void* b: pointer to second double
+// return: int - negative, 0 or positive as a is less, equal or greater
+// ---
+static int cmp_double(const void* a, const void* b) {
+	double 	x = *(const double*)a, y = *(const double*)b;	// values
+
+	return (x > y) - (x < y);
+}
+
+// ---
+// Return median of v (sorted in place)
+// double* v: values
+// int n: number of values
+// return: double - median
+// ---
+static double median(double* v, int n) {
+	qsort(v, n, sizeof(double), cmp_double);
+	return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// ---
+// Copy corpus in work area, outside of timing
+// return: void
+// ---
+static void work_reset() {
+	memcpy(wk.d, cp.d, sizeof(wk.d));
+	memcpy(wk.b, cp.b, sizeof(wk.b));
+	memcpy(wk.c, cp.c, sizeof(wk.c));
+}
+
+// ---
+// Warm up a benchmark, then time BENCH_REPS repetitions of enough passes
+// over the corpus to last BENCH_REP_NS; every pass starts from the corpus
+// const bench* b: pointer to benchmark
+// result* r: pointer to result, filled
+// return: void
+// ---
+static void measure(const struct bench* b, struct result* r) {
+	double 	ns[BENCH_REPS], cyc[BENCH_REPS], dev[BENCH_REPS];	// per op
+	uint64_t t0, c0, t, c, t_end;	// start and elapsed time and cycles
+	long 	ops;					// ops of a repetition
+	int 	k;						// repetition
+
+	t_end = now_ns() + BENCH_WARMUP * 1000000ULL;
+	while(now_ns() < t_end) {
+		work_reset();
+		b->pass(cp.n);
+	}
+
+	for(k = 0; k < BENCH_REPS; k++) {
+		t = c = 0;
+		ops = 0;
+		while(t < BENCH_REP_NS) {
+			work_reset();
+			t0 = now_ns();
+			c0 = cycles();
+			b->pass(cp.n);
+			c += cycles() - c0;
+			t += now_ns() - t0;
+			ops += cp.n;
+		}
+		ns[k] = (double)t / ops;
+		cyc[k] = (double)c / ops;
+	}
+
+	r->name = b->name;
+	r->ns_op = median(ns, BENCH_REPS);
+	r->ns_min = ns[0];
+	r->cyc_op = median(cyc, BENCH_REPS);
+	for(k = 0; k < BENCH_REPS; k++)
+		dev[k] = fabs(ns[k] - r->ns_op);
+	r->noise = median(dev, BENCH_REPS) / r->ns_op;
+}
+
+// ---
+// Pin the calling thread to a cpu
+// int cpu: cpu number
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int pin(int cpu) {
+	cpu_set_t set;	// cpus allowed
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set);
+}
+
+//--------------------------------
+// PRIVATE: BASELINES
+//--------------------------------
+
+// ---
+// Write results as a JSON baseline
+// char* file: path of baseline
+// result* r: results
+// int n: number of results
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int save_json(const char* file, struct result* r, int n) {
+	FILE* 	f;	// baseline file
+	int 	k;	// result
+
+	f = fopen(file, "w");
+	if(f == NULL)
+		return -1;
+	fprintf(f, "{\n  \"corpus\": %d,\n  \"results\": [\n", cp.n);
+	for(k = 0; k < n; k++)
+		fprintf(f, "    {\"name\": \"%s\", \"ns_op\": %.3f, \"ns_min\": %.3f, "
+			"\"cycles_op\": %.2f, \"noise\": %.4f}%s\n", r[k].name, r[k].ns_op,
+			r[k].ns_min, r[k].cyc_op, r[k].noise, (k < n - 1) ? "," : "");
+	fprintf(f, "  ]\n}\n");
+	return fclose(f) ? -1 : 0;
+}
+
+// ---
+// Return value of key of result called name in a JSON baseline
+// char* json: text of baseline
+// char* name: benchmark name
+// char* key: key of value
+// return: double - value, -1 if not found
+// ---
+static double json_value(const char* json, const char* name, const char* key) {
+	char 	pat[64];		// pattern searched
+	const char* p;			// position in text
+	const char* end;		// end of object of result
+
+	snprintf(pat, sizeof(pat), "\"name\": \"%s\"", name);
+	p = strstr(json, pat);
+	if(p == NULL)
+		return -1;
+	end = strchr(p, '}');
+	snprintf(pat, sizeof(pat), "\"%s\":", key);
+	p = strstr(p, pat);
+	if(p == NULL || (end != NULL && p > end))
+		return -1;
+	return strtod(p + strlen(pat), NULL);
+}
+
+// ---
+// Compare results with a JSON baseline: a benchmark regresses when it is
+// slower by more than threshold and by more than BENCH_SIGMA noises
+// char* file: path of baseline
+// result* r: results
+// int n: number of results
+// double thr: threshold (%)
+// return: int - number of regressions, -1 if baseline cannot be read
+// ---
+static int compare_json(const char* file, struct result* r, int n, double thr) {
+	static char json[BENCH_MAXLEN];	// text of baseline
+	double 	base, delta, lim;		// baseline, change and limit (%)
+	size_t 	len;					// length of text
+	FILE* 	f;						// baseline file
+	int 	k, bad = 0;				// result, regressions
+
+	f = fopen(file, "r");
+	if(f == NULL)
+		return -1;
+	len = fread(json, 1, sizeof(json) - 1, f);
+	json[len] = '\0';
+	fclose(f);
+
+	printf("-----------------------------------------------\n");
+	printf("COMPARISON WITH %s (threshold %.1f%%):\n", file, thr);
+	for(k = 0; k < n; k++) {
+		base = json_value(json, r[k].name, "ns_op");
+		if(base <= 0) {
+			printf("\t%-18s no baseline\n", r[k].name);
+			continue;
+		}
+		delta = 100 * (r[k].ns_op - base) / base;
+		lim = fmax(thr, 100 * BENCH_SIGMA * r[k].noise);
+		printf("\t%-18s %9.2f -> %9.2f ns/op  %+6.1f%%  %s\n", r[k].name,
+			base, r[k].ns_op, delta, (delta > lim) ? "REGRESSION" :
+			(delta < -lim) ? "faster" : "ok");
+		bad += delta > lim;
+	}
+	printf("-----------------------------------------------\n");
+	return bad;
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+int main(int argc, char** argv) {
+	static struct result res[sizeof(benches) / sizeof(benches[0])];	// results
+	struct 	scn* sc;				// scenarios of corpus
+	const char* scn_file = BENCH_SCN;	// scenario file of corpus
+	const char* out = NULL;			// baseline to be written
+	const char* base = NULL;		// baseline to be compared
+	const char* only = NULL;		// benchmark to be run, NULL all
+	double 	thr = BENCH_NOISE;		// regression threshold (%)
+	uint32_t nsc;					// number of scenarios
+	int 	cpu = 0;				// cpu benchmarks are pinned to
+	int 	opt, k, n = 0, bad = 0;	// option, benchmark, results, regressions
+
+	// -s: scenarios of corpus, -c: cpu, -o: write baseline,
+	// -b: compare with baseline, -t: threshold (%), -n: only one benchmark
+	while((opt = getopt(argc, argv, "s:c:o:b:t:n:")) != -1) {
+		switch(opt) {
+			case 's':
+				scn_file = optarg;
+				break;
+			case 'c':
+				cpu = atoi(optarg);
+				break;
+			case 'o':
+				out = optarg;
+				break;
+			case 'b':
+				base = optarg;
+				break;
+			case 't':
+				thr = atof(optarg);
+				break;
+			case 'n':
+				only = optarg;
+				break;
+			default:
+				printf("usage: %s [-s scenarios] [-c cpu] [-o baseline.json] "
+					"[-b baseline.json] [-t threshold_%%] [-n name]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	sc = scn_load(scn_file, &nsc);
+	if(sc == NULL)
+		return 1;
+	corpus_fill(sc, nsc);
+	free(sc);
+	if(cp.n == 0) {
+		fprintf(stderr, "%s: scenarios give no state\n", scn_file);
+		return 1;
+	}
+	if(pin(cpu))
+		perror("cpu pinning");
+
+	printf("-----------------------------------------------\n");
+	printf("MICROBENCHMARKS (corpus: %d states - cpu: %d - %d reps):\n",
+		cp.n, cpu, BENCH_REPS);
+	for(k = 0; benches[k].name != NULL; k++) {
+		if(only != NULL && strcmp(only, benches[k].name))
+			continue;
+		measure(&benches[k], &res[n]);
+		printf("\t%-18s %9.2f ns/op  %9.1f cycles/op  min: %9.2f  "
+			"noise: %.1f%%\n", res[n].name, res[n].ns_op, res[n].cyc_op,
+			res[n].ns_min, 100 * res[n].noise);
+		n++;
+	}
+	printf("-----------------------------------------------\n");
+
+	if(out != NULL && save_json(out, res, n))
+		perror(out);
+	if(base != NULL) {
+		bad = compare_json(base, res, n, thr);
+		if(bad < 0)
+			perror(base);
+	}
+	return bad ? 1 : 0;
+}
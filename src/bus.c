@@ -0,0 +1,313 @@
+#include "bus.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+//---------------------------------
+// PRIVATE: SLOT LAYOUT
+//---------------------------------
+
+struct bus_slot {					// header of each sample slot
+	_Atomic uint64_t seq;			// 2n-1 while sample n is written, 2n after
+	uint64_t stamp;					// publication time (ns)
+};
+
+// ---
+// Round len up to a multiple of the cache line
+// size_t len: length to be rounded
+// return: size_t - rounded length
+// ---
+static size_t line_up(size_t len) {
+	return (len + BUS_LINE - 1) / BUS_LINE * BUS_LINE;
+}
+
+// ---
+// Return the slot that holds (or will hold) sample num of topic t
+// bus* b: pointer to bus
+// bus_topic* t: pointer to topic descriptor
+// uint64_t num: sample number (from 1)
+// return: bus_slot* - pointer to slot header
+// ---
+static struct bus_slot* slot_of(
+		struct bus* b, struct bus_topic* t, uint64_t num) {
+
+	return (struct bus_slot*)((char*)b + t->offset +
+		((num - 1) % t->depth) * t->stride);
+}
+
+// ---
+// Return the sample stored after a slot header
+// bus_slot* s: pointer to slot header
+// return: void* - pointer to sample
+// ---
+static void* data_of(struct bus_slot* s) {
+	return (char*)s + sizeof(struct bus_slot);
+}
+
+// ---
+// Return the current time of the monotonic clock in nanoseconds
+// return: uint64_t - nanoseconds elapsed from an unspecified point
+// ---
+static uint64_t now_ns() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+//------------------------------------------
+// PUBLIC: BUS AND TOPIC CREATION
+//------------------------------------------
+
+// ---
+// Init a bus in len byte at mem (allocated if mem is NULL), return it or NULL.
+// The bus holds only offsets, so mem can be shared among processes.
+// void* mem: pointer to memory (cache line aligned) or NULL
+// size_t len: length of bus memory (byte)
+// return: bus* - pointer to bus, NULL in case of error
+// ---
+struct bus* bus_create(void* mem, size_t len) {
+	struct 	bus* b;		// new bus
+
+	len = line_up(len);
+	if(mem == NULL)
+		mem = aligned_alloc(BUS_LINE, len);
+	if(mem == NULL || len < sizeof(struct bus))
+		return NULL;
+
+	b = mem;
+	memset(b, 0, sizeof(struct bus));
+	b->len = len;
+	b->used = line_up(sizeof(struct bus));
+	return b;
+}
+
+// ---
+// Create topic id with samples of size byte and depth history
+// bus* b: pointer to bus
+// int id: topic identifier [0-BUS_MAXTOPIC]
+// char* name: name of topic
+// size_t size: size of a sample (byte)
+// int depth: number of samples kept in history (at least 2)
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int bus_topic(struct bus* b, int id, const char* name, size_t size, int depth) {
+	struct 	bus_topic* t;	// topic to be created
+	size_t 	stride;			// slot length
+
+	// one slot is written while another one is read, so depth >= 2
+	if(id < 0 || id >= BUS_MAXTOPIC || b->topic[id].depth || depth < 2)
+		return -1;
+
+	stride = line_up(sizeof(struct bus_slot) + size);
+	if(b->used + stride * depth > b->len)
+		return -1;
+
+	t = &b->topic[id];
+	strncpy(t->name, name, BUS_NAMELEN - 1);
+	t->size = size;
+	t->stride = stride;
+	t->depth = depth;
+	t->offset = b->used;
+	atomic_init(&t->head, 0);
+	atomic_init(&t->last, 0);
+	memset((char*)b + t->offset, 0, stride * depth);
+
+	b->used += stride * depth;
+	return 0;
+}
+
+// ---
+// Return the id of topic with name provided, -1 if it does not exist
+// bus* b: pointer to bus
+// char* name: name of topic
+// return: int - topic identifier, -1 if not found
+// ---
+int bus_find(struct bus* b, const char* name) {
+	int 	i;	// topic index [0-BUS_MAXTOPIC]
+
+	for(i = 0; i < BUS_MAXTOPIC; i++)
+		if(b->topic[i].depth && !strncmp(b->topic[i].name, name, BUS_NAMELEN))
+			return i;
+	return -1;
+}
+
+//------------------------------------------
+// PUBLIC: PUBLISH
+//------------------------------------------
+
+// ---
+// Reserve the next slot of topic id and return a pointer to its sample.
+// The slot is marked as being written, so readers skip it.
+// bus* b: pointer to bus
+// int id: topic identifier
+// return: void* - pointer to sample to be filled
+// ---
+void* bus_loan(struct bus* b, int id) {
+	struct 	bus_topic* t = &b->topic[id];
+	struct 	bus_slot* s;	// reserved slot
+	uint64_t num;			// number of reserved sample
+
+	num = atomic_fetch_add_explicit(&t->head, 1, memory_order_relaxed) + 1;
+	s = slot_of(b, t, num);
+	atomic_store_explicit(&s->seq, 2 * num - 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	return data_of(s);
+}
+
+// ---
+// Make the loaned sample visible to readers
+// bus* b: pointer to bus
+// int id: topic identifier
+// void* sample: pointer returned by bus_loan
+// return: uint64_t - number of sample published
+// ---
+uint64_t bus_publish(struct bus* b, int id, void* sample) {
+	struct 	bus_topic* t = &b->topic[id];
+	struct 	bus_slot* s;		// slot of sample
+	uint64_t num, last;			// number of sample, last published
+
+	s = (struct bus_slot*)((char*)sample - sizeof(struct bus_slot));
+	num = (atomic_load_explicit(&s->seq, memory_order_relaxed) + 1) / 2;
+	s->stamp = now_ns();
+	atomic_store_explicit(&s->seq, 2 * num, memory_order_release);
+
+	// with more publishers, last only moves forward
+	last = atomic_load_explicit(&t->last, memory_order_relaxed);
+	while(last < num && !atomic_compare_exchange_weak_explicit(&t->last,
+			&last, num, memory_order_release, memory_order_relaxed))
+		;
+	return num;
+}
+
+// ---
+// Copy src in a new sample of topic id and publish it
+// bus* b: pointer to bus
+// int id: topic identifier
+// void* src: pointer to sample to be copied
+// return: uint64_t - number of sample published
+// ---
+uint64_t bus_write(struct bus* b, int id, void* src) {
+	void* 	dest = bus_loan(b, id);	// loaned sample
+
+	memcpy(dest, src, b->topic[id].size);
+	return bus_publish(b, id, dest);
+}
+
+//------------------------------------------
+// PUBLIC: SUBSCRIBE
+//------------------------------------------
+
+// ---
+// Copy latest sample in dest, return its number (0 if nothing published)
+// bus* b: pointer to bus
+// int id: topic identifier
+// void* dest: pointer to memory that receives the sample
+// return: uint64_t - number of sample copied, 0 if none
+// ---
+uint64_t bus_read(struct bus* b, int id, void* dest) {
+	uint64_t num;	// number of latest sample
+	int 	retry = -1;	// copies thrown away
+
+	// retry only if publishers wrapped the whole history during the copy
+	do {
+		num = bus_last(b, id);
+		if(num == 0)
+			return 0;
+		retry++;
+	} while(!bus_read_at(b, id, num, dest));
+
+	if(retry > 0)
+		trace_mark("bus", b->topic[id].name, "retry", retry);
+	return num;
+}
+
+// ---
+// Copy sample num in dest, return 1 if still in history, 0 otherwise
+// bus* b: pointer to bus
+// int id: topic identifier
+// uint64_t num: number of wanted sample
+// void* dest: pointer to memory that receives the sample
+// return: int - 1 if sample has been copied, 0 otherwise
+// ---
+int bus_read_at(struct bus* b, int id, uint64_t num, void* dest) {
+	struct 	bus_topic* t = &b->topic[id];
+	struct 	bus_slot* s;	// slot of sample
+	uint64_t seq;			// slot sequence before the copy
+
+	if(num == 0)
+		return 0;
+
+	s = slot_of(b, t, num);
+	seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+	if(seq != 2 * num)
+		return 0;
+
+	memcpy(dest, data_of(s), t->size);
+
+	// sample is good only if no publisher touched the slot meanwhile
+	atomic_thread_fence(memory_order_acquire);
+	return atomic_load_explicit(&s->seq, memory_order_relaxed) == seq;
+}
+
+// ---
+// Return pointer to sample num without copy, NULL if not in history.
+// Data read through the pointer is good only if bus_valid is 1 afterwards.
+// bus* b: pointer to bus
+// int id: topic identifier
+// uint64_t num: number of wanted sample
+// return: void* - pointer to sample, NULL if overwritten or not published
+// ---
+const void* bus_peek(struct bus* b, int id, uint64_t num) {
+	if(!bus_valid(b, id, num))
+		return NULL;
+	return data_of(slot_of(b, &b->topic[id], num));
+}
+
+// ---
+// Return 1 if sample num (got from bus_peek) has not been overwritten yet
+// bus* b: pointer to bus
+// int id: topic identifier
+// uint64_t num: number of sample
+// return: int - 1 if sample is still valid, 0 otherwise
+// ---
+int bus_valid(struct bus* b, int id, uint64_t num) {
+	struct 	bus_slot* s;	// slot of sample
+
+	if(num == 0)
+		return 0;
+
+	atomic_thread_fence(memory_order_acquire);
+	s = slot_of(b, &b->topic[id], num);
+	return atomic_load_explicit(&s->seq, memory_order_acquire) == 2 * num;
+}
+
+// ---
+// Return the number of last published sample of topic id (0 if none)
+// bus* b: pointer to bus
+// int id: topic identifier
+// return: uint64_t - number of last published sample
+// ---
+uint64_t bus_last(struct bus* b, int id) {
+	return atomic_load_explicit(&b->topic[id].last, memory_order_acquire);
+}
+
+// ---
+// Return publication time (ns, monotonic clock) of sample num, 0 if lost
+// bus* b: pointer to bus
+// int id: topic identifier
+// uint64_t num: number of sample
+// return: uint64_t - publication time, 0 if sample is not in history
+// ---
+uint64_t bus_stamp(struct bus* b, int id, uint64_t num) {
+	struct 	bus_slot* s;	// slot of sample
+	uint64_t stamp;			// publication time
+
+	if(!bus_valid(b, id, num))
+		return 0;
+
+	s = slot_of(b, &b->topic[id], num);
+	stamp = s->stamp;
+	return bus_valid(b, id, num) ? stamp : 0;
+}
@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// BUS_H: IN-PROCESS TOPIC BUS WITH LOCK-FREE LATEST VALUE AND HISTORY
+//-----------------------------------------------------------------------------
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define BUS_MAXTOPIC	16		// max number of topics on a bus
+#define BUS_NAMELEN		16		// max length of a topic name
+#define BUS_LINE		64		// cache line size (byte)
+
+struct bus_topic {						// topic descriptor
+	char 	name[BUS_NAMELEN];			// name used to find the topic
+	size_t	size;						// size of a sample (byte)
+	size_t	stride;						// distance between two slots (byte)
+	size_t	offset;						// offset of first slot from bus
+	int 	depth;						// number of samples kept (history)
+	_Atomic uint64_t head;				// number of samples loaned so far
+	_Atomic uint64_t last;				// number of last published sample+1
+};
+
+struct bus {							// bus header, slots follow it
+	size_t 	len;						// total length of bus memory (byte)
+	size_t	used;						// byte used by header and slots
+	struct 	bus_topic topic[BUS_MAXTOPIC];
+};
+
+//------------------------------------------
+// PUBLIC: BUS AND TOPIC CREATION
+//------------------------------------------
+
+// Init a bus in len byte at mem (allocated if mem is NULL), return it or NULL
+struct bus* bus_create(void* mem, size_t len);
+
+// Create topic id with samples of size byte and depth history
+int bus_topic(struct bus* b, int id, const char* name, size_t size, int depth);
+
+// Return the id of topic with name provided, -1 if it does not exist
+int bus_find(struct bus* b, const char* name);
+
+//------------------------------------------
+// PUBLIC: PUBLISH (never blocks, never waits readers)
+//------------------------------------------
+
+// Reserve the next slot of topic id and return a pointer to its sample
+void* bus_loan(struct bus* b, int id);
+
+// Make the loaned sample visible to readers, return its number
+uint64_t bus_publish(struct bus* b, int id, void* sample);
+
+// Copy src in a new sample of topic id and publish it, return its number
+uint64_t bus_write(struct bus* b, int id, void* src);
+
+//------------------------------------------
+// PUBLIC: SUBSCRIBE (never blocks publishers)
+//------------------------------------------
+
+// Copy latest sample in dest, return its number (0 if nothing published)
+uint64_t bus_read(struct bus* b, int id, void* dest);
+
+// Copy sample num in dest, return 1 if still in history, 0 otherwise
+int bus_read_at(struct bus* b, int id, uint64_t num, void* dest);
+
+// Return pointer to sample num without copy, NULL if not in history
+const void* bus_peek(struct bus* b, int id, uint64_t num);
+
+// Return 1 if sample num (got from bus_peek) has not been overwritten yet
+int bus_valid(struct bus* b, int id, uint64_t num);
+
+// Return the number of last published sample of topic id (0 if none)
+uint64_t bus_last(struct bus* b, int id);
+
+// Return publication time (ns, monotonic clock) of sample num, 0 if lost
+uint64_t bus_stamp(struct bus* b, int id, uint64_t num);
+
+#endif
@@ -0,0 +1,494 @@
+#include "col.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define COL_LANES		8			// independent accumulators of a scan
+
+//------------------------------------------
+// PRIVATE: VALUE ENCODING
+//------------------------------------------
+
+// ---
+// Return a key of float f whose integer order is the order of floats, so
+// that close values have close keys and small deltas
+// float f: value
+// return: uint64_t - key in [0, 2^32)
+// ---
+static uint64_t f32_key(float f) {
+	uint32_t u;	// bits of f
+
+	memcpy(&u, &f, sizeof(u));
+	return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+// ---
+// Return float of key k (inverse of f32_key), without branches so that
+// loops over keys are vectorized: the sign bit is flipped, the others are
+// flipped too if it was clear
+// uint64_t k: key in [0, 2^32)
+// return: float - value
+// ---
+static float key_f32(uint64_t k) {
+	uint32_t u = (uint32_t)k;	// bits of value
+	float 	f;					// value
+
+	u ^= ((u >> 31) - 1) | 0x80000000u;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// ---
+// Map a signed delta to an unsigned one, small in absolute value
+// uint64_t d: delta (two's complement)
+// return: uint64_t - zigzag delta
+// ---
+static uint64_t zigzag(uint64_t d) {
+	return (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+}
+
+// ---
+// Return delta of a zigzag delta (inverse of zigzag)
+// uint64_t z: zigzag delta
+// return: uint64_t - delta (two's complement)
+// ---
+static uint64_t unzigzag(uint64_t z) {
+	return (z >> 1) ^ (0 - (z & 1));
+}
+
+// ---
+// Return bits needed to store v
+// uint64_t v: value
+// return: uint32_t - bits [0, 64]
+// ---
+static uint32_t bit_width(uint64_t v) {
+	return (v == 0) ? 0 : 64 - __builtin_clzll(v);
+}
+
+//------------------------------------------
+// PRIVATE: BLOCK PACKING
+//------------------------------------------
+
+// ---
+// Pack n deltas of width bits in words (LSB first), words are zeroed
+// uint64_t* z: deltas
+// uint32_t n: number of deltas
+// uint32_t width: bits of each delta [1, 64]
+// uint64_t* word: packed words, (n * width + 63) / 64 of them
+// return: void
+// ---
+static void pack(const uint64_t* z, uint32_t n, uint32_t width, uint64_t* word) {
+	uint64_t pos;	// bit position of delta
+	uint32_t i, sh;	// delta, shift in word
+
+	memset(word, 0, (n * width + 63) / 64 * sizeof(uint64_t));
+	for(i = 0; i < n; i++) {
+		pos = (uint64_t)i * width;
+		sh = pos & 63;
+		word[pos >> 6] |= z[i] << sh;
+		if(sh + width > 64)
+			word[(pos >> 6) + 1] |= z[i] >> (64 - sh);
+	}
+}
+
+// ---
+// Encode the keys of a column in blocks: deltas from the previous value,
+// zigzag mapped and packed with the width of the largest of their block
+// uint64_t* key: keys of values
+// uint64_t n: number of keys
+// col_block* dir: block directory, filled
+// uint64_t* word: packed words, filled
+// return: uint64_t - packed words written
+// ---
+static uint64_t encode(const uint64_t* key, uint64_t n, struct col_block* dir,
+		uint64_t* word) {
+	uint64_t z[COL_BLOCK];	// deltas of a block
+	uint64_t prev = 0;		// last value encoded
+	uint64_t nw = 0;		// words written
+	uint64_t or;			// bits used by deltas of a block
+	uint32_t b, i, cnt;		// block, value in block, values in block
+
+	for(b = 0; (uint64_t)b * COL_BLOCK < n; b++) {
+		cnt = (n - (uint64_t)b * COL_BLOCK < COL_BLOCK) ?
+			n - (uint64_t)b * COL_BLOCK : COL_BLOCK;
+		dir[b].base = prev;
+		dir[b].word = nw;
+		or = 0;
+		for(i = 0; i < cnt; i++) {
+			z[i] = zigzag(key[(uint64_t)b * COL_BLOCK + i] - prev);
+			prev = key[(uint64_t)b * COL_BLOCK + i];
+			or |= z[i];
+		}
+		dir[b].width = bit_width(or);
+		if(dir[b].width > 0) {
+			pack(z, cnt, dir[b].width, word + nw);
+			nw += (cnt * dir[b].width + 63) / 64;
+		}
+	}
+	return nw;
+}
+
+//------------------------------------------
+// PUBLIC: WRITING
+//------------------------------------------
+
+// ---
+// Create a columnar file: a page of header, then columns
+// char* file: path of file (truncated)
+// return: col_writer* - pointer to writer, NULL on error
+// ---
+struct col_writer* col_create(const char* file) {
+	struct 	col_writer* w;		// new writer
+	char 	head[8] = COL_MAGIC;	// header
+
+	w = calloc(1, sizeof(struct col_writer));
+	if(w == NULL)
+		return NULL;
+	w->fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(w->fd < 0 || pwrite(w->fd, head, sizeof(head), 0) != sizeof(head)) {
+		if(w->fd >= 0)
+			close(w->fd);
+		free(w);
+		return NULL;
+	}
+	w->end = COL_PAGE;
+	return w;
+}
+
+// ---
+// Encode column name and append it at the next page, with its statistics
+// col_writer* w: pointer to writer
+// char* name: column name
+// int kind: COL_F32 (values are float) or COL_U64 (values are uint64_t)
+// void* values: values of column
+// uint64_t n: number of values
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int col_add(struct col_writer* w, const char* name, int kind,
+		const void* values, uint64_t n) {
+	struct 	col_meta* m;		// description of new column
+	struct 	col_block* dir;		// block directory
+	uint64_t* key;				// keys of values
+	uint64_t* word;				// packed words
+	uint64_t nblock, nw, i;		// blocks, words, value
+	double 	v;					// value
+	char* 	buf;				// column as written
+	int 	ret = 0;			// result
+
+	if(w->ncol == COL_MAXCOL || n > (uint64_t)UINT32_MAX * COL_BLOCK)
+		return -1;
+
+	nblock = (n + COL_BLOCK - 1) / COL_BLOCK;
+	buf = malloc(nblock * sizeof(struct col_block) +
+		nblock * COL_BLOCK * sizeof(uint64_t) + 1);
+	key = malloc(n * sizeof(uint64_t) + 1);
+	if(buf == NULL || key == NULL) {
+		free(buf);
+		free(key);
+		return -1;
+	}
+
+	m = &w->meta[w->ncol];
+	memset(m, 0, sizeof(struct col_meta));
+	strncpy(m->name, name, COL_NAMELEN - 1);
+	m->kind = kind;
+	m->rows = n;
+	m->nblock = nblock;
+	m->offset = w->end;
+	m->raw = n * ((kind == COL_F32) ? sizeof(float) : sizeof(uint64_t));
+
+	for(i = 0; i < n; i++) {
+		if(kind == COL_F32) {
+			v = ((const float*)values)[i];
+			key[i] = f32_key(((const float*)values)[i]);
+		} else {
+			key[i] = ((const uint64_t*)values)[i];
+			v = key[i];
+		}
+		if(i == 0 || v < m->min)
+			m->min = v;
+		if(i == 0 || v > m->max)
+			m->max = v;
+		m->sum += v;
+	}
+
+	dir = (struct col_block*)buf;
+	word = (uint64_t*)(buf + nblock * sizeof(struct col_block));
+	nw = encode(key, n, dir, word);
+	m->length = nblock * sizeof(struct col_block) + nw * sizeof(uint64_t);
+
+	if(m->length > 0 &&
+			pwrite(w->fd, buf, m->length, m->offset) != (ssize_t)m->length)
+		ret = -1;
+	else {
+		w->end = (m->offset + m->length + COL_PAGE - 1) / COL_PAGE * COL_PAGE;
+		w->ncol++;
+	}
+	free(buf);
+	free(key);
+	return ret;
+}
+
+// ---
+// Write footer (statistics of every column) and tail, then close the file
+// col_writer* w: pointer to writer, freed
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int col_close(struct col_writer* w) {
+	struct 	col_tail t = {0};	// tail of file
+	size_t 	len;				// bytes of footer
+	int 	ret = 0;			// result
+
+	t.footer = w->end;
+	t.ncol = w->ncol;
+	memcpy(t.magic, COL_TAIL, sizeof(t.magic));
+	len = w->ncol * sizeof(struct col_meta);
+
+	if(pwrite(w->fd, w->meta, len, t.footer) != (ssize_t)len ||
+			pwrite(w->fd, &t, sizeof(t), t.footer + len) != sizeof(t))
+		ret = -1;
+	if(ftruncate(w->fd, t.footer + len + sizeof(t)))
+		ret = -1;
+	close(w->fd);
+	free(w);
+	return ret;
+}
+
+//------------------------------------------
+// PUBLIC: READING
+//------------------------------------------
+
+// ---
+// Open a columnar file and read its footer, no column is read
+// char* file: path of file
+// return: col_file* - pointer to file, NULL if it is not a columnar file
+// ---
+struct col_file* col_open(const char* file) {
+	struct 	col_file* cf;	// new file
+	struct 	col_tail t;		// tail of file
+	struct 	stat st;		// file status
+	size_t 	len;			// bytes of footer
+
+	cf = calloc(1, sizeof(struct col_file));
+	if(cf == NULL)
+		return NULL;
+	cf->fd = open(file, O_RDONLY);
+	if(cf->fd < 0 || fstat(cf->fd, &st) || st.st_size < (off_t)sizeof(t) ||
+			pread(cf->fd, &t, sizeof(t), st.st_size - sizeof(t)) != sizeof(t) ||
+			memcmp(t.magic, COL_TAIL, sizeof(t.magic)) || t.ncol > COL_MAXCOL)
+		goto fail;
+
+	len = t.ncol * sizeof(struct col_meta);
+	if(t.footer + len + sizeof(t) != (uint64_t)st.st_size)
+		goto fail;
+	cf->meta = malloc(len + 1);
+	if(cf->meta == NULL ||
+			pread(cf->fd, cf->meta, len, t.footer) != (ssize_t)len)
+		goto fail;
+	cf->ncol = t.ncol;
+	return cf;
+
+fail:
+	col_file_close(cf);
+	return NULL;
+}
+
+// ---
+// Close a columnar file
+// col_file* cf: pointer to file, freed
+// return: void
+// ---
+void col_file_close(struct col_file* cf) {
+	if(cf->fd >= 0)
+		close(cf->fd);
+	free(cf->meta);
+	free(cf);
+}
+
+// ---
+// Return index of column called name, -1 if there is none
+// col_file* cf: pointer to file
+// char* name: column name
+// return: int - column index, -1 if not found
+// ---
+int col_find(struct col_file* cf, const char* name) {
+	uint32_t k;	// column index
+
+	for(k = 0; k < cf->ncol; k++)
+		if(!strncmp(cf->meta[k].name, name, COL_NAMELEN))
+			return k;
+	return -1;
+}
+
+// ---
+// Map column k alone: the rest of the file is never read
+// col_file* cf: pointer to file
+// int k: column index
+// col_map* m: pointer to mapped column, filled
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int col_map(struct col_file* cf, int k, struct col_map* m) {
+	memset(m, 0, sizeof(struct col_map));
+	if(k < 0 || (uint32_t)k >= cf->ncol)
+		return -1;
+	m->meta = &cf->meta[k];
+	if(m->meta->length == 0)
+		return 0;
+
+	m->mem = mmap(NULL, m->meta->length, PROT_READ, MAP_PRIVATE, cf->fd,
+		m->meta->offset);
+	if(m->mem == MAP_FAILED) {
+		m->mem = NULL;
+		return -1;
+	}
+	madvise(m->mem, m->meta->length, MADV_SEQUENTIAL);
+	m->dir = m->mem;
+	m->word = (const uint64_t*)((char*)m->mem +
+		m->meta->nblock * sizeof(struct col_block));
+	return 0;
+}
+
+// ---
+// Unmap a column
+// col_map* m: pointer to mapped column
+// return: void
+// ---
+void col_unmap(struct col_map* m) {
+	if(m->mem != NULL)
+		munmap(m->mem, m->meta->length);
+	m->mem = NULL;
+}
+
+// ---
+// Decode the keys of block b of a mapped column: blocks are independent of
+// each other, but keys of a block are a running sum of its deltas
+// col_map* m: pointer to mapped column
+// uint32_t b: block [0, nblock)
+// uint64_t* key: keys of block (COL_BLOCK at most)
+// return: uint32_t - keys of block
+// ---
+static uint32_t decode_keys(const struct col_map* m, uint32_t b, uint64_t* key) {
+	const struct col_block* d = &m->dir[b];	// block
+	const uint64_t* wd = m->word + d->word;	// packed words of block
+	uint64_t mask;			// bits of a delta
+	uint64_t v = d->base;	// value (key) decoded
+	uint64_t pos, z;		// bit position, zigzag delta
+	uint32_t i, n, sh;		// value, values of block, shift in word
+
+	n = (b + 1 < m->meta->nblock) ? COL_BLOCK :
+		m->meta->rows - (uint64_t)b * COL_BLOCK;
+
+	// a block of equal values has no word
+	if(d->width == 0) {
+		for(i = 0; i < n; i++)
+			key[i] = v;
+		return n;
+	}
+
+	mask = (d->width == 64) ? ~0ULL : (1ULL << d->width) - 1;
+	for(i = 0; i < n; i++) {
+		pos = (uint64_t)i * d->width;
+		sh = pos & 63;
+		z = wd[pos >> 6] >> sh;
+		if(sh + d->width > 64)
+			z |= wd[(pos >> 6) + 1] << (64 - sh);
+		v += unzigzag(z & mask);
+		key[i] = v;
+	}
+	return n;
+}
+
+// ---
+// Convert keys of a column to values, in a loop vectorized for floats
+// col_map* m: pointer to mapped column
+// uint64_t* key: keys
+// uint32_t n: number of keys
+// double* out: values, filled
+// return: void
+// ---
+static void key_values(const struct col_map* m, const uint64_t* key,
+		uint32_t n, double* out) {
+	uint32_t i;	// key
+
+	if(m->meta->kind == COL_F32)
+		for(i = 0; i < n; i++)
+			out[i] = key_f32(key[i]);
+	else
+		for(i = 0; i < n; i++)
+			out[i] = (double)key[i];
+}
+
+// ---
+// Decode block b of a mapped column: keys first, then values
+// col_map* m: pointer to mapped column
+// uint32_t b: block [0, nblock)
+// double* out: values of block (COL_BLOCK at most)
+// return: uint32_t - values of block
+// ---
+uint32_t col_decode(const struct col_map* m, uint32_t b, double* out) {
+	uint64_t key[COL_BLOCK];	// keys of block
+	uint32_t n;					// values of block
+
+	n = decode_keys(m, b, key);
+	key_values(m, key, n, out);
+	return n;
+}
+
+// ---
+// Decode a mapped column block by block and reduce it: a block is decoded
+// in arrays that stay in cache, then reduced in loops that are vectorized.
+// Min and max are taken on the keys, whose integer order is the order of
+// values (a compare of doubles is not turned into a vector min, NaN and -0
+// forbid it), 32 bit wide for floats; the sum goes in COL_LANES independent
+// accumulators (one serial double sum cannot be reordered in vectors)
+// col_map* m: pointer to mapped column
+// col_sum* s: pointer to result, filled
+// return: void
+// ---
+void col_scan(const struct col_map* m, struct col_sum* s) {
+	uint64_t key[COL_BLOCK];	// keys of a block
+	double 	v[COL_BLOCK];		// values of a block
+	double 	sum[COL_LANES] = {0};	// sum of lanes
+	uint64_t lo = ~0ULL, hi = 0;	// min and max key
+	uint32_t lo32, hi32;		// min and max key of a float block
+	uint32_t b, i, j, n;		// block, value, lane, values of block
+
+	memset(s, 0, sizeof(struct col_sum));
+	for(b = 0; b < m->meta->nblock; b++) {
+		n = decode_keys(m, b, key);
+		if(m->meta->kind == COL_F32) {
+			lo32 = lo;
+			hi32 = hi;
+			for(i = 0; i < n; i++) {
+				lo32 = ((uint32_t)key[i] < lo32) ? (uint32_t)key[i] : lo32;
+				hi32 = ((uint32_t)key[i] > hi32) ? (uint32_t)key[i] : hi32;
+			}
+			lo = lo32;
+			hi = hi32;
+		} else
+			for(i = 0; i < n; i++) {
+				lo = (key[i] < lo) ? key[i] : lo;
+				hi = (key[i] > hi) ? key[i] : hi;
+			}
+
+		key_values(m, key, n, v);
+		for(i = 0; i + COL_LANES <= n; i += COL_LANES)
+			for(j = 0; j < COL_LANES; j++)
+				sum[j] += v[i + j];
+
+		// the last block may not fill the lanes
+		for(; i < n; i++)
+			sum[0] += v[i];
+		s->rows += n;
+	}
+	if(s->rows == 0)
+		return;
+
+	for(j = 0; j < COL_LANES; j++)
+		s->sum += sum[j];
+	key_values(m, &lo, 1, &s->min);
+	key_values(m, &hi, 1, &s->max);
+}
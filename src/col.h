@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+// COL_H: COLUMNAR FILE OF RECORDED RUNS, DELTA AND BIT-PACKED COLUMNS
+//-----------------------------------------------------------------------------
+
+#ifndef COL_H
+#define COL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COL_MAGIC		"CDCOL01"	// first bytes of a columnar file
+#define COL_TAIL		"CDC1"		// last bytes of a columnar file
+#define COL_PAGE		4096		// columns are aligned to pages (byte)
+#define COL_BLOCK		128			// values packed with the same width
+#define COL_NAMELEN		32			// max length of a column name
+#define COL_MAXCOL		256			// max columns of a file
+
+#define COL_F32			0			// column of float
+#define COL_U64			1			// column of uint64_t (stamps, ids)
+
+struct col_block {					// block directory entry
+	uint64_t base;					// value before first of block (encoded)
+	uint32_t word;					// first packed word of block
+	uint32_t width;					// bits of each delta [0, 64]
+};
+
+struct col_meta {					// column description and statistics
+	char 	name[COL_NAMELEN];		// column name (table.field)
+	uint32_t kind;					// COL_F32 or COL_U64
+	uint32_t nblock;				// blocks of column
+	uint64_t rows;					// values of column
+	uint64_t offset;				// offset of column in file (page aligned)
+	uint64_t length;				// bytes of column (directory and words)
+	uint64_t raw;					// bytes of column not encoded
+	double 	min, max, sum;			// statistics of values
+};
+
+struct col_tail {					// last bytes of file
+	uint64_t footer;				// offset of footer (array of col_meta)
+	uint32_t ncol;					// columns in footer
+	char 	magic[4];				// COL_TAIL
+};
+
+struct col_writer {					// columnar file being written
+	int 	fd;						// file descriptor
+	uint64_t end;					// end of data written (byte)
+	uint32_t ncol;					// columns written
+	struct 	col_meta meta[COL_MAXCOL];	// footer
+};
+
+struct col_file {					// columnar file opened for reading
+	int 	fd;						// file descriptor
+	uint32_t ncol;					// columns of file
+	struct 	col_meta* meta;			// footer
+};
+
+struct col_map {					// a column mapped alone
+	const struct col_meta* meta;	// description of column
+	void* 	mem;					// mapping (directory and words)
+	const struct col_block* dir;	// block directory
+	const uint64_t* word;			// packed deltas
+};
+
+struct col_sum {					// result of a scan
+	uint64_t rows;					// values scanned
+	double 	min, max, sum;			// statistics of values
+};
+
+//------------------------------------------
+// PUBLIC: WRITING
+//------------------------------------------
+
+// Create a columnar file, NULL on error
+struct col_writer* col_create(const char* file);
+
+// Encode and append column name of n values (float or uint64_t by kind)
+int col_add(struct col_writer* w, const char* name, int kind,
+	const void* values, uint64_t n);
+
+// Write footer and close the file
+int col_close(struct col_writer* w);
+
+//------------------------------------------
+// PUBLIC: READING
+//------------------------------------------
+
+// Open a columnar file reading its footer only, NULL if not valid
+struct col_file* col_open(const char* file);
+
+// Close a columnar file
+void col_file_close(struct col_file* cf);
+
+// Return index of column called name, -1 if there is none
+int col_find(struct col_file* cf, const char* name);
+
+// Map column k only, 0 in case of success
+int col_map(struct col_file* cf, int k, struct col_map* m);
+
+// Unmap a column
+void col_unmap(struct col_map* m);
+
+// Decode block b of a mapped column in out (COL_BLOCK values), values
+uint32_t col_decode(const struct col_map* m, uint32_t b, double* out);
+
+// Decode every block of a mapped column and reduce it to s
+void col_scan(const struct col_map* m, struct col_sum* s);
+
+#endif
@@ -0,0 +1,223 @@
+//-----------------------------------------------------
+//
+// COLEXPORT: FLIGHT RECORDS OF MANY RUNS TO ONE COLUMNAR FILE
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "physics.h"
+#include "rec.h"
+#include "col.h"
+
+struct field {						// array of float of a state
+	const char* name;				// name of array
+	int 	dim;					// floats of array
+};
+
+struct table {						// state stream exported as a table
+	const char* stream;				// stream name
+	const struct field* field;		// arrays of state, in memory order
+	size_t 	size;					// size of state (byte)
+};
+
+static const struct field d_field[] = {		// struct dstate
+	{"rotor_dc", NROTOR}, {"bd_lin_vel", SP_DIM}, {"bd_ang_vel", SP_DIM},
+	{"fx_lin_pos", SP_DIM}, {"fx_ang_pos", SP_DIM}, {"fx_lin_vel", SP_DIM},
+	{"fx_ang_vel", SP_DIM}, {NULL, 0}};
+static const struct field b_field[] = {		// struct bstate
+	{"position", SP_DIM}, {"velocity", SP_DIM}, {NULL, 0}};
+static const struct field c_field[] = {		// struct cstate
+	{"rotor_dc", NROTOR}, {"b_pos_f", SP_DIM}, {NULL, 0}};
+
+static const struct table tables[] = {		// streams exported
+	{"drone", d_field, sizeof(struct dstate)},
+	{"ball", b_field, sizeof(struct bstate)},
+	{"control", c_field, sizeof(struct cstate)},
+	{NULL, NULL, 0}};
+
+//--------------------------------
+// PRIVATE: EXPORT FUNCTIONS
+//--------------------------------
+
+// ---
+// Return identifier of stream called name with records of size byte
+// rec_header* h: pointer to mapped file
+// char* name: stream name
+// size_t size: size of state (byte)
+// return: int - stream identifier, -1 if there is none
+// ---
+static int find_stream(const struct rec_header* h, const char* name, size_t size) {
+	int 	s;	// stream identifier
+
+	for(s = 0; s < h->nstream; s++)
+		if(!strncmp(h->stream[s].name, name, REC_NAMELEN) &&
+				h->stream[s].size >= sizeof(struct rec_item) + size)
+			return s;
+	return -1;
+}
+
+// ---
+// Count records of a table in every run, or copy them in columns: time
+// from start of run, run number, then a column for each float of state
+// const table* tb: pointer to table
+// char** file: record files (runs)
+// int nrun: number of runs
+// uint64_t* t: time column (us), NULL to count only
+// uint64_t* run: run column
+// float** v: float columns
+// return: uint64_t - records of table
+// ---
+static uint64_t gather(const struct table* tb, char** file, int nrun,
+		uint64_t* t, uint64_t* run, float** v) {
+	const struct rec_header* h;	// mapped run
+	const struct rec_item* it;	// record
+	const float* f;				// state of record
+	size_t 	len;				// length of mapping
+	uint64_t n = 0;				// records
+	uint32_t c, i, cnt;			// chunk, record in chunk, records in chunk
+	int 	r, s, k;			// run, stream identifier, float of state
+
+	for(r = 0; r < nrun; r++) {
+		h = rec_map(file[r], &len);
+		if(h == NULL) {
+			fprintf(stderr, "%s: not a valid record file, skipped\n", file[r]);
+			continue;
+		}
+		s = find_stream(h, tb->stream, tb->size);
+		for(c = 0; s >= 0 && c < atomic_load(&h->nchunk) &&
+				c < REC_MAXCHUNK; c++) {
+			if(h->index[c].stream != s)
+				continue;
+			cnt = rec_count(h, len, c);
+			if(t == NULL) {
+				n += cnt;
+				continue;
+			}
+			for(i = 0; i < cnt; i++, n++) {
+				it = rec_record(h, c, i);
+				f = (const float*)it->data;
+				t[n] = it->stamp - h->t_start;
+				run[n] = r;
+				for(k = 0; k < tb->size / sizeof(float); k++)
+					v[k][n] = f[k];
+			}
+		}
+		rec_unmap(h, len);
+	}
+	return n;
+}
+
+// ---
+// Export a table of every run in columns of the file
+// col_writer* w: pointer to writer
+// const table* tb: pointer to table
+// char** file: record files (runs)
+// int nrun: number of runs
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int export_table(struct col_writer* w, const struct table* tb,
+		char** file, int nrun) {
+	static const char* axis[SP_DIM] = {"x", "y", "z"};	// names of axes
+	const struct field* fd;		// array of state
+	char 	name[COL_NAMELEN];	// column name
+	uint64_t* t;				// time column
+	uint64_t* run;				// run column
+	float* 	v[REC_MAXSIZE / sizeof(float)];	// float columns
+	uint64_t n;					// rows
+	int 	k, j, nf, ret = 0;	// float of state, of array, floats, result
+
+	nf = tb->size / sizeof(float);
+	n = gather(tb, file, nrun, NULL, NULL, NULL);
+	if(n == 0)
+		return 0;
+
+	t = malloc(n * sizeof(uint64_t));
+	run = malloc(n * sizeof(uint64_t));
+	for(k = 0; k < nf; k++)
+		v[k] = malloc(n * sizeof(float));
+	for(k = 0; k < nf; k++)
+		if(v[k] == NULL)
+			ret = -1;
+	if(t == NULL || run == NULL || ret)
+		goto out;
+
+	gather(tb, file, nrun, t, run, v);
+	snprintf(name, COL_NAMELEN, "%s.t", tb->stream);
+	ret |= col_add(w, name, COL_U64, t, n);
+	snprintf(name, COL_NAMELEN, "%s.run", tb->stream);
+	ret |= col_add(w, name, COL_U64, run, n);
+
+	k = 0;
+	for(fd = tb->field; fd->name != NULL; fd++)
+		for(j = 0; j < fd->dim; j++, k++) {
+			if(fd->dim == SP_DIM)
+				snprintf(name, COL_NAMELEN, "%s.%s.%s", tb->stream,
+					fd->name, axis[j]);
+			else
+				snprintf(name, COL_NAMELEN, "%s.%s.%d", tb->stream,
+					fd->name, j);
+			ret |= col_add(w, name, COL_F32, v[k], n);
+		}
+
+out:
+	free(t);
+	free(run);
+	for(k = 0; k < nf; k++)
+		free(v[k]);
+	return ret;
+}
+
+// ---
+// Print columns written, with their compression
+// col_writer* w: pointer to writer
+// int nrun: number of runs
+// return: void
+// ---
+static void export_report(struct col_writer* w, int nrun) {
+	uint64_t raw = 0, enc = 0;	// bytes not encoded and encoded
+	uint32_t k;					// column
+
+	printf("-----------------------------------------------\n");
+	printf("COLUMNAR EXPORT:\n");
+	printf("\truns: %d - columns: %u\n", nrun, w->ncol);
+	for(k = 0; k < w->ncol; k++) {
+		raw += w->meta[k].raw;
+		enc += w->meta[k].length;
+		printf("\t%-28s rows: %llu - %llu byte (%.1f%%)\n", w->meta[k].name,
+			(unsigned long long)w->meta[k].rows,
+			(unsigned long long)w->meta[k].length,
+			100.0 * w->meta[k].length / w->meta[k].raw);
+	}
+	printf("\ttotal: %llu byte of %llu (%.1f%%)\n", (unsigned long long)enc,
+		(unsigned long long)raw, raw ? 100.0 * enc / raw : 0);
+	printf("-----------------------------------------------\n");
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+int main(int argc, char** argv) {
+	struct 	col_writer* w;		// columnar file
+	const struct table* tb;		// table exported
+	int 	ret = 0;			// result
+
+	if(argc < 3) {
+		printf("usage: %s columnar_file record_file...\n", argv[0]);
+		return 1;
+	}
+
+	w = col_create(argv[1]);
+	if(w == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+	for(tb = tables; tb->stream != NULL; tb++)
+		ret |= export_table(w, tb, argv + 2, argc - 2);
+	export_report(w, argc - 2);
+	ret |= col_close(w);
+	if(ret)
+		fprintf(stderr, "%s: export failed\n", argv[1]);
+	return ret ? 1 : 0;
+}
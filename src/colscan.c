@@ -0,0 +1,211 @@
+//-----------------------------------------------------
+//
+// COLSCAN: SCAN A COLUMN OF A COLUMNAR FILE (AND THE SAME FIELD OF A CSV)
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "col.h"
+
+#define BENCH_MS		300			// min time of a benchmark (ms)
+
+//--------------------------------
+// PRIVATE: SCAN FUNCTIONS
+//--------------------------------
+
+// ---
+// Return the current time of the monotonic clock in seconds
+// return: double - seconds elapsed from an unspecified point
+// ---
+static double now() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1E9;
+}
+
+// ---
+// Print columns of file with their statistics (footer only is read)
+// col_file* cf: pointer to file
+// return: void
+// ---
+static void print_footer(struct col_file* cf) {
+	const struct col_meta* m;	// column
+	uint32_t k;					// column index
+
+	printf("-----------------------------------------------\n");
+	printf("COLUMNAR FILE:\n");
+	for(k = 0; k < cf->ncol; k++) {
+		m = &cf->meta[k];
+		printf("\t%-28s rows: %llu - %.1f%% - min: %g - max: %g - "
+			"mean: %g\n", m->name, (unsigned long long)m->rows,
+			m->raw ? 100.0 * m->length / m->raw : 0, m->min, m->max,
+			m->rows ? m->sum / m->rows : 0);
+	}
+	printf("-----------------------------------------------\n");
+}
+
+// ---
+// Parse field k (0 is the first) of every line of a csv and reduce it
+// char* p: csv text
+// size_t len: length of text
+// int k: field
+// col_sum* s: pointer to result, filled
+// return: void
+// ---
+static void csv_scan(const char* p, size_t len, int k, struct col_sum* s) {
+	const char* end = p + len;	// end of text
+	char* 	next;				// end of number parsed
+	double 	v;					// value
+	int 	f;					// field of line
+
+	memset(s, 0, sizeof(struct col_sum));
+	while(p < end) {
+		for(f = 0; f < k && p < end && *p != '\n'; p++)
+			if(*p == ',')
+				f++;
+		if(f == k && p < end && *p != '\n') {
+			v = strtod(p, &next);
+			if(s->rows == 0 || v < s->min)
+				s->min = v;
+			if(s->rows == 0 || v > s->max)
+				s->max = v;
+			s->sum += v;
+			s->rows++;
+			p = next;
+		}
+		while(p < end && *p++ != '\n')
+			;
+	}
+}
+
+// ---
+// Scan a column of a columnar file until BENCH_MS elapsed
+// col_file* cf: pointer to file
+// int k: column index
+// col_sum* s: pointer to result, filled
+// return: double - seconds of a scan (mapping included), -1 on error
+// ---
+static double bench_col(struct col_file* cf, int k, struct col_sum* s) {
+	struct 	col_map m;	// mapped column
+	double 	t0, t;		// start time, time elapsed
+	long 	n = 0;		// scans done
+
+	t0 = now();
+	do {
+		if(col_map(cf, k, &m))
+			return -1;
+		col_scan(&m, s);
+		col_unmap(&m);
+		n++;
+		t = now() - t0;
+	} while(t < BENCH_MS / 1E3);
+	return t / n;
+}
+
+// ---
+// Scan a field of a csv until BENCH_MS elapsed
+// char* file: path of csv
+// int k: field
+// col_sum* s: pointer to result, filled
+// size_t* len: length of csv, filled
+// return: double - seconds of a scan (mapping included), -1 on error
+// ---
+static double bench_csv(const char* file, int k, struct col_sum* s, size_t* len) {
+	struct 	stat st;	// file status
+	double 	t0, t;		// start time, time elapsed
+	void* 	mem;		// mapped csv
+	long 	n = 0;		// scans done
+	int 	fd;			// file descriptor
+
+	fd = open(file, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) || st.st_size == 0)
+		return -1;
+	*len = st.st_size;
+
+	t0 = now();
+	do {
+		mem = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mem == MAP_FAILED)
+			return -1;
+		csv_scan(mem, *len, k, s);
+		munmap(mem, *len);
+		n++;
+		t = now() - t0;
+	} while(t < BENCH_MS / 1E3);
+	close(fd);
+	return t / n;
+}
+
+// ---
+// Print result and throughput of a scan
+// char* what: what has been scanned
+// col_sum* s: pointer to result
+// double t: seconds of a scan
+// size_t bytes: bytes read by a scan
+// return: void
+// ---
+static void print_scan(const char* what, struct col_sum* s, double t, size_t bytes) {
+	printf("\t%s: rows: %llu - min: %g - max: %g - mean: %g\n", what,
+		(unsigned long long)s->rows, s->min, s->max,
+		s->rows ? s->sum / s->rows : 0);
+	printf("\t\tscan: %.3f ms - %.1f Mrows/s - %.1f MB/s of %zu byte\n",
+		t * 1E3, s->rows / t / 1E6, bytes / t / 1E6, bytes);
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+int main(int argc, char** argv) {
+	struct 	col_file* cf;	// columnar file
+	struct 	col_sum s;		// result of a scan
+	double 	t_col, t_csv;	// seconds of a scan
+	size_t 	len;			// length of csv
+	int 	k;				// column index
+
+	if(argc != 2 && argc != 3 && argc != 5) {
+		printf("usage: %s columnar_file [column [csv_file field]]\n", argv[0]);
+		return 1;
+	}
+
+	cf = col_open(argv[1]);
+	if(cf == NULL) {
+		fprintf(stderr, "%s: not a columnar file\n", argv[1]);
+		return 1;
+	}
+	if(argc == 2) {
+		print_footer(cf);
+		col_file_close(cf);
+		return 0;
+	}
+
+	k = col_find(cf, argv[2]);
+	if(k < 0 || (t_col = bench_col(cf, k, &s)) < 0) {
+		fprintf(stderr, "%s: no column %s\n", argv[1], argv[2]);
+		col_file_close(cf);
+		return 1;
+	}
+	printf("-----------------------------------------------\n");
+	printf("SCAN OF %s:\n", argv[2]);
+	print_scan("column", &s, t_col, cf->meta[k].length);
+
+	if(argc == 5) {
+		t_csv = bench_csv(argv[3], atoi(argv[4]), &s, &len);
+		if(t_csv < 0)
+			perror(argv[3]);
+		else {
+			print_scan("csv", &s, t_csv, len);
+			printf("\tcolumn is %.1fx faster than csv\n", t_csv / t_col);
+		}
+	}
+	printf("-----------------------------------------------\n");
+	col_file_close(cf);
+	return 0;
+}
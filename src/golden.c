@@ -0,0 +1,578 @@
+//-----------------------------------------------------
+//
+// GOLDEN: REFERENCE TRAJECTORIES OF THROWS AND EQUIVALENCE CHECK
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ptask.h"
+#include "scn.h"
+
+#define GOLD_MAGIC		"CDGOLD1"	// first bytes of a reference file
+#define GOLD_MAXWORKER	64			// max worker threads
+#define GOLD_MAXSTEP	(SIM_MAXTIME / SIM_TICK)	// max steps of a throw
+#define GOLD_SHOW		10			// divergences printed
+#define GOLD_NGEN		200			// throws of the fixed corpus
+#define GOLD_NVAL		(sizeof(struct gold_step) / sizeof(float))	// floats
+
+struct gold_step {					// states after a tick
+	struct 	dstate d;				// drone state
+	struct 	bstate b;				// ball state
+	struct 	cstate c;				// controller state
+};
+
+struct gold_head {					// header of reference file
+	char 	magic[8];				// GOLD_MAGIC
+	uint32_t n;						// number of throws
+	uint32_t nval;					// floats of a step (GOLD_NVAL)
+	uint64_t steps;					// steps of every throw
+};
+
+struct gold_entry {					// reference of a throw
+	struct 	scn sc;					// throw
+	int32_t outcome;				// SIM_* outcome
+	uint32_t nstep;					// steps till ball stopped
+	uint64_t first;					// first step in file
+	float 	miss;					// closest drone to ball distance (m)
+};
+
+struct gold_result {				// candidate against reference
+	int 	outcome;				// SIM_* outcome of candidate
+	float 	miss;					// closest drone to ball distance (m)
+	long 	tick;					// first divergence, -1 if none
+	int 	val;					// float diverged first, -1 if steps
+	float 	ref, cand;				// values at first divergence
+	uint32_t max_ulp;				// max distance in ulp (within tolerance)
+	float 	max_abs;				// max absolute difference
+	int 	exact;					// 1 if every value is bit-exact
+};
+
+struct gold_check {					// check shared by workers
+	const struct gold_head* h;		// mapped reference file
+	const struct gold_entry* e;		// references of throws
+	const struct gold_step* s;		// steps of every throw
+	struct 	gold_result* r;			// results of throws
+	uint32_t ulp;					// tolerance in ulp
+	float 	abs;					// absolute tolerance
+	_Atomic uint32_t next;			// next throw to be claimed
+};
+
+struct field {						// array of float of a step
+	const char* name;				// name of array
+	int 	dim;					// floats of array
+};
+
+static const struct field fields[] = {	// struct gold_step, memory order
+	{"d.rotor_dc", NROTOR}, {"d.bd_lin_vel", SP_DIM}, {"d.bd_ang_vel", SP_DIM},
+	{"d.fx_lin_pos", SP_DIM}, {"d.fx_ang_pos", SP_DIM},
+	{"d.fx_lin_vel", SP_DIM}, {"d.fx_ang_vel", SP_DIM},
+	{"b.position", SP_DIM}, {"b.velocity", SP_DIM},
+	{"c.rotor_dc", NROTOR}, {"c.b_pos_f", SP_DIM}, {NULL, 0}};
+
+//--------------------------------
+// PRIVATE: CORPUS
+//--------------------------------
+
+// ---
+// Fill the fixed corpus: two drone starts, a 5 x 5 grid of ball starts,
+// two powers and two directions, a throw in four with wind
+// scn* v: vector of GOLD_NGEN scenarios, filled
+// return: uint32_t - number of scenarios
+// ---
+static uint32_t corpus_gen(struct scn* v) {
+	static const float d_x[] = {0, 10};		// drone starts (x = -y)
+	static const float pw[] = {4, 8};		// powers
+	static const float dir[] = {3, 7};		// directions
+	struct 	scn* sc;		// scenario
+	uint32_t n = 0;			// scenarios
+	int 	a, i, j, p, q;	// drone, ball column and row, power, direction
+
+	for(a = 0; a < 2; a++)
+		for(j = 0; j < 5; j++)
+			for(i = 0; i < 5; i++)
+				for(p = 0; p < 2; p++)
+					for(q = 0; q < 2; q++, n++) {
+						sc = &v[n];
+						memset(sc, 0, sizeof(struct scn));
+						snprintf(sc->name, SCN_NAMELEN, "g%03u", n);
+						sc->d_pos[X] = d_x[a];
+						sc->d_pos[Y] = 0 - d_x[a];
+						sc->b_pos[X] = -20 + 10 * i;
+						sc->b_pos[Y] = -20 + 10 * j;
+						sc->pw = pw[p];
+						sc->dir = dir[q];
+						sc->expect = SCN_ANY;
+						if(n % 4 == 3) {
+							sc->ndist = 1;
+							sc->dist[0].obj = SIM_BALL;
+							sc->dist[0].t0 = 500;
+							sc->dist[0].t1 = 2500;
+							sc->dist[0].acc[X] = 1.5;
+						}
+					}
+	return n;
+}
+
+// ---
+// Write corpus in scenario format
+// char* file: path of scenario file
+// scn* v: scenarios
+// uint32_t n: number of scenarios
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int corpus_save(const char* file, const struct scn* v, uint32_t n) {
+	const struct sim_dist* d;	// disturbance
+	FILE* 	f;					// scenario file
+	uint32_t k;					// scenario
+	int 	i;					// disturbance
+
+	f = fopen(file, "w");
+	if(f == NULL)
+		return -1;
+	fprintf(f, "# fixed corpus of golden trajectories\n");
+	for(k = 0; k < n; k++) {
+		fprintf(f, "%s\t%g %g %g\t%g %g %g\t%g %g\t%s", v[k].name,
+			v[k].d_pos[X], v[k].d_pos[Y], v[k].d_pos[Z],
+			v[k].b_pos[X], v[k].b_pos[Y], v[k].b_pos[Z], v[k].pw, v[k].dir,
+			scn_outcome_name(v[k].expect));
+		for(i = 0; i < v[k].ndist; i++) {
+			d = &v[k].dist[i];
+			fprintf(f, "\t%s %ld %ld %g %g %g", (d->obj == SIM_BALL) ?
+				"wind" : "gust", d->t0, d->t1, d->acc[X], d->acc[Y], d->acc[Z]);
+		}
+		fprintf(f, "\n");
+	}
+	return fclose(f) ? -1 : 0;
+}
+
+//--------------------------------
+// PRIVATE: REFERENCE
+//--------------------------------
+
+// ---
+// Return SIM_* outcome of a rollout, as sim_run does
+// sim* s: pointer to simulation at the end of rollout
+// int still: 1 if ball has stopped
+// return: int - outcome
+// ---
+static int outcome(struct sim* s, int still) {
+	if(!still)
+		return SIM_TIMEOUT;
+	return s->b.position[Z] > 0 ? SIM_CAUGHT : SIM_MISSED;
+}
+
+// ---
+// Roll out a throw saving the states after every tick
+// scn* sc: pointer to throw
+// gold_step* st: steps, GOLD_MAXSTEP at most
+// gold_entry* e: pointer to reference, outcome, nstep and miss filled
+// return: void
+// ---
+static void rollout(const struct scn* sc, struct gold_step* st,
+		struct gold_entry* e) {
+	struct 	sim s;		// simulation
+	uint32_t n = 0;		// steps
+	int 	still;		// ball has stopped
+
+	sim_init(&s, (float*)sc->d_pos, (float*)sc->b_pos, sc->pw, sc->dir);
+	sim_disturb(&s, sc->dist, sc->ndist);
+	do {
+		still = sim_step(&s);
+		st[n].d = s.d;
+		st[n].b = s.b;
+		st[n].c = s.c;
+		n++;
+	} while(!still && n < GOLD_MAXSTEP);
+	e->outcome = outcome(&s, still);
+	e->nstep = n;
+	e->miss = s.miss;
+}
+
+// ---
+// Record reference trajectories of throws with this build of physics
+// char* file: path of reference file
+// scn* v: throws
+// uint32_t n: number of throws
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int record(const char* file, const struct scn* v, uint32_t n) {
+	struct 	gold_head h = {GOLD_MAGIC};	// header
+	struct 	gold_entry* e;		// references
+	struct 	gold_step* st;		// steps of a throw
+	uint32_t k;					// throw
+	FILE* 	f;					// reference file
+	int 	ret = 0;			// result
+
+	e = calloc(n, sizeof(struct gold_entry));
+	st = malloc(GOLD_MAXSTEP * sizeof(struct gold_step));
+	f = fopen(file, "w");
+	if(e == NULL || st == NULL || f == NULL) {
+		ret = -1;
+		goto out;
+	}
+
+	// steps follow header and entries
+	h.n = n;
+	h.nval = GOLD_NVAL;
+	fseek(f, sizeof(h) + n * sizeof(struct gold_entry), SEEK_SET);
+	for(k = 0; k < n && !ret; k++) {
+		e[k].sc = v[k];
+		rollout(&v[k], st, &e[k]);
+		e[k].first = h.steps;
+		h.steps += e[k].nstep;
+		if(fwrite(st, sizeof(struct gold_step), e[k].nstep, f) != e[k].nstep)
+			ret = -1;
+	}
+	rewind(f);
+	if(fwrite(&h, sizeof(h), 1, f) != 1 ||
+			fwrite(e, sizeof(struct gold_entry), n, f) != n)
+		ret = -1;
+
+out:
+	if(f != NULL && fclose(f))
+		ret = -1;
+	free(e);
+	free(st);
+	return ret;
+}
+
+//--------------------------------
+// PRIVATE: CHECK
+//--------------------------------
+
+// ---
+// Return distance in ulp of two floats (same order of float keys)
+// float a: first value
+// float b: second value
+// return: uint32_t - representable floats between a and b
+// ---
+static uint32_t ulp_dist(float a, float b) {
+	uint32_t x, y;	// bits, then keys
+
+	memcpy(&x, &a, sizeof(x));
+	memcpy(&y, &b, sizeof(y));
+	x = (x & 0x80000000u) ? ~x : (x | 0x80000000u);
+	y = (y & 0x80000000u) ? ~y : (y | 0x80000000u);
+	return (x > y) ? x - y : y - x;
+}
+
+// ---
+// Compare a candidate step with the reference one
+// gold_check* g: pointer to check
+// float* ref: reference values
+// float* cand: candidate values
+// gold_result* r: pointer to result, max errors updated
+// return: int - first value out of tolerance, -1 if none
+// ---
+static int step_cmp(struct gold_check* g, const float* ref, const float* cand,
+		struct gold_result* r) {
+	uint32_t u;		// distance in ulp
+	float 	d;		// absolute difference
+	int 	k;		// value
+
+	for(k = 0; k < GOLD_NVAL; k++) {
+		if(!memcmp(&ref[k], &cand[k], sizeof(float)) ||
+				(isnan(ref[k]) && isnan(cand[k])))
+			continue;
+		r->exact = 0;
+		u = ulp_dist(ref[k], cand[k]);
+		d = fabsf(ref[k] - cand[k]);
+		if(u > g->ulp && !(d <= g->abs))
+			return k;
+		if(u > r->max_ulp)
+			r->max_ulp = u;
+		if(d > r->max_abs)
+			r->max_abs = d;
+	}
+	return -1;
+}
+
+// ---
+// Run a throw with this build of physics and compare it step by step with
+// its reference; the rollout goes on after a divergence, for its outcome
+// gold_check* g: pointer to check
+// uint32_t k: throw
+// return: void
+// ---
+static void check_one(struct gold_check* g, uint32_t k) {
+	const struct gold_entry* e = &g->e[k];	// reference
+	const struct gold_step* ref = g->s + e->first;	// reference steps
+	struct 	gold_result* r = &g->r[k];		// result
+	struct 	gold_step st;	// candidate step
+	struct 	sim s;			// candidate simulation
+	uint32_t n = 0;			// steps
+	int 	still, v;		// ball has stopped, value diverged
+
+	memset(r, 0, sizeof(struct gold_result));
+	r->tick = -1;
+	r->exact = 1;
+	sim_init(&s, (float*)e->sc.d_pos, (float*)e->sc.b_pos, e->sc.pw, e->sc.dir);
+	sim_disturb(&s, e->sc.dist, e->sc.ndist);
+	do {
+		still = sim_step(&s);
+		if(r->tick < 0 && n < e->nstep) {
+			st.d = s.d;
+			st.b = s.b;
+			st.c = s.c;
+			v = step_cmp(g, (const float*)&ref[n], (const float*)&st, r);
+			if(v >= 0) {
+				r->tick = n;
+				r->val = v;
+				r->ref = ((const float*)&ref[n])[v];
+				r->cand = ((const float*)&st)[v];
+			}
+		}
+		n++;
+	} while(!still && n < GOLD_MAXSTEP);
+
+	// a throw longer or shorter than its reference diverges at its end
+	if(r->tick < 0 && n != e->nstep) {
+		r->tick = (n < e->nstep) ? n : e->nstep;
+		r->val = -1;
+		r->exact = 0;
+	}
+	r->outcome = outcome(&s, still);
+	r->miss = s.miss;
+}
+
+// ---
+// Worker: claim throws until none is left
+// void* arg: pointer to check
+// return: void
+// ---
+static void* check_worker(void* arg) {
+	struct 	gold_check* g = arg;	// check
+	uint32_t k;						// throw
+
+	while((k = atomic_fetch_add(&g->next, 1)) < g->h->n)
+		check_one(g, k);
+	return NULL;
+}
+
+// ---
+// Return name of value k of a step
+// int k: value, -1 for the number of steps
+// char* buf: buffer of name
+// size_t len: length of buffer
+// return: char* - name
+// ---
+static const char* val_name(int k, char* buf, size_t len) {
+	const struct field* f;	// array of step
+
+	if(k < 0)
+		return "steps";
+	for(f = fields; f->name != NULL; k -= f->dim, f++)
+		if(k < f->dim) {
+			snprintf(buf, len, "%s[%d]", f->name, k);
+			return buf;
+		}
+	return "?";
+}
+
+// ---
+// Print how candidate compares with reference
+// gold_check* g: pointer to check
+// int workers: number of workers
+// double wall: time taken (s)
+// return: int - throws out of tolerance
+// ---
+static int check_report(struct gold_check* g, int workers, double wall) {
+	const struct gold_entry* e;		// reference
+	struct 	gold_result* r;			// result
+	char 	name[32];				// name of a value
+	long 	exact = 0, within = 0, div = 0, changed = 0;	// throws
+	uint32_t max_ulp = 0, k;		// max distance in ulp, throw
+	float 	max_abs = 0;			// max absolute difference
+	int 	shown = 0;				// divergences printed
+
+	for(k = 0; k < g->h->n; k++) {
+		r = &g->r[k];
+		exact += r->exact;
+		within += !r->exact && r->tick < 0;
+		div += r->tick >= 0;
+		changed += r->outcome != g->e[k].outcome;
+		if(r->max_ulp > max_ulp)
+			max_ulp = r->max_ulp;
+		if(r->max_abs > max_abs)
+			max_abs = r->max_abs;
+	}
+
+	printf("-----------------------------------------------\n");
+	printf("GOLDEN TRAJECTORIES (tolerance: %u ulp or %g):\n", g->ulp, g->abs);
+	printf("\tthrows: %u - bit-exact: %ld - within tolerance: %ld - "
+		"diverged: %ld\n", g->h->n, exact, within, div);
+	printf("\tmax error within tolerance: %u ulp - %g\n", max_ulp, max_abs);
+	printf("\toutcome changed: %ld\n", changed);
+	for(k = 0; k < g->h->n && shown < GOLD_SHOW; k++) {
+		e = &g->e[k];
+		r = &g->r[k];
+		if(r->tick < 0 && r->outcome == e->outcome)
+			continue;
+		shown++;
+		if(r->tick >= 0)
+			printf("\t%s: step %ld (%.2f s) %s ref %.9g cand %.9g (%u ulp)",
+				e->sc.name, r->tick, (r->tick + 1) * SIM_TICK / 1000.0,
+				val_name(r->val, name, sizeof(name)), r->ref, r->cand,
+				ulp_dist(r->ref, r->cand));
+		else
+			printf("\t%s: no divergence", e->sc.name);
+		printf(" - %s -> %s (miss %.3f -> %.3f m)\n",
+			scn_outcome_name(e->outcome), scn_outcome_name(r->outcome),
+			e->miss, r->miss);
+	}
+	printf("\twall: %.3f s - workers: %d\n", wall, workers);
+	printf("-----------------------------------------------\n");
+	return div;
+}
+
+// ---
+// Check this build of physics against a reference file, in parallel
+// char* file: path of reference file
+// int workers: number of workers
+// uint32_t ulp: tolerance in ulp
+// float abs: absolute tolerance
+// return: int - throws out of tolerance, -1 if file cannot be read
+// ---
+static int check(const char* file, int workers, uint32_t ulp, float abs) {
+	static struct gold_check g;		// check
+	pthread_t id[GOLD_MAXWORKER];	// workers
+	struct 	timespec t0, t1;		// start and end time
+	struct 	stat st;				// file status
+	void* 	mem;					// mapped file
+	int 	fd, i, ret;				// file descriptor, worker, result
+
+	fd = open(file, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st)) {
+		perror(file);
+		return -1;
+	}
+	mem = (st.st_size < (off_t)sizeof(struct gold_head)) ? MAP_FAILED :
+		mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mem == MAP_FAILED) {
+		fprintf(stderr, "%s: not a reference file\n", file);
+		return -1;
+	}
+
+	g.h = mem;
+	g.e = (const struct gold_entry*)(g.h + 1);
+	g.s = (const struct gold_step*)(g.e + g.h->n);
+	if(memcmp(g.h->magic, GOLD_MAGIC, sizeof(g.h->magic)) ||
+			g.h->nval != GOLD_NVAL || (const char*)(g.s + g.h->steps) !=
+			(const char*)mem + st.st_size) {
+		munmap(mem, st.st_size);
+		fprintf(stderr, "%s: not a reference of this build\n", file);
+		return -1;
+	}
+	g.r = calloc(g.h->n, sizeof(struct gold_result));
+	g.ulp = ulp;
+	g.abs = abs;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for(i = 0; i < workers; i++)
+		bg_task_create(&id[i], check_worker, &g);
+	for(i = 0; i < workers; i++)
+		pthread_join(id[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	ret = check_report(&g, workers, (t1.tv_sec - t0.tv_sec) +
+		(t1.tv_nsec - t0.tv_nsec) / 1E9);
+	free(g.r);
+	munmap(mem, st.st_size);
+	return ret;
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+// ---
+// Print command line usage
+// char* name: program name
+// return: void
+// ---
+static void usage(char* name) {
+	printf("usage: %s -g corpus.scn\n"
+		"\t%s -r reference [-s scenarios]\n"
+		"\t%s [-w workers] [-u ulp] [-a abs] reference\n",
+		name, name, name);
+}
+
+int main(int argc, char** argv) {
+	static struct scn gen[GOLD_NGEN];	// fixed corpus
+	struct 	scn* v = gen;			// throws
+	const char* gen_file = NULL;	// corpus to be written
+	const char* ref_file = NULL;	// reference to be recorded
+	const char* scn_file = NULL;	// throws of reference, NULL fixed corpus
+	uint32_t n, ulp = 0;			// throws, tolerance in ulp
+	float 	abs = 0;				// absolute tolerance
+	int 	workers, opt, ret;		// number of workers, option, result
+
+	// -g: write fixed corpus, -r: record reference (of -s scenarios),
+	// -w: workers, -u: ulp tolerance, -a: absolute tolerance
+	workers = sysconf(_SC_NPROCESSORS_ONLN);
+	while((opt = getopt(argc, argv, "g:r:s:w:u:a:")) != -1) {
+		switch(opt) {
+			case 'g':
+				gen_file = optarg;
+				break;
+			case 'r':
+				ref_file = optarg;
+				break;
+			case 's':
+				scn_file = optarg;
+				break;
+			case 'w':
+				workers = atoi(optarg);
+				break;
+			case 'u':
+				ulp = atol(optarg);
+				break;
+			case 'a':
+				abs = atof(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(gen_file == NULL && ref_file == NULL && optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+	if(workers < 1)
+		workers = 1;
+	if(workers > GOLD_MAXWORKER)
+		workers = GOLD_MAXWORKER;
+
+	n = corpus_gen(gen);
+	if(gen_file != NULL) {
+		if(corpus_save(gen_file, gen, n)) {
+			perror(gen_file);
+			return 1;
+		}
+		return 0;
+	}
+
+	if(ref_file != NULL) {
+		if(scn_file != NULL && (v = scn_load(scn_file, &n)) == NULL)
+			return 1;
+		ret = record(ref_file, v, n);
+		if(ret)
+			perror(ref_file);
+		else
+			printf("%s: %u reference trajectories\n", ref_file, n);
+		return ret ? 1 : 0;
+	}
+
+	return check(argv[optind], workers, ulp, abs) ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+#include "heat.h"
+#include "ptask.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define OUTCOME(C)		((C) & 3)	// outcome stored in a cell
+#define PRECISION(C)	((C) >> 2)	// precision stored in a cell (0 unknown)
+
+//------------------------------------------
+// PRIVATE: COARSE TO FINE ORDER
+//------------------------------------------
+
+// ---
+// Return the side (cells) of the block a sample of cell (i, j) stands for:
+// the first pass samples a cell every HEAT_GRID / HEAT_COARSE, each next
+// pass halves the step.
+// int i: column of cell
+// int j: row of cell
+// return: int - side of block, from HEAT_GRID / HEAT_COARSE to 1
+// ---
+static int cell_step(int i, int j) {
+	int 	s;	// side of block
+
+	for(s = HEAT_GRID / HEAT_COARSE; s > 1; s /= 2)
+		if(i % s == 0 && j % s == 0)
+			break;
+	return s;
+}
+
+// ---
+// Return the precision of a sample standing for a block of side s,
+// 1 for the first pass and one more for each next pass
+// int s: side of block (cells)
+// return: int - precision
+// ---
+static int step_precision(int s) {
+	int 	p;	// precision
+
+	for(p = 1; s < HEAT_GRID / HEAT_COARSE; s *= 2)
+		p++;
+	return p;
+}
+
+// ---
+// Fill order with every cell, coarse passes first
+// uint16_t* order: pointer to vector of HEAT_GRID^2 cells
+// return: void
+// ---
+static void order_init(uint16_t* order) {
+	int 	s;			// side of block of a pass
+	int 	i, j;		// column and row of cell
+	int 	n = 0;		// cells ordered
+
+	for(s = HEAT_GRID / HEAT_COARSE; s >= 1; s /= 2)
+		for(j = 0; j < HEAT_GRID; j += s)
+			for(i = 0; i < HEAT_GRID; i += s)
+				if(cell_step(i, j) == s)
+					order[n++] = j * HEAT_GRID + i;
+}
+
+//------------------------------------------
+// PRIVATE: WORKERS
+//------------------------------------------
+
+// ---
+// Write outcome in the block of a sample, unless a finer sample did it
+// heat_map* m: pointer to map
+// int i: column of sample
+// int j: row of sample
+// int s: side of block
+// int outcome: SIM_* outcome of sample
+// return: void
+// ---
+static void fill_block(struct heat_map* m, int i, int j, int s, int outcome) {
+	uint8_t	c;			// new cell value
+	uint8_t old;		// cell value seen
+	int 	x, y;		// cell in block
+
+	c = step_precision(s) << 2 | outcome;
+	for(y = j; y < j + s; y++)
+		for(x = i; x < i + s; x++) {
+			old = atomic_load(&m->cell[y * HEAT_GRID + x]);
+			while(PRECISION(old) < PRECISION(c) &&
+				!atomic_compare_exchange_weak(&m->cell[y * HEAT_GRID + x],
+					&old, c))
+				;
+		}
+}
+
+// ---
+// Simulate the HEAT_BATCH start positions of a job
+// heat* h: pointer to heat cache
+// heat_map* m: pointer to map
+// uint32_t job: job number [0, HEAT_JOBS)
+// return: void
+// ---
+static void run_job(struct heat* h, struct heat_map* m, uint32_t job) {
+	struct 	sim s;				// headless simulation
+	struct 	heat_cfg* cfg;		// configuration of map
+	float 	b_pos[SP_DIM];		// ball start position
+	float 	side;				// side of a cell (m)
+	int 	i, j, k;			// column, row and order index
+
+	cfg = &m->cfg;
+	side = (cfg->wrl_f - cfg->wrl_i) / HEAT_GRID;
+	for(k = job * HEAT_BATCH; k < (job + 1) * HEAT_BATCH; k++) {
+		i = h->order[k] % HEAT_GRID;
+		j = h->order[k] / HEAT_GRID;
+
+		// ball starts at the centre of cell
+		b_pos[X] = cfg->wrl_i + (i + 0.5) * side;
+		b_pos[Y] = cfg->wrl_i + (j + 0.5) * side;
+		b_pos[Z] = cfg->b_z;
+		sim_init(&s, cfg->d_pos, b_pos, cfg->pw, cfg->dir);
+		fill_block(m, i, j, cell_step(i, j), sim_run(&s));
+		atomic_fetch_add(&m->done, 1);
+	}
+}
+
+// ---
+// Worker: claim jobs of the active map, sleep when there are none.
+// A map is marked busy before its jobs are claimed, so that it is not
+// replaced under the worker.
+// void* arg: pointer to heat cache
+// return: void
+// ---
+static void* heat_worker(void* arg) {
+	struct 	heat* h = arg;		// heat cache
+	struct 	heat_map* m;		// map being simulated
+	uint32_t job;				// job claimed
+	int 	a;					// active map index
+
+	while(1) {
+		a = atomic_load(&h->active);
+		if(a < 0) {
+			while(sem_wait(&h->work) && errno == EINTR)
+				;
+			continue;
+		}
+
+		m = &h->map[a];
+		atomic_fetch_add(&m->busy, 1);
+		if(atomic_load(&h->active) != a) {
+			atomic_fetch_sub(&m->busy, 1);
+			continue;
+		}
+
+		job = atomic_fetch_add(&m->next, 1);
+		if(job < HEAT_JOBS)
+			run_job(h, m, job);
+		atomic_fetch_sub(&m->busy, 1);
+
+		if(job >= HEAT_JOBS)
+			while(sem_wait(&h->work) && errno == EINTR)
+				;
+	}
+	return NULL;
+}
+
+// ---
+// Make map a the active one and wake up the workers
+// heat* h: pointer to heat cache
+// int a: map index
+// return: void
+// ---
+static void set_active(struct heat* h, int a) {
+	int 	i;	// worker index
+
+	if(atomic_load(&h->active) == a)
+		return;
+	atomic_store(&h->active, a);
+	if(atomic_load(&h->map[a].next) < HEAT_JOBS)
+		for(i = 0; i < h->workers; i++)
+			sem_post(&h->work);
+}
+
+//------------------------------------------
+// PUBLIC: CREATION
+//------------------------------------------
+
+// ---
+// Create the cache and start workers (background, below every rt task)
+// int workers: number of worker threads
+// return: heat* - pointer to heat cache, NULL in case of error
+// ---
+struct heat* heat_create(int workers) {
+	struct 	heat* h;	// new heat cache
+	pthread_t id;		// worker id
+	int 	i;			// worker index
+
+	h = calloc(1, sizeof(struct heat));
+	if(h == NULL)
+		return NULL;
+
+	order_init(h->order);
+	atomic_init(&h->active, -1);
+	h->workers = workers;
+	sem_init(&h->work, 0, 0);
+	for(i = 0; i < workers; i++)
+		bg_task_create(&id, heat_worker, h);
+	return h;
+}
+
+//------------------------------------------
+// PUBLIC: REQUEST
+//------------------------------------------
+
+// ---
+// Select map of cfg, simulated if not cached; NULL cfg stops the workers.
+// A missing map replaces the least recently used one not being simulated.
+// heat* h: pointer to heat cache
+// heat_cfg* cfg: pointer to configuration, NULL if none
+// return: heat_map* - pointer to map of cfg, NULL if cfg is NULL
+// ---
+struct heat_map* heat_request(struct heat* h, struct heat_cfg* cfg) {
+	struct 	heat_map* m;	// map of cfg
+	int 	i, a = -1;		// map index, map selected
+
+	h->clock++;
+	if(cfg == NULL) {
+		atomic_store(&h->active, -1);
+		return NULL;
+	}
+
+	for(i = 0; i < HEAT_CACHE && a < 0; i++)
+		if(h->map[i].used && !memcmp(&h->map[i].cfg, cfg, sizeof(*cfg)))
+			a = i;
+
+	if(a < 0) {
+		atomic_store(&h->active, -1);
+		for(i = 0; i < HEAT_CACHE; i++)
+			if(atomic_load(&h->map[i].busy) == 0 &&
+					(a < 0 || h->map[i].used < h->map[a].used))
+				a = i;
+		if(a < 0)
+			return NULL;
+
+		m = &h->map[a];
+		m->cfg = *cfg;
+		atomic_store(&m->next, 0);
+		atomic_store(&m->done, 0);
+		for(i = 0; i < HEAT_GRID * HEAT_GRID; i++)
+			atomic_store_explicit(&m->cell[i], 0, memory_order_relaxed);
+	}
+
+	h->map[a].used = h->clock;
+	set_active(h, a);
+	return &h->map[a];
+}
+
+//------------------------------------------
+// PUBLIC: READ
+//------------------------------------------
+
+// ---
+// Return SIM_* outcome of cell (column i, row j), best known so far
+// heat_map* m: pointer to map
+// int i: column of cell [0, HEAT_GRID)
+// int j: row of cell [0, HEAT_GRID)
+// return: int - SIM_* outcome, SIM_UNKNOWN if not simulated yet
+// ---
+int heat_cell(struct heat_map* m, int i, int j) {
+	return OUTCOME(atomic_load_explicit(&m->cell[j * HEAT_GRID + i],
+		memory_order_relaxed));
+}
+
+// ---
+// Return number of start positions simulated so far
+// heat_map* m: pointer to map
+// return: uint32_t - start positions simulated [0, HEAT_GRID^2]
+// ---
+uint32_t heat_done(struct heat_map* m) {
+	return atomic_load(&m->done);
+}
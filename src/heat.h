@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// HEAT_H: CATCHABILITY OF EVERY BALL START POSITION, COMPUTED IN BACKGROUND
+//-----------------------------------------------------------------------------
+
+#ifndef HEAT_H
+#define HEAT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include "sim.h"
+
+#define HEAT_GRID		64		// cells for each side of square (power of 2)
+#define HEAT_COARSE		8		// cells for each side of first pass
+#define HEAT_BATCH		16		// start positions simulated by a job
+#define HEAT_JOBS		(HEAT_GRID * HEAT_GRID / HEAT_BATCH)	// jobs of a map
+#define HEAT_CACHE		8		// configurations kept (more than workers)
+#define HEAT_WORKERS	3		// background simulation threads
+
+struct heat_cfg {				// what a map depends on
+	float 	d_pos[SP_DIM];		// drone initial position (real coord)
+	float 	b_z;				// ball initial height (m)
+	float 	pw;					// throw power
+	float 	dir;				// throw direction
+	float 	wrl_i, wrl_f;		// square of ball start positions (real coord)
+};
+
+struct heat_map {				// catchability of one configuration
+	struct 	heat_cfg cfg;		// configuration
+	long 	used;				// last request, for LRU replacement
+	_Atomic uint32_t next;		// next job to be claimed
+	_Atomic uint32_t done;		// start positions simulated
+	_Atomic int busy;			// workers simulating it
+	_Atomic uint8_t cell[HEAT_GRID * HEAT_GRID];	// precision << 2 | outcome
+};
+
+struct heat {					// cache of maps and worker pool
+	struct 	heat_map map[HEAT_CACHE];	// cached maps (used 0 if empty)
+	_Atomic int active;			// map simulated by workers, -1 none
+	long 	clock;				// number of requests
+	int 	workers;			// number of workers
+	sem_t 	work;				// wakes idle workers
+	uint16_t order[HEAT_GRID * HEAT_GRID];	// cells from coarse to fine
+};
+
+//------------------------------------------
+// PUBLIC: CREATION
+//------------------------------------------
+
+// Create the cache and start workers (background, below every rt task)
+struct heat* heat_create(int workers);
+
+//------------------------------------------
+// PUBLIC: REQUEST (only one thread)
+//------------------------------------------
+
+// Select map of cfg, simulated if not cached; NULL cfg stops the workers
+struct heat_map* heat_request(struct heat* h, struct heat_cfg* cfg);
+
+//------------------------------------------
+// PUBLIC: READ (any thread, while map is selected)
+//------------------------------------------
+
+// Return SIM_* outcome of cell (column i, row j), best known so far
+int heat_cell(struct heat_map* m, int i, int j);
+
+// Return number of start positions simulated so far
+uint32_t heat_done(struct heat_map* m);
+
+#endif
@@ -0,0 +1,361 @@
+#include "jrn.h"
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//------------------------------------------
+// PRIVATE: RE-SIMULATION STATE
+//------------------------------------------
+
+struct resim {								// journal being re-simulated
+	struct 	replay* rp;						// mapped flight record
+	struct 	replay_cur jc[JRN_NSTREAM];		// journal streams
+	const struct jrn_entry* head[JRN_NSTREAM];	// next entry (NULL at end)
+	struct 	replay_cur sc[JRN_NSTATE];		// recorded states
+	int 	has_rec[JRN_NSTATE];			// states recorded, to be compared
+	char* 	hist[JRN_NSTATE];				// states by bus sample number
+	char* 	have[JRN_NSTATE];				// 1 if sample has been computed
+	uint64_t cap;							// samples of each state
+	uint64_t last[JRN_NSTATE];				// last sample computed
+	long 	num[JRN_STATE + 1];				// entries done, by type
+	long 	compared, diffs;				// states compared, different
+	uint64_t t_diff;						// release of first difference
+	int 	type_diff;						// type of first different job
+};
+
+static const char* jrn_name[JRN_NSTREAM] = 	// journal streams
+	{JRN_SDRN, JRN_SBLL, JRN_SDRV, JRN_SSPV};
+static const char* state_name[JRN_NSTATE] = // recorded state streams
+	{"drone", "ball", "control"};
+static const size_t state_size[JRN_NSTATE] = {	// size of states
+	sizeof(struct dstate), sizeof(struct bstate), sizeof(struct cstate)};
+
+// ---
+// Move to next entry of journal stream s
+// resim* r: pointer to re-simulation
+// int s: journal stream [0, JRN_NSTREAM)
+// return: void
+// ---
+static void next_entry(struct resim* r, int s) {
+	const struct rec_item* it = replay_next(r->rp, &r->jc[s]);	// record
+
+	r->head[s] = (it != NULL) ? (const struct jrn_entry*)it->data : NULL;
+}
+
+// ---
+// Free what has been allocated by resim_open
+// resim* r: pointer to re-simulation
+// return: void
+// ---
+static void resim_close(struct resim* r) {
+	int 	k;	// state index
+
+	for(k = 0; k < JRN_NSTATE; k++) {
+		free(r->hist[k]);
+		free(r->have[k]);
+	}
+	if(r->rp != NULL)
+		replay_close(r->rp);
+}
+
+// ---
+// Map record file and allocate a slot for every sample a journal can hold
+// resim* r: pointer to re-simulation, zeroed
+// char* file: path of record file
+// return: int - 0 in case of success, -1 if there is no valid journal
+// ---
+static int resim_open(struct resim* r, const char* file) {
+	struct 	replay_track* tr;	// track of a stream
+	uint32_t k;					// chunk of track or state index
+	int 	s, id;				// journal stream, stream identifier
+
+	r->rp = replay_open(file);
+	if(r->rp == NULL)
+		return -1;
+
+	for(s = 0; s < JRN_NSTREAM; s++) {
+		id = replay_stream(r->rp, jrn_name[s]);
+		if(id < 0 || r->rp->h->stream[id].size <
+				sizeof(struct rec_item) + sizeof(struct jrn_entry))
+			return -1;
+		replay_seek(r->rp, &r->jc[s], id, 0);
+		tr = &r->rp->track[id];
+		for(k = 0; k < tr->n; k++)
+			r->cap += tr->count[k];
+	}
+	r->cap += 2;
+
+	for(k = 0; k < JRN_NSTATE; k++) {
+		id = replay_stream(r->rp, state_name[k]);
+		r->has_rec[k] = id >= 0 && r->rp->h->stream[id].size >=
+			sizeof(struct rec_item) + state_size[k];
+		if(r->has_rec[k])
+			replay_seek(r->rp, &r->sc[k], id, 0);
+
+		// sample 0 (nothing read) is a zero state
+		r->hist[k] = calloc(r->cap, state_size[k]);
+		r->have[k] = calloc(r->cap, 1);
+		if(r->hist[k] == NULL || r->have[k] == NULL)
+			return -1;
+		r->have[k][0] = 1;
+	}
+
+	for(s = 0; s < JRN_NSTREAM; s++)
+		next_entry(r, s);
+	return 0;
+}
+
+//------------------------------------------
+// PRIVATE: JOB EXECUTION
+//------------------------------------------
+
+// ---
+// Return 1 if every sample read by entry e has been computed
+// resim* r: pointer to re-simulation
+// jrn_entry* e: pointer to entry
+// return: int - 1 if e can be done, 0 otherwise
+// ---
+static int ready(struct resim* r, const struct jrn_entry* e) {
+	int 	k;	// state index
+
+	for(k = 0; k < JRN_NSTATE; k++)
+		if(e->in[k] >= r->cap || !r->have[k][e->in[k]])
+			return 0;
+	return 1;
+}
+
+// ---
+// Copy sample num of state k in dest
+// resim* r: pointer to re-simulation
+// int k: state index
+// uint64_t num: sample number (ready)
+// void* dest: pointer to state
+// return: void
+// ---
+static void load(struct resim* r, int k, uint64_t num, void* dest) {
+	memcpy(dest, r->hist[k] + num * state_size[k], state_size[k]);
+}
+
+// ---
+// Keep state src as sample num of state k (nothing if num is 0)
+// resim* r: pointer to re-simulation
+// int k: state index
+// uint64_t num: sample number
+// void* src: pointer to state
+// return: int - 0 in case of success, -1 if num is beyond the journal
+// ---
+static int store(struct resim* r, int k, uint64_t num, const void* src) {
+	if(num == 0)
+		return 0;
+	if(num >= r->cap)
+		return -1;
+	memcpy(r->hist[k] + num * state_size[k], src, state_size[k]);
+	r->have[k][num] = 1;
+	r->last[k] = num;
+	return 0;
+}
+
+// ---
+// Compare state computed by job e with the one recorded by the live task
+// resim* r: pointer to re-simulation
+// int k: state index
+// void* st: pointer to state computed
+// jrn_entry* e: pointer to job
+// return: void
+// ---
+static void check(struct resim* r, int k, const void* st,
+		const struct jrn_entry* e) {
+	const struct rec_item* it;	// recorded state
+
+	if(!r->has_rec[k] || (it = replay_next(r->rp, &r->sc[k])) == NULL)
+		return;
+
+	r->compared++;
+	if(memcmp(it->data, st, state_size[k]) == 0)
+		return;
+	if(r->diffs++ == 0) {
+		r->t_diff = e->release;
+		r->type_diff = e->type;
+	}
+}
+
+// ---
+// Do entry e as the live task or supervisor did it
+// resim* r: pointer to re-simulation
+// jrn_entry* e: pointer to entry (ready)
+// return: int - 0 in case of success, -1 if journal is not consistent
+// ---
+static int run_entry(struct resim* r, const struct jrn_entry* e) {
+	struct 	dstate d;	// drone state
+	struct 	bstate b;	// ball state
+	struct 	cstate c;	// controller state
+
+	switch(e->type) {
+		case JRN_DRN:
+			load(r, JRN_D, e->in[JRN_D], &d);
+			load(r, JRN_C, e->in[JRN_C], &c);
+			d_up_state(&d, &c, e->dt);
+			check(r, JRN_D, &d, e);
+			return store(r, JRN_D, e->out[JRN_D], &d);
+		case JRN_BLL:
+			load(r, JRN_B, e->in[JRN_B], &b);
+			load(r, JRN_D, e->in[JRN_D], &d);
+			b_up_state(&b, &d, e->dt);
+			check(r, JRN_B, &b, e);
+			return store(r, JRN_B, e->out[JRN_B], &b);
+		case JRN_DRV:
+			load(r, JRN_D, e->in[JRN_D], &d);
+			load(r, JRN_B, e->in[JRN_B], &b);
+			memset(&c, 0, sizeof(c));
+			c_driver_control(&d, &b, &c);
+			check(r, JRN_C, &c, e);
+			return store(r, JRN_C, e->out[JRN_C], &c);
+		case JRN_INIT:
+			load(r, JRN_D, e->in[JRN_D], &d);
+			load(r, JRN_B, e->in[JRN_B], &b);
+			jrn_place(e, &d, &b);
+			return store(r, JRN_D, e->out[JRN_D], &d) |
+				store(r, JRN_B, e->out[JRN_B], &b);
+		case JRN_RESET:
+			memset(&d, 0, sizeof(d));
+			memset(&b, 0, sizeof(b));
+			memset(&c, 0, sizeof(c));
+			return store(r, JRN_D, e->out[JRN_D], &d) |
+				store(r, JRN_B, e->out[JRN_B], &b) |
+				store(r, JRN_C, e->out[JRN_C], &c);
+		case JRN_STATE:
+			return 0;
+		default:
+			return -1;
+	}
+}
+
+// ---
+// Print what has been re-simulated, how fast and whether it is bit-exact
+// resim* r: pointer to re-simulation
+// uint64_t t0, t: release of first and last entry done (us)
+// double wall: time taken (s)
+// char* end: why re-simulation ended
+// return: void
+// ---
+static void resim_report(struct resim* r, uint64_t t0, uint64_t t,
+		double wall, const char* end) {
+	static const char* job[] = {"drone", "ball", "driver"};	// job names
+	struct 	dstate d;	// last drone state
+	struct 	bstate b;	// last ball state
+	double 	span;		// virtual time elapsed (s)
+	double 	at;			// virtual time from begin of record (s)
+
+	span = (t - t0) / 1E6;
+	at = ((double)t - r->rp->t_begin) / 1E6;
+	load(r, JRN_D, r->last[JRN_D], &d);
+	load(r, JRN_B, r->last[JRN_B], &b);
+
+	printf("-----------------------------------------------\n");
+	printf("SESSION RE-SIMULATION (virtual clock):\n");
+	printf("\tjobs: drone %ld - ball %ld - driver %ld - inputs: %ld\n",
+		r->num[JRN_DRN], r->num[JRN_BLL], r->num[JRN_DRV],
+		r->num[JRN_INIT] + r->num[JRN_RESET] + r->num[JRN_STATE]);
+	printf("\tvirtual: %.3f s - wall: %.3f ms - %.0fx real time\n",
+		span, wall * 1E3, wall > 0 ? span / wall : 0);
+	if(r->diffs == 0)
+		printf("\tstates compared: %ld - bit-exact\n", r->compared);
+	else
+		printf("\tstates compared: %ld - different: %ld - first at %.3f s "
+			"(%s job)\n", r->compared, r->diffs,
+			((double)r->t_diff - r->rp->t_begin) / 1E6, job[r->type_diff]);
+	printf("\tend: %s at %.3f s\n", end, at);
+	printf("\tdrone: %.4f %.4f %.4f - ball: %.4f %.4f %.4f\n",
+		d.fx_lin_pos[X], d.fx_lin_pos[Y], d.fx_lin_pos[Z],
+		b.position[X], b.position[Y], b.position[Z]);
+	printf("-----------------------------------------------\n");
+}
+
+//------------------------------------------
+// PUBLIC: LIVE AND RE-SIMULATION
+//------------------------------------------
+
+// ---
+// Place drone and ball as in entry e: used by supervisor and re-simulation,
+// so that both compute the same initial states
+// jrn_entry* e: pointer to entry (JRN_INIT) with positions, power and dir
+// dstate* d: pointer to drone state
+// bstate* b: pointer to ball state
+// return: void
+// ---
+void jrn_place(const struct jrn_entry* e, struct dstate* d, struct bstate* b) {
+	d_set_init_pos(d, (float*)e->d_pos);
+	b_set_init_pos(b, (float*)e->b_pos);
+	b_set_init_vel(b, e->pw / 2, e->dir);
+}
+
+//------------------------------------------
+// PUBLIC: RE-SIMULATION
+//------------------------------------------
+
+// ---
+// Re-simulate the journal of a record file as fast as possible. Every job
+// reads the very samples the live one read, so thread interleaving of the
+// run is reproduced; among ready entries the earliest released goes first.
+// char* file: path of record file (recorded with journal)
+// double until: record time (s from begin) to stop at, 0 for whole journal
+// return: int - 0 if every state is bit-exact, -1 otherwise
+// ---
+int jrn_resim(const char* file, double until) {
+	struct 	resim r = {0};			// re-simulation
+	struct 	timespec w0, w1;		// wall time at begin and end
+	const struct jrn_entry* e;		// entry to be done
+	const char* end = "journal done";	// why re-simulation ended
+	uint64_t t_stop = UINT64_MAX;	// release to stop at (us)
+	uint64_t t0 = 0, t = 0;			// release of first and last entry done
+	int 	s, best;				// journal stream, stream of next entry
+
+	if(resim_open(&r, file)) {
+		fprintf(stderr, "%s: no journal in flight record\n", file);
+		resim_close(&r);
+		return -1;
+	}
+	if(until > 0)
+		t_stop = r.rp->t_begin + until * 1E6;
+
+	clock_gettime(CLOCK_MONOTONIC, &w0);
+	while(1) {
+		best = -1;
+		for(s = 0; s < JRN_NSTREAM; s++)
+			if(r.head[s] != NULL && ready(&r, r.head[s]) && (best < 0 ||
+					r.head[s]->release < r.head[best]->release))
+				best = s;
+
+		if(best < 0) {
+			for(s = 0; s < JRN_NSTREAM; s++)
+				if(r.head[s] != NULL)
+					end = "journal incomplete";
+			break;
+		}
+		e = r.head[best];
+		if(e->release > t_stop) {
+			end = "stopped";
+			break;
+		}
+		if(run_entry(&r, e)) {
+			end = "journal inconsistent";
+			break;
+		}
+
+		if(t0 == 0)
+			t0 = e->release;
+		t = e->release;
+		r.num[e->type]++;
+		next_entry(&r, best);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &w1);
+
+	resim_report(&r, t0, t, (w1.tv_sec - w0.tv_sec) +
+		(w1.tv_nsec - w0.tv_nsec) / 1E9, end);
+	s = (r.diffs == 0 && (!strcmp(end, "journal done") ||
+		!strcmp(end, "stopped"))) ? 0 : -1;
+	resim_close(&r);
+	return s;
+}
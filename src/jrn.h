@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// JRN_H: SESSION JOURNAL AND DETERMINISTIC RE-SIMULATION ON A VIRTUAL CLOCK
+//-----------------------------------------------------------------------------
+
+#ifndef JRN_H
+#define JRN_H
+
+#include <stdint.h>
+#include "physics.h"
+
+#define JRN_DRN			0		// drone job: drone and control in, drone out
+#define JRN_BLL			1		// ball job: ball and drone in, ball out
+#define JRN_DRV			2		// driver job: drone and ball in, control out
+#define JRN_INIT		3		// objects placed: drone and ball in and out
+#define JRN_RESET		4		// objects reset: every state out
+#define JRN_STATE		5		// simulation state changed (no data)
+
+#define JRN_D			0		// drone state (index of in and out)
+#define JRN_B			1		// ball state
+#define JRN_C			2		// controller state
+#define JRN_NSTATE		3		// states journaled
+
+#define JRN_NSTREAM		4		// journal streams (one for each writer)
+#define JRN_SDRN		"j_drone"	// journal stream of drone task
+#define JRN_SBLL		"j_ball"	// journal stream of ball task
+#define JRN_SDRV		"j_driver"	// journal stream of driver task
+#define JRN_SSPV		"j_super"	// journal stream of supervisor
+
+struct jrn_entry {				// journal entry: a job or a panel input
+	int32_t type;				// JRN_*
+	int32_t state;				// new simulation state (JRN_STATE)
+	uint64_t release;			// job release or input time (us, monotonic)
+	uint64_t in[JRN_NSTATE];	// bus samples read, 0 if none
+	uint64_t out[JRN_NSTATE];	// bus samples written, 0 if none
+	float 	dt;					// step of job (s)
+	float 	pw, dir;			// throw power and direction (JRN_INIT)
+	float 	d_pos[SP_DIM];		// drone placed (real coord, JRN_INIT)
+	float 	b_pos[SP_DIM];		// ball placed (real coord, JRN_INIT)
+};
+
+//------------------------------------------
+// PUBLIC: LIVE AND RE-SIMULATION
+//------------------------------------------
+
+// Place drone and ball as in entry e (JRN_INIT)
+void jrn_place(const struct jrn_entry* e, struct dstate* d, struct bstate* b);
+
+//------------------------------------------
+// PUBLIC: RE-SIMULATION
+//------------------------------------------
+
+// Re-simulate journal of a record file up to until (s, 0 whole), 0 if exact
+int jrn_resim(const char* file, double until);
+
+#endif
@@ -7,10 +7,24 @@
 #include <stdio.h>
 #include <sched.h>
 #include <semaphore.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/mman.h>
 #include "ptask.h" 
 #include "physics.h"
 #include "userpanel.h"
 #include "udp.h"
+#include "bus.h"
+#include "spsc.h"
+#include "shmem.h"
+#include "telem.h"
+#include "sim.h"
+#include "rec.h"
+#include "replay.h"
+#include "jrn.h"
+#include "prof.h"
+#include "trace.h"
 
 //-----------------------------------------------------
 // TASK CONSTANTS
@@ -21,13 +35,14 @@
 #define UDP_TASK	3			// ddp packet sender task
 #define PNL_TASK	4			// user panel handler task
 #define SPV_TASK	5			// supervisor task
-#define NUM_TASK	6			// number of task
-#define DRV_PER		20			// drv task period (ms)
-#define DRN_PER		30			// drn task period (ms)
-#define BLL_PER		30			// bll task period (ms)
+#define RPL_TASK	6			// record playback task
+#define NUM_TASK	7			// number of task
+#define DRV_PER		SIM_DRV_PER	// drv task period (ms)
+#define DRN_PER		SIM_DRN_PER	// drn task period (ms)
+#define BLL_PER		SIM_BLL_PER	// bll task period (ms)
 #define UDP_PER		30			// udp task period (ms)
 #define PNL_PER		30			// pnl task period (ms)
-#define SPV_PER		50			// spv task period (ms)
+#define RPL_PER		30			// rpl task period (ms)
 #define MSTOS(NUM)	NUM/1000.0	// millisecond to second macro
 #define DRV_PRIO	2			// drv task priority [1low-99high]
 #define DRN_PRIO	3			// drn task priority [1low-99high]
@@ -35,6 +50,7 @@
 #define UDP_PRIO	3			// udp task priority [1low-99high]
 #define PNL_PRIO	2			// pnl task priority [1low-99high]
 #define SPV_PRIO	1			// spv task priority [1low-99high]
+#define RPL_PRIO	3			// rpl task priority [1low-99high]
 
 //-----------------------------------
 // STATE OF GAME
@@ -49,14 +65,132 @@
 //-----------------------------------------------------
 #define DEST_IP "131.114.193.90"
 #define UDP_PORT 8000
+#define BLL_REFRESH		1000	// ball model re-send period (ms)
+
+//-----------------------------------------------------
+// STATE BUS TOPICS
+//-----------------------------------------------------
+#define DRN_TOPIC	0			// drone state topic
+#define BLL_TOPIC	1			// ball state topic
+#define CTR_TOPIC	2			// controller state topic
+#define PNL_TOPIC	3			// panel state topic
+#define PRD_TOPIC	4			// outcome of last rollout
+#define RPL_TOPIC	5			// playback state of a replay
+#define HISTORY		8			// samples kept by each topic
+#define BUS_MEM		(64 << 10)	// memory reserved to the bus (byte)
+
+//-----------------------------------------------------
+// DEPLOYMENT (ONE PROCESS OR RT CORE AND PANEL APART)
+//-----------------------------------------------------
+#define DEPLOY_ONE		0		// rt tasks and panel in one process
+#define DEPLOY_CORE		1		// rt tasks only, state in shared memory
+#define DEPLOY_PANEL	2		// panel only, attached to a running core
+#define DEPLOY_REPLAY	3		// panel and udp fed by a flight record
+#define DEPLOY_RESIM	4		// journal of a flight record re-simulated
+#define SHM_NAME	"/catchingdrone"	// name of shared memory region
+#define CMD_MEM		(4 << 10)	// memory reserved to command queue (byte)
+#define TLM_MEM		sizeof(struct telem)	// memory of telemetry (byte)
+#define SHM_MEM		(BUS_MEM + CMD_MEM + TLM_MEM)	// shared region (byte)
+#define ATTACH_WAIT	100			// wait between attach attempts (ms)
+#define STALL_EVERY	10			// panel frames between two stalls
+#define STALL_MEM	(1 << 20)	// fresh memory touched while stalled (byte)
+
+//-----------------------------------------------------
+// TELEMETRY SIGNALS (STRIP CHARTS)
+//-----------------------------------------------------
+#define TLM_ALT		0			// drone altitude (m)
+#define TLM_ROLL	1			// drone roll angle (rad)
+#define TLM_PITCH	2			// drone pitch angle (rad)
+#define TLM_YAW		3			// drone yaw angle (rad)
+#define TLM_VX		4			// drone x velocity (m/s)
+#define TLM_VY		5			// drone y velocity (m/s)
+#define TLM_DC		6			// rotor duty cycles, one per rotor [6-9]
+#define TLM_CERR	10			// drone distance from predicted catch (m)
+#define TLM_BLLZ	11			// ball height (m)
+
+//-----------------------------------------------------
+// FLIGHT RECORDER STREAMS
+//-----------------------------------------------------
+#define REC_DRN		0			// drone states
+#define REC_BLL		1			// ball states
+#define REC_CTR		2			// controller states
+#define REC_JDRN	3			// journal of drone task
+#define REC_JBLL	4			// journal of ball task
+#define REC_JDRV	5			// journal of driver task
+#define REC_JSPV	6			// journal of supervisor (panel inputs)
+#define REC_DETACH	DRN_PER		// puts in flight end within a job (ms)
+
+//-----------------------------------------------------
+// REPLAY OF A FLIGHT RECORD
+//-----------------------------------------------------
+#define RPL_SEEK	0			// move playback by arg seconds
+#define RPL_JUMP	1			// move playback to fraction arg of record
+#define RPL_SPEED	2			// multiply playback speed by arg
+#define RPL_PAUSE	3			// pause or resume playback
+#define RPL_STEP	5			// seek of an arrow key (s)
+#define RPL_FACTOR	2			// speed change of an arrow key
+#define RPL_QLEN	16			// length of replay command queue (power of 2)
+
+struct rpl_cmd {				// command posted by panel to replay task
+	int 	type;				// RPL_SEEK, RPL_JUMP, RPL_SPEED or RPL_PAUSE
+	float 	arg;				// seconds, fraction or factor
+};
+
+//-----------------------------------------------------
+// SUPERVISOR COMMANDS
+//-----------------------------------------------------
+#define CMD_STATE	0			// panel changed simulation state
+#define CMD_CONFIG	1			// panel moved drone/ball or changed throw
+#define CMD_QUIT	2			// panel has been closed
+#define CMD_QLEN	16			// length of command queue (power of 2)
+
+struct command {				// command posted by panel to supervisor
+	int 	type;				// CMD_STATE, CMD_CONFIG or CMD_QUIT
+	int 	state;				// simulation state asked by panel
+	uint64_t stamp;				// post time (us, monotonic clock)
+	uint64_t input;				// arrival of input causing it (us), 0 if none
+};
+
+//-----------------------------------------------------
+// CATCH PREDICTION
+//-----------------------------------------------------
+#define PRD_QLEN	4			// length of rollout request queue (power of 2)
+
+struct predict_req {			// throw to be simulated by predict task
+	uint32_t id;				// configuration number
+	float 	d_pos[SP_DIM];		// drone initial position (real coord)
+	float 	b_pos[SP_DIM];		// ball initial position (real coord)
+	float 	pw;					// throw power
+	float 	dir;				// throw direction
+};
+
+struct cmd_stat {				// command latency statistics
+	long 	num;				// number of commands served
+	uint64_t min;				// min latency from post to done (us)
+	uint64_t max;				// max latency from post to done (us)
+	uint64_t sum;				// sum of latencies (us)
+};
 
 //-----------------------------------------------------
 // SIMULATION GLOBAL DATA STRUCTURES
 //-----------------------------------------------------
-struct dstate drone = 	{0};	// drone state structure 
-struct bstate ball = 	{0};	// ball state structure
-struct pstate panel = 	{0};	// panel state structure
-struct cstate control = {0}; 	// controller state structure
+struct bus* bus;				// drone, ball, control and panel states
+struct spsc* cmd_queue;			// commands from panel to supervisor
+struct telem* tlm;				// signals shown by panel strip charts
+struct rec* rec = NULL;			// flight recorder, NULL if not recording
+int 	gui_stall = 0;			// ms the panel stalls every STALL_EVERY frames
+int 	udp_model = 0;			// 1: ball sent as trajectory model, 0: pos
+struct cmd_stat cmd_lat			// latency of supervisor transitions
+							= {0};
+struct cmd_stat in_lat			// latency from input event to transition
+							= {0};
+struct spsc* prd_queue;			// rollout requests from panel to predict task
+struct predict_req prd_last		// last configuration asked to predict task
+							= {0};
+struct replay* rpl = NULL;		// flight record played, NULL if live
+struct spsc* rpl_queue;			// playback commands from panel to replay task
+double 	rpl_speed = 1;			// initial playback speed
+double 	rpl_from = 0;			// initial playback position (s)
 
 //-----------------------------------------------------
 // TASK GLOBAL DATA STRUCTURE
@@ -64,10 +198,6 @@ struct cstate control = {0}; 	// controller state structure
 struct task_par tp[NUM_TASK] 	// vector of task parameter
 							= {0};
 pthread_t task_id[NUM_TASK];	// task id vector
-pthread_mutex_t mutex_d, 		// drone struct mutex
-				mutex_b, 		// ball struct mutex
-				mutex_p, 		// panel struct mutex
-				mutex_c;		// controller struct mutex
 
 //-----------------------------------------------------
 // TASK ROUTINE FUNCTIONS
@@ -78,12 +208,60 @@ void* drone_task();
 void* ball_task();
 void* driver_task();
 void* supervisor_task();
+void* predict_task();
+void* replay_task();
 
 //------------------------------------------------------
 // TASK PARAMETER UTILITY FUNCTIONS
 //------------------------------------------------------
 void tp_init();
 
+//------------------------------------------------------
+// STATE BUS UTILITY FUNCTIONS
+//------------------------------------------------------
+void bus_init(void* mem);
+int bus_attach();
+void telem_init();
+
+//------------------------------------------------------
+// FLIGHT RECORDER FUNCTIONS
+//------------------------------------------------------
+int rec_init(const char* file);
+uint64_t job_release(struct task_par* tp);
+
+//------------------------------------------------------
+// SUPERVISOR COMMAND FUNCTIONS
+//------------------------------------------------------
+void cmd_post(struct pstate* p_prev, struct pstate* p_copy);
+void cmd_serve(struct command* cmd, int* curr_state, int* first_run);
+void cmd_account(struct cmd_stat* st, uint64_t lat);
+void cmd_report();
+
+//------------------------------------------------------
+// REPLAY FUNCTIONS
+//------------------------------------------------------
+int replay_start(const char* file);
+void replay_control();
+void replay_serve(struct rpl_cmd* cmd, struct replay_clock* clk,
+	struct replay_stat* st);
+
+//------------------------------------------------------
+// CATCH PREDICTION FUNCTIONS
+//------------------------------------------------------
+void predict_start();
+void predict_update(struct pstate* p_copy, struct predict* pred);
+
+//------------------------------------------------------
+// PANEL STALL FUNCTIONS
+//------------------------------------------------------
+void panel_stall(int ms);
+
+//------------------------------------------------------
+// UDP MODEL STREAMING FUNCTIONS
+//------------------------------------------------------
+void ball_model_set(struct udp_ball_model* model, struct bstate* b_copy,
+	uint64_t t0);
+
 //-----------------------------------------------------
 // START/STOP TASK FUNCTIONS
 //-----------------------------------------------------
@@ -107,21 +285,157 @@ void react_to_pause(int prev_state);
 // MAIN FUNCTION
 //----------------------
 
-int main() {
+int main(int argc, char* argv[]) {
+	int 	opt;					// command line option
+	int 	deploy = DEPLOY_ONE;	// how tasks are split among processes
+	void* 	shm;					// shared memory region
+	char* 	rec_file = NULL;		// flight record file, NULL if none
+	char* 	trace_file = NULL;		// trace file, NULL if none
+	struct 	rec* r;					// flight recorder, detached at exit
+
+	// -o: panel drawn in memory, -s: input script (implies -o)
+	// -c: rt core process, -p: panel process, -g: panel stall (ms)
+	// -r: record rt task states in file
+	// -R: replay a record, -x: at speed, -j: from second
+	// -S: re-simulate the journal of a record (up to -j second)
+	// -P: count perf events in the jobs of rt tasks
+	// -T: trace task activations in a chrome trace file
+	// -m: stream the ball to UDP as a trajectory model
+	while((opt = getopt(argc, argv, "os:cpg:r:R:x:j:S:PT:m")) != -1) {
+		switch(opt) {
+			case 'o':
+				set_panel_backend(PNL_OFFSCREEN, NULL);
+				break;
+			case 's':
+				set_panel_backend(PNL_OFFSCREEN, optarg);
+				break;
+			case 'c':
+				deploy = DEPLOY_CORE;
+				break;
+			case 'p':
+				deploy = DEPLOY_PANEL;
+				break;
+			case 'g':
+				gui_stall = atoi(optarg);
+				break;
+			case 'r':
+				rec_file = optarg;
+				break;
+			case 'R':
+				deploy = DEPLOY_REPLAY;
+				rec_file = optarg;
+				break;
+			case 'x':
+				rpl_speed = atof(optarg);
+				break;
+			case 'j':
+				rpl_from = atof(optarg);
+				break;
+			case 'S':
+				deploy = DEPLOY_RESIM;
+				rec_file = optarg;
+				break;
+			case 'P':
+				perf_enable(1);
+				break;
+			case 'T':
+				trace_file = optarg;
+				break;
+			case 'm':
+				udp_model = 1;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-c | -p] [-o] [-s script] "
+					"[-g stall_ms] [-r record_file] [-P] [-T trace_file] [-m]\n"
+					"\t%s -R record_file [-o] [-s script] [-x speed] "
+					"[-j from_s]\n"
+					"\t%s -S record_file [-j until_s]\n",
+					argv[0], argv[0], argv[0]);
+				return 1;
+		}
+	}
+
+	// re-simulation runs on a virtual clock, no task needed
+	if(deploy == DEPLOY_RESIM)
+		return jrn_resim(rec_file, rpl_from) ? 1 : 0;
+
 	// stuff init
 	tp_init();
-	mutex_init(&mutex_d);
-	mutex_init(&mutex_c);
-	mutex_init(&mutex_b);
-	mutex_init(&mutex_p);
-	p_reset(&panel);
+	if(rec_file != NULL && (deploy == DEPLOY_ONE || deploy == DEPLOY_CORE) &&
+			rec_init(rec_file)) {
+		perror("flight recorder");
+		return 1;
+	}
+	if(trace_file != NULL && trace_start(trace_file)) {
+		perror(trace_file);
+		return 1;
+	}
+
+	switch(deploy) {
+		case DEPLOY_CORE:
+			shm = shmem_create(SHM_NAME, SHM_MEM);
+			if(shm == NULL) {
+				perror("shared memory");
+				return 1;
+			}
+			bus_init(shm);
 
-	// create main threads
-	p_task_create(&task_id[SPV_TASK], supervisor_task, &tp[SPV_TASK]);
-	p_task_create(&task_id[PNL_TASK], panel_task, &tp[PNL_TASK]);
+			// app terminate when panel process posts its quit
+			p_task_create(&task_id[SPV_TASK], supervisor_task, &tp[SPV_TASK]);
+			wait_for_task_end(task_id[SPV_TASK]);
+			shmem_remove(SHM_NAME, shm, SHM_MEM);
+			break;
+		case DEPLOY_PANEL:
+			if(bus_attach())
+				return 1;
 
-	// app terminate when user panel is closed
-	wait_for_task_end(task_id[PNL_TASK]);
+			// unprivileged: panel runs in main thread without rt priority
+			panel_task();
+			trace_stop();
+			jitter_handle(tp, NUM_TASK);
+			return 0;
+		case DEPLOY_REPLAY:
+			bus_init(NULL);
+			if(replay_start(rec_file)) {
+				fprintf(stderr, "%s: not a flight record\n", rec_file);
+				return 1;
+			}
+
+			// record feeds the outputs in place of rt tasks
+			p_task_create(&task_id[RPL_TASK], replay_task, &tp[RPL_TASK]);
+			task_start(1, 0, 0, 0);
+			p_task_create(&task_id[PNL_TASK], panel_task, &tp[PNL_TASK]);
+			wait_for_task_end(task_id[PNL_TASK]);
+			trace_stop();
+			jitter_handle(tp, NUM_TASK);
+			perf_handle(tp, NUM_TASK);
+			mutex_handle();
+			return 0;
+		default:
+			bus_init(NULL);
+
+			// create main threads
+			p_task_create(&task_id[SPV_TASK], supervisor_task, &tp[SPV_TASK]);
+			p_task_create(&task_id[PNL_TASK], panel_task, &tp[PNL_TASK]);
+
+			// app terminate when user panel is closed
+			wait_for_task_end(task_id[PNL_TASK]);
+			break;
+	}
+	// rt tasks may still put: they stop seeing the recorder before it closes
+	if(rec != NULL) {
+		r = rec;
+		rec = NULL;
+		usleep(REC_DETACH * 1000);
+		rec_close(r);
+	}
+	trace_stop();
+	cmd_report();
+	PROF_REPORT();
+	jitter_handle(tp, NUM_TASK);
+	perf_handle(tp, NUM_TASK);
+	mutex_handle();
+	return 0;
 }
 
 //----------------------
@@ -133,19 +447,39 @@ int main() {
 // return: void
 // ---
 void* udp_task() {
-	struct 	dstate d_copy;	// copy of drone state structure
-	struct 	bstate b_copy;	// copy of ball state structure
-	int 	sock;			// descriptor of a socket
+	struct 	dstate d_copy;				// copy of drone state structure
+	struct 	bstate b_copy;				// copy of ball state structure
+	struct 	bstate b_origin;			// ball state the model starts from
+	struct 	udp_ball_model model = {0};	// last ball model sent
+	int 	sock;						// descriptor of a socket
+	int 	refresh = 0;				// ms elapsed from last model sent
+	uint64_t num;						// number of ball sample read
 	
 	sock = udp_init(DEST_IP, UDP_PORT);
+	trace_thread("udp");
 	set_period(&tp[UDP_TASK]);
 	
 	while(1) {
-		safe_copy(&mutex_d, &d_copy, &drone, sizeof(struct dstate));
-		safe_copy(&mutex_b, &b_copy, &ball, sizeof(struct bstate));
+		bus_read(bus, DRN_TOPIC, &d_copy);
+		num = bus_read(bus, BLL_TOPIC, &b_copy);
+
+		if(!udp_model) {
+			udp_grap_send(
+				sock, d_copy.fx_lin_pos, d_copy.fx_ang_pos, b_copy.position);
+		} else {
+			udp_drone_send(sock, d_copy.fx_lin_pos, d_copy.fx_ang_pos);
 
-		udp_grap_send(
-			sock, d_copy.fx_lin_pos, d_copy.fx_ang_pos, b_copy.position);
+			// ball is sent only at discontinuities (and seldom re-sent)
+			if(model.epoch == 0 || b_off_model(&b_origin, &b_copy)) {
+				b_origin = b_copy;
+				ball_model_set(&model, &b_copy,
+					bus_stamp(bus, BLL_TOPIC, num) / 1000);
+				refresh = 0;
+			}
+			if(refresh == 0)
+				udp_ball_send(sock, &model);
+			refresh = (refresh + UDP_PER) % BLL_REFRESH;
+		}
 
 		if(deadline_miss(&tp[UDP_TASK])) 
 			deadline_handle(tp, NUM_TASK);
@@ -159,21 +493,45 @@ void* udp_task() {
 // ---
 void* panel_task() {
 	struct 	pstate p_copy;			// copy of panel state structure
+	struct 	pstate p_prev;			// panel state before user input
 	struct 	dstate d_copy;			// copy of drone state structure
 	struct 	bstate b_copy;			// copy of ball state structure
+	struct 	command quit = {CMD_QUIT};	// posted when panel is closed
+	struct 	predict pred = {0};		// prediction shown on map
+	struct 	replay_stat rpl_st = {0};	// playback state shown (replay)
 	int 	esc_key_pressed = 0;	// boolean that indicates esc key pressed
+	long 	frame = 0;				// number of frames drawn
 	
+	PROF_THREAD("panel");
+	trace_thread("panel");
+	set_panel_telem(tlm);
+	set_panel_heat(heat_create(HEAT_WORKERS));
 	init_panel();	
+	predict_start();
 	set_period(&tp[PNL_TASK]);
 	
 	while(!esc_key_pressed) {
-		safe_copy(&mutex_d, &d_copy, &drone, sizeof(struct dstate));
-		safe_copy(&mutex_b, &b_copy, &ball, sizeof(struct bstate));	
-		safe_copy(&mutex_p, &p_copy, &panel, sizeof(struct pstate));
+		bus_read(bus, DRN_TOPIC, &d_copy);
+		bus_read(bus, BLL_TOPIC, &b_copy);
+		bus_read(bus, PNL_TOPIC, &p_copy);
+		p_prev = p_copy;
+		if(rpl == NULL)
+			predict_update(&p_copy, &pred);
+		else {
+			bus_read(bus, RPL_TOPIC, &rpl_st);
+			set_panel_replay(&rpl_st);
+		}
 		
 		graphic_loop(&p_copy, d_copy.fx_lin_pos, b_copy.position);
 		
-		safe_copy(&mutex_p, &panel, &p_copy, sizeof(struct pstate));
+		bus_write(bus, PNL_TOPIC, &p_copy);
+		if(rpl == NULL)
+			cmd_post(&p_prev, &p_copy);
+		else
+			replay_control();
+
+		if(gui_stall && ++frame % STALL_EVERY == 0)
+			panel_stall(gui_stall);
 
 		esc_key_pressed = nb_get_esc_key();
 		if(deadline_miss(&tp[PNL_TASK])) 
@@ -181,6 +539,10 @@ void* panel_task() {
 		wait_for_period(&tp[PNL_TASK]);
 	}
 	exit_panel();
+
+	quit.stamp = udp_stamp();
+	spsc_push(cmd_queue, &quit);
+	return NULL;
 }
 
 // ---
@@ -188,20 +550,30 @@ void* panel_task() {
 // return: void
 // ---
 void* ball_task() {
-	struct 	bstate b_copy;	// copy of ball state structure
+	struct 	bstate* b_next;	// next ball state, loaned from bus
 	struct 	dstate d_copy;	// copy of drone state structure
+	struct 	jrn_entry job = {JRN_BLL};	// journal entry of job
 	float	dt;				// elapsed time
 	
 	dt = MSTOS(BLL_PER) * GAMESPEED;
+	job.dt = dt;
+	PROF_THREAD("ball");
+	trace_thread("ball");
 	set_period(&tp[BLL_TASK]);
 		
 	while(1) {
-		safe_copy(&mutex_d, &d_copy, &drone, sizeof(struct dstate));
-		safe_copy(&mutex_b, &b_copy, &ball, sizeof(struct bstate));
+		// new state is computed in place in the bus slot
+		b_next = bus_loan(bus, BLL_TOPIC);
+		job.in[JRN_D] = bus_read(bus, DRN_TOPIC, &d_copy);
+		job.in[JRN_B] = bus_read(bus, BLL_TOPIC, b_next);
 		
-		b_up_state(&b_copy, &d_copy, dt);
+		b_up_state(b_next, &d_copy, dt);
 		
-		safe_copy(&mutex_b, &ball, &b_copy, sizeof(struct bstate));
+		job.out[JRN_B] = bus_publish(bus, BLL_TOPIC, b_next);
+		job.release = job_release(&tp[BLL_TASK]);
+		rec_put(rec, REC_BLL, b_next);
+		rec_put(rec, REC_JBLL, &job);
+		telem_put(tlm, TLM_BLLZ, b_next->position[Z]);
 
 		if(deadline_miss(&tp[BLL_TASK])) 
 			deadline_handle(tp, NUM_TASK);
@@ -214,20 +586,35 @@ void* ball_task() {
 // return: void
 // ---
 void* drone_task() {
-	struct 	dstate d_copy;	// copy of drone state structure
+	struct 	dstate* d_next;	// next drone state, loaned from bus
 	struct 	cstate c_copy;	// copy of controller state structure
+	struct 	jrn_entry job = {JRN_DRN};	// journal entry of job
 	float 	dt;				// elapsed time
 	
 	dt = MSTOS(DRN_PER) * GAMESPEED;
+	job.dt = dt;
+	PROF_THREAD("drone");
+	trace_thread("drone");
 	set_period(&tp[DRN_TASK]);
 		
 	while(1) {
-		safe_copy(&mutex_d, &d_copy, &drone, sizeof(struct dstate));
-		safe_copy(&mutex_c, &c_copy, &control, sizeof(struct cstate));
+		// new state is computed in place in the bus slot
+		d_next = bus_loan(bus, DRN_TOPIC);
+		job.in[JRN_D] = bus_read(bus, DRN_TOPIC, d_next);
+		job.in[JRN_C] = bus_read(bus, CTR_TOPIC, &c_copy);
 		
-		d_up_state(&d_copy, &c_copy, dt);
+		d_up_state(d_next, &c_copy, dt);
 		
-		safe_copy(&mutex_d, &drone, &d_copy, sizeof(struct dstate));
+		job.out[JRN_D] = bus_publish(bus, DRN_TOPIC, d_next);
+		job.release = job_release(&tp[DRN_TASK]);
+		rec_put(rec, REC_DRN, d_next);
+		rec_put(rec, REC_JDRN, &job);
+		telem_put(tlm, TLM_ALT, d_next->fx_lin_pos[Z]);
+		telem_put(tlm, TLM_ROLL, d_next->fx_ang_pos[X]);
+		telem_put(tlm, TLM_PITCH, d_next->fx_ang_pos[Y]);
+		telem_put(tlm, TLM_YAW, d_next->fx_ang_pos[Z]);
+		telem_put(tlm, TLM_VX, d_next->fx_lin_vel[X]);
+		telem_put(tlm, TLM_VY, d_next->fx_lin_vel[Y]);
 
 		if(deadline_miss(&tp[DRN_TASK])) 
 			deadline_handle(tp, NUM_TASK);
@@ -242,17 +629,29 @@ void* drone_task() {
 void* driver_task() {
 	struct 	dstate d_copy;	// copy of drone state structure
 	struct 	bstate b_copy;	// copy of ball state structure
-	struct 	cstate c_copy;	// copy of controller state structure
+	struct 	cstate* c_next;	// next controller state, loaned from bus
+	struct 	jrn_entry job = {JRN_DRV};	// journal entry of job
+	int 	i;				// rotor index [0-NROTOR]
 
+	PROF_THREAD("driver");
+	trace_thread("driver");
 	set_period(&tp[DRV_TASK]);
 	
 	while(1) {		
-		safe_copy(&mutex_d, &d_copy, &drone, sizeof(struct dstate));
-		safe_copy(&mutex_b, &b_copy, &ball, sizeof(struct bstate));
+		job.in[JRN_D] = bus_read(bus, DRN_TOPIC, &d_copy);
+		job.in[JRN_B] = bus_read(bus, BLL_TOPIC, &b_copy);
+		c_next = bus_loan(bus, CTR_TOPIC);
 		
-		c_driver_control(&d_copy, &b_copy, &c_copy);
+		c_driver_control(&d_copy, &b_copy, c_next);
 		
-		safe_copy(&mutex_c, &control, &c_copy, sizeof(struct cstate));
+		job.out[JRN_C] = bus_publish(bus, CTR_TOPIC, c_next);
+		job.release = job_release(&tp[DRV_TASK]);
+		rec_put(rec, REC_CTR, c_next);
+		rec_put(rec, REC_JDRV, &job);
+		for(i = 0; i < NROTOR; i++)
+			telem_put(tlm, TLM_DC + i, c_next->rotor_dc[i]);
+		telem_put(tlm, TLM_CERR, hypotf(c_next->b_pos_f[X] - d_copy.fx_lin_pos[X],
+			c_next->b_pos_f[Y] - d_copy.fx_lin_pos[Y]));
 
 		if(deadline_miss(&tp[DRV_TASK])) 
 			deadline_handle(tp, NUM_TASK);
@@ -261,40 +660,102 @@ void* driver_task() {
 }
 
 // ---
-// Take care of state change starting/stopping task
+// Simulate the throws asked by panel, only the latest one matters.
+// Runs in background: a rollout is too long for a panel period.
 // return: void
 // ---
-void* supervisor_task() {
-	struct 	pstate p_copy;				// copy of drone state structure
-	int 	first_run = 1;				// first run after reset?
-	int 	curr_state, next_state;		// current and next states of simul
-	
-	curr_state = next_state = STOPPED;
-	set_period(&tp[SPV_TASK]);
+void* predict_task() {
+	struct 	predict_req req;		// throw to be simulated
+	struct 	predict res = {0};		// outcome published on bus
+	struct 	sim s;					// headless simulation
 
+	PROF_THREAD("predict");
+	trace_thread("predict");
 	while(1) {
-		safe_copy(&mutex_p, &p_copy, &panel, sizeof(struct pstate));
-		next_state = get_simul_state(&p_copy);
+		spsc_pop_wait(prd_queue, &req);
+		while(spsc_pop(prd_queue, &req) == 0)
+			;
 
-		switch (next_state) {
-			case STOPPED:
-				react_to_stop(curr_state, &first_run, &p_copy);
-				break;
-			case RUNNING:
-				react_to_run(curr_state);	
-				break;
-			case PAUSED:
-				react_to_pause(curr_state);
-				break;
-			default:
-				break;		
-		}
-		curr_state = next_state;
+		sim_init(&s, req.d_pos, req.b_pos, req.pw, req.dir);
+		res.outcome = sim_run(&s);
+		res.miss = s.miss;
+		res.id = req.id;
+		bus_write(bus, PRD_TOPIC, &res);
+	}
+}
 
-		if(deadline_miss(&tp[SPV_TASK])) 
+// ---
+// Publish the recorded states at the time of playback clock, in place of
+// drone, ball and driver tasks. Records are read in the mapped file and
+// written straight into the bus slots the outputs read.
+// return: void
+// ---
+void* replay_task() {
+	struct 	replay_clock clk;		// playback clock
+	struct 	replay_cur d_cur, b_cur, c_cur;	// drone, ball, control cursors
+	struct 	replay_stat st = {0};	// playback state published on bus
+	struct 	rpl_cmd cmd;			// command posted by panel
+	const void* rec_st;				// recorded state (in the mapping)
+	uint64_t t;						// record time (us)
+
+	replay_set(rpl, &clk, rpl->t_begin + rpl_from * 1E6, rpl_speed, 0);
+	replay_seek(rpl, &d_cur, replay_stream(rpl, "drone"), clk.t_rec);
+	replay_seek(rpl, &b_cur, replay_stream(rpl, "ball"), clk.t_rec);
+	replay_seek(rpl, &c_cur, replay_stream(rpl, "control"), clk.t_rec);
+	st.len = (rpl->t_end - rpl->t_begin) / 1E6;
+	trace_thread("replay");
+	set_period(&tp[RPL_TASK]);
+
+	while(1) {
+		while(spsc_pop(rpl_queue, &cmd) == 0)
+			replay_serve(&cmd, &clk, &st);
+		t = replay_time(rpl, &clk);
+
+		if((rec_st = replay_at(rpl, &d_cur, t)) != NULL)
+			bus_write(bus, DRN_TOPIC, (void*)rec_st);
+		if((rec_st = replay_at(rpl, &b_cur, t)) != NULL)
+			bus_write(bus, BLL_TOPIC, (void*)rec_st);
+		if((rec_st = replay_at(rpl, &c_cur, t)) != NULL)
+			bus_write(bus, CTR_TOPIC, (void*)rec_st);
+
+		st.t = (t - rpl->t_begin) / 1E6;
+		st.speed = clk.speed;
+		st.paused = clk.paused;
+		bus_write(bus, RPL_TOPIC, &st);
+
+		if(deadline_miss(&tp[RPL_TASK])) 
 			deadline_handle(tp, NUM_TASK);
-		wait_for_period(&tp[SPV_TASK]);
+		wait_for_period(&tp[RPL_TASK]);
+	}
+}
+
+// ---
+// Take care of state change starting/stopping task, sleep between commands
+// return: void
+// ---
+void* supervisor_task() {
+	struct 	pstate p_copy;				// copy of panel state structure
+	struct 	command cmd;				// command posted by panel
+	int 	first_run = 1;				// first run after reset?
+	int 	curr_state = STOPPED;		// current state of simul
+	uint64_t t0;						// start of command (trace)
+
+	// drone and ball init, udp started
+	trace_thread("supervisor");
+	bus_read(bus, PNL_TOPIC, &p_copy);
+	react_to_stop(STOPPED, &first_run, &p_copy);
+
+	while(1) {
+		spsc_pop_wait(cmd_queue, &cmd);
+		if(cmd.type == CMD_QUIT)
+			break;
+		t0 = trace_now();
+		cmd_serve(&cmd, &curr_state, &first_run);
+		trace_span("cmd", "serve", t0, "type", cmd.type);
 	}
+
+	// rt tasks (if any) end with the process
+	return NULL;
 }
 
 //--------------------------------
@@ -311,7 +772,438 @@ void tp_init() {
 	set_tp_param(&tp[BLL_TASK], BLL_PER, BLL_PRIO);
 	set_tp_param(&tp[UDP_TASK], UDP_PER, UDP_PRIO);
 	set_tp_param(&tp[PNL_TASK], PNL_PER, PNL_PRIO);
-	set_tp_param(&tp[SPV_TASK], SPV_PER, SPV_PRIO);
+	set_tp_param(&tp[SPV_TASK], 0, SPV_PRIO);	// not periodic
+	set_tp_param(&tp[RPL_TASK], RPL_PER, RPL_PRIO);
+}
+
+//--------------------------------
+// UDP MODEL STREAMING FUNCTIONS
+//--------------------------------
+
+// ---
+// Start a new ball model from actual ball state (times are in wall clock).
+// The model holds from the publication of the state, not from its send:
+// the receiver would extrapolate it late by the time it waited in the bus
+// udp_ball_model* model: pointer to model to be set
+// bstate* b_copy: pointer to actual ball state
+// uint64_t t0: publication time of the state (us), 0 if unknown (now)
+// return: void
+// ---
+void ball_model_set(struct udp_ball_model* model, struct bstate* b_copy,
+		uint64_t t0) {
+	int 	i;			// array index [0-SP_DIM]
+	int 	still;		// ball is not moving
+
+	still = b_is_still(b_copy);
+	for(i = 0; i < SP_DIM; i++) {
+		model->b_pos[i] = b_copy->position[i];
+		model->b_vel[i] = still ? 0 : b_copy->velocity[i] * GAMESPEED;
+	}
+
+	model->t0 = t0 ? t0 : udp_stamp();
+	model->acc = (GRAVITY / BLACCSCALEZ) * GAMESPEED * GAMESPEED;
+	model->step = MSTOS(BLL_PER);
+	model->floor = 0;
+	model->epoch++;
+}
+
+//--------------------------------
+// STATE BUS UTILITY FUNCTIONS
+//--------------------------------
+
+// ---
+// Create the bus, its topics and publish the initial states.
+// Command queue follows the bus, panel topic is published last.
+// void* mem: pointer to SHM_MEM byte of shared memory, NULL for one process
+// return: void
+// ---
+void bus_init(void* mem) {
+	struct 	pstate p_init;		// initial panel state
+
+	if(mem == NULL)
+		mem = aligned_alloc(BUS_LINE, SHM_MEM);
+	cmd_queue = spsc_create((char*)mem + BUS_MEM, CMD_QLEN, 
+		sizeof(struct command));
+	tlm = telem_create((char*)mem + BUS_MEM + CMD_MEM);
+	telem_init();
+
+	bus = bus_create(mem, BUS_MEM);
+	bus_topic(bus, DRN_TOPIC, "drone", sizeof(struct dstate), HISTORY);
+	bus_topic(bus, BLL_TOPIC, "ball", sizeof(struct bstate), HISTORY);
+	bus_topic(bus, CTR_TOPIC, "control", sizeof(struct cstate), HISTORY);
+	bus_topic(bus, PNL_TOPIC, "panel", sizeof(struct pstate), HISTORY);
+	bus_topic(bus, PRD_TOPIC, "predict", sizeof(struct predict), HISTORY);
+	bus_topic(bus, RPL_TOPIC, "replay", sizeof(struct replay_stat), HISTORY);
+
+	obj_reset();
+	p_reset(&p_init);
+	bus_write(bus, PNL_TOPIC, &p_init);
+}
+
+// ---
+// Attach to bus and command queue of a running core process
+// return: int - 0 in case of success, -1 if no core is running
+// ---
+int bus_attach() {
+	void* 	mem;	// shared memory region
+
+	mem = shmem_attach(SHM_NAME, SHM_MEM);
+	if(mem == NULL) {
+		fprintf(stderr, "no core process running (start it with -c)\n");
+		return -1;
+	}
+	bus = mem;
+	cmd_queue = (struct spsc*)((char*)mem + BUS_MEM);
+	tlm = (struct telem*)((char*)mem + BUS_MEM + CMD_MEM);
+
+	// core may still be initializing the region
+	while(bus->topic[PNL_TOPIC].depth == 0 || bus_last(bus, PNL_TOPIC) == 0)
+		usleep(ATTACH_WAIT * 1000);
+	return 0;
+}
+
+// ---
+// Create the signals filled by rt tasks and shown by panel charts
+// return: void
+// ---
+void telem_init() {
+	telem_signal(tlm, TLM_ALT, "alt", 0, 15);
+	telem_signal(tlm, TLM_ROLL, "roll", -0.6, 0.6);
+	telem_signal(tlm, TLM_PITCH, "pitch", -0.6, 0.6);
+	telem_signal(tlm, TLM_YAW, "yaw", -0.6, 0.6);
+	telem_signal(tlm, TLM_VX, "vx", -15, 15);
+	telem_signal(tlm, TLM_VY, "vy", -15, 15);
+	telem_signal(tlm, TLM_DC + FXR, "dc front", 0, 1);
+	telem_signal(tlm, TLM_DC + RXR, "dc right", 0, 1);
+	telem_signal(tlm, TLM_DC + BXR, "dc rear", 0, 1);
+	telem_signal(tlm, TLM_DC + LXR, "dc left", 0, 1);
+	telem_signal(tlm, TLM_CERR, "catch err", 0, 50);
+	telem_signal(tlm, TLM_BLLZ, "ball z", 0, 100);
+}
+
+//--------------------------------
+// FLIGHT RECORDER FUNCTIONS
+//--------------------------------
+
+// ---
+// Create record file with a stream for each state published by rt tasks
+// and start its writer
+// char* file: path of record file
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int rec_init(const char* file) {
+	rec = rec_open(file);
+	if(rec == NULL)
+		return -1;
+
+	if(rec_add_stream(rec, REC_DRN, "drone", sizeof(struct dstate)) ||
+			rec_add_stream(rec, REC_BLL, "ball", sizeof(struct bstate)) ||
+			rec_add_stream(rec, REC_CTR, "control", sizeof(struct cstate)))
+		return -1;
+
+	// journal: what each job read and wrote, to re-simulate the session
+	if(rec_add_stream(rec, REC_JDRN, JRN_SDRN, sizeof(struct jrn_entry)) ||
+			rec_add_stream(rec, REC_JBLL, JRN_SBLL, sizeof(struct jrn_entry)) ||
+			rec_add_stream(rec, REC_JDRV, JRN_SDRV, sizeof(struct jrn_entry)) ||
+			rec_add_stream(rec, REC_JSPV, JRN_SSPV, sizeof(struct jrn_entry)))
+		return -1;
+	rec_start(rec);
+	return 0;
+}
+
+// ---
+// Return release time of the current job of a task, the same clock of
+// record stamps (tp->at is already the next activation while job runs)
+// task_par* tp: pointer to task parameters
+// return: uint64_t - release time (us, monotonic)
+// ---
+uint64_t job_release(struct task_par* tp) {
+	return (uint64_t)tp->at.tv_sec * 1000000 + tp->at.tv_nsec / 1000 -
+		(uint64_t)tp->period * 1000;
+}
+
+//--------------------------------
+// REPLAY FUNCTIONS
+//--------------------------------
+
+// ---
+// Map the flight record to be played and create the command queue
+// char* file: path of record file
+// return: int - 0 in case of success, -1 if file is not a flight record
+// ---
+int replay_start(const char* file) {
+	rpl = replay_open(file);
+	if(rpl == NULL)
+		return -1;
+	if(replay_stream(rpl, "drone") < 0 || replay_stream(rpl, "ball") < 0 ||
+			replay_stream(rpl, "control") < 0) {
+		replay_close(rpl);
+		rpl = NULL;
+		return -1;
+	}
+
+	rpl_queue = spsc_create(NULL, RPL_QLEN, sizeof(struct rpl_cmd));
+	return 0;
+}
+
+// ---
+// Post to replay task the command of the replay key pressed in last frame
+// return: void
+// ---
+void replay_control() {
+	struct 	rpl_cmd cmd = {0};		// command to be posted
+	int 	key;					// replay key pressed
+
+	key = nb_get_replay_key();
+	switch(key) {
+		case RPLK_NONE:
+			return;
+		case RPLK_BACK:
+			cmd.type = RPL_SEEK;
+			cmd.arg = -RPL_STEP;
+			break;
+		case RPLK_FWD:
+			cmd.type = RPL_SEEK;
+			cmd.arg = RPL_STEP;
+			break;
+		case RPLK_FASTER:
+			cmd.type = RPL_SPEED;
+			cmd.arg = RPL_FACTOR;
+			break;
+		case RPLK_SLOWER:
+			cmd.type = RPL_SPEED;
+			cmd.arg = 1.0 / RPL_FACTOR;
+			break;
+		case RPLK_PAUSE:
+			cmd.type = RPL_PAUSE;
+			break;
+		default:
+			cmd.type = RPL_JUMP;
+			cmd.arg = (key - RPLK_JUMP) / 10.0;
+			break;
+	}
+	spsc_push(rpl_queue, &cmd);
+}
+
+// ---
+// Apply a playback command: clock is anchored again where it is now
+// rpl_cmd* cmd: pointer to command posted by panel
+// replay_clock* clk: pointer to playback clock
+// replay_stat* st: pointer to playback state (seeks counted)
+// return: void
+// ---
+void replay_serve(struct rpl_cmd* cmd, struct replay_clock* clk,
+		struct replay_stat* st) {
+	int64_t t;						// new record time (us)
+	double 	speed = clk->speed;		// new speed
+	int 	paused = clk->paused;	// new pause state
+
+	t = replay_time(rpl, clk);
+	switch(cmd->type) {
+		case RPL_SEEK:
+			t += cmd->arg * 1E6;
+			st->seeks++;
+			break;
+		case RPL_JUMP:
+			t = rpl->t_begin + cmd->arg * (rpl->t_end - rpl->t_begin);
+			st->seeks++;
+			break;
+		case RPL_SPEED:
+			speed *= cmd->arg;
+			break;
+		case RPL_PAUSE:
+			paused = !paused;
+			break;
+	}
+	replay_set(rpl, clk, t < 0 ? 0 : t, speed, paused);
+}
+
+//--------------------------------
+// CATCH PREDICTION FUNCTIONS
+//--------------------------------
+
+// ---
+// Create the request queue and the background predict task of panel process
+// return: void
+// ---
+void predict_start() {
+	pthread_t id;				// predict task id
+
+	prd_queue = spsc_create(NULL, PRD_QLEN, sizeof(struct predict_req));
+	bg_task_create(&id, predict_task, NULL);
+}
+
+// ---
+// Fill pred for the throw configured in panel, NULL is passed to panel if
+// there is nothing to predict. Analytic part is computed in place (cheap),
+// a new configuration is queued to predict task and its outcome is taken
+// from bus as soon as it is published.
+// pstate* p_copy: pointer to panel state
+// predict* pred: pointer to prediction shown on map
+// return: void
+// ---
+void predict_update(struct pstate* p_copy, struct predict* pred) {
+	struct 	predict_req req;		// actual configuration
+	struct 	predict res;			// last outcome published
+
+	if(get_simul_state(p_copy) != STOPPED || !are_obj_posit(p_copy)) {
+		set_panel_predict(NULL);
+		return;
+	}
+
+	get_real_coord(p_copy, req.d_pos, req.b_pos);
+	req.pw = get_power(p_copy);
+	req.dir = get_dir(p_copy);
+	req.id = prd_last.id + 1;
+
+	// a full queue is retried at next frame
+	if(memcmp(req.d_pos, prd_last.d_pos, sizeof(req) - sizeof(req.id)) &&
+			spsc_push(prd_queue, &req) == 0) {
+		prd_last = req;
+		pred->id = req.id;
+		pred->outcome = SIM_UNKNOWN;
+	}
+
+	sim_predict(pred, req.b_pos, req.pw, req.dir);
+	if(pred->outcome == SIM_UNKNOWN && bus_read(bus, PRD_TOPIC, &res) &&
+			res.id == pred->id) {
+		pred->outcome = res.outcome;
+		pred->miss = res.miss;
+	}
+	set_panel_predict(pred);
+}
+
+//--------------------------------
+// SUPERVISOR COMMAND FUNCTIONS
+//--------------------------------
+
+// ---
+// Post to supervisor the changes made by user to panel state
+// pstate* p_prev: pointer to panel state before user input
+// pstate* p_copy: pointer to panel state after user input
+// return: void
+// ---
+void cmd_post(struct pstate* p_prev, struct pstate* p_copy) {
+	struct 	command cmd;	// command to be posted
+
+	cmd.state = get_simul_state(p_copy);
+	if(cmd.state != get_simul_state(p_prev))
+		cmd.type = CMD_STATE;
+	else if(cmd.state == STOPPED && memcmp(p_prev, p_copy, sizeof(*p_copy)))
+		cmd.type = CMD_CONFIG;
+	else
+		return;
+
+	cmd.stamp = udp_stamp();
+	cmd.input = get_input_stamp();
+	if(spsc_push(cmd_queue, &cmd))
+		printf("SUPERVISOR: command queue full, command lost\n");
+}
+
+// ---
+// Perform the transition asked by cmd and account its latency
+// command* cmd: pointer to command posted by panel
+// int* curr_state: current state of simul, updated
+// int* first_run: indicate the first run after a reset
+// return: void
+// ---
+void cmd_serve(struct command* cmd, int* curr_state, int* first_run) {
+	struct 	pstate p_copy;	// copy of panel state structure
+	struct 	jrn_entry job = {JRN_STATE};	// journal entry of input
+	uint64_t done;			// time transition is done (us)
+
+	bus_read(bus, PNL_TOPIC, &p_copy);
+
+	if(cmd->type == CMD_CONFIG) {
+		if(*curr_state == STOPPED)
+			obj_init(&p_copy);
+	} else {
+		switch (cmd->state) {
+			case STOPPED:
+				react_to_stop(*curr_state, first_run, &p_copy);
+				// after a reset, objects are placed again at once
+				if(*curr_state != STOPPED)
+					react_to_stop(STOPPED, first_run, &p_copy);
+				break;
+			case RUNNING:
+				react_to_run(*curr_state);	
+				break;
+			case PAUSED:
+				react_to_pause(*curr_state);
+				break;
+			default:
+				break;		
+		}
+		*curr_state = cmd->state;
+		job.state = cmd->state;
+		job.release = udp_stamp();
+		rec_put(rec, REC_JSPV, &job);
+	}
+
+	done = udp_stamp();
+	cmd_account(&cmd_lat, done - cmd->stamp);
+	if(cmd->input)
+		cmd_account(&in_lat, done - cmd->input);
+}
+
+// ---
+// Add a latency to statistics
+// cmd_stat* st: pointer to latency statistics
+// uint64_t lat: latency (us)
+// return: void
+// ---
+void cmd_account(struct cmd_stat* st, uint64_t lat) {
+	if(st->num == 0 || lat < st->min)
+		st->min = lat;
+	if(lat > st->max)
+		st->max = lat;
+	st->sum += lat;
+	st->num++;
+}
+
+// ---
+// Keep the panel busy for ms, touching fresh memory as a slow X server would
+// int ms: duration of stall (ms)
+// return: void
+// ---
+void panel_stall(int ms) {
+	uint64_t end;	// end of stall (us)
+	char* 	mem;	// memory touched while stalled
+
+	end = udp_stamp() + ms * 1000;
+	while(udp_stamp() < end) {
+		// a new anonymous mapping each time (not malloc, that reuses its
+		// heap once a large block is freed), so every page faults
+		mem = mmap(NULL, STALL_MEM, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(mem == MAP_FAILED)
+			return;
+		memset(mem, 1, STALL_MEM);
+		munmap(mem, STALL_MEM);
+	}
+}
+
+// ---
+// Simply print formatted the latency of supervisor transitions
+// return: void
+// ---
+void cmd_report() {
+	printf("-----------------------------------------------\n");
+	printf("SUPERVISOR TRANSITION LATENCY (post to done):\n");
+	printf("\tcommands: %ld\n", cmd_lat.num);
+	if(cmd_lat.num)
+		printf("\tmin: %lu us - avg: %lu us - max: %lu us\n",
+			(unsigned long)cmd_lat.min,
+			(unsigned long)(cmd_lat.sum / cmd_lat.num),
+			(unsigned long)cmd_lat.max);
+	printf("INPUT TO REACTION LATENCY (event to done):\n");
+	printf("\tcommands: %ld\n", in_lat.num);
+	if(in_lat.num)
+		printf("\tmin: %lu us - avg: %lu us - max: %lu us\n",
+			(unsigned long)in_lat.min,
+			(unsigned long)(in_lat.sum / in_lat.num),
+			(unsigned long)in_lat.max);
+	printf("-----------------------------------------------\n");
 }
 
 //-------------------------
@@ -366,19 +1258,23 @@ void task_stop(int udp, int drone, int ball, int driver) {
 // return: void
 // ---
 void obj_init(struct pstate* p_copy) {
-	float 	pw, dir;			// power and direction of ball
-	float 	d_init_pos[SP_DIM];	// drone init position
-	float	b_init_pos[SP_DIM];	// ball init position
+	struct 	jrn_entry e = {JRN_INIT};	// journal entry of placement
+	struct 	dstate d_copy;		// copy of drone state structure
+	struct 	bstate b_copy;		// copy of ball state structure
 
 	// get pos, dir and power from panel
-	get_real_coord(p_copy, d_init_pos, b_init_pos);
-	pw = get_power(p_copy);
-	dir = get_dir(p_copy);
+	get_real_coord(p_copy, e.d_pos, e.b_pos);
+	e.pw = get_power(p_copy);
+	e.dir = get_dir(p_copy);
 	
 	// set data to drone and ball
-	d_set_init_pos(&drone, d_init_pos);
-	b_set_init_pos(&ball, b_init_pos);
-	b_set_init_vel(&ball, pw / 2, dir);
+	e.in[JRN_D] = bus_read(bus, DRN_TOPIC, &d_copy);
+	e.in[JRN_B] = bus_read(bus, BLL_TOPIC, &b_copy);
+	jrn_place(&e, &d_copy, &b_copy);
+	e.out[JRN_D] = bus_write(bus, DRN_TOPIC, &d_copy);
+	e.out[JRN_B] = bus_write(bus, BLL_TOPIC, &b_copy);
+	e.release = udp_stamp();
+	rec_put(rec, REC_JSPV, &e);
 }
 
 // ---
@@ -386,9 +1282,16 @@ void obj_init(struct pstate* p_copy) {
 // return: void
 // ---
 void obj_reset() {
-	n_safe_reset(&drone, sizeof(struct dstate));
-	n_safe_reset(&ball, sizeof(struct bstate));
-	n_safe_reset(&control, sizeof(struct cstate));
+	struct 	dstate d_zero = {0};	// drone state at reset
+	struct 	bstate b_zero = {0};	// ball state at reset
+	struct 	cstate c_zero = {0};	// controller state at reset
+	struct 	jrn_entry e = {JRN_RESET};	// journal entry of reset
+
+	e.out[JRN_D] = bus_write(bus, DRN_TOPIC, &d_zero);
+	e.out[JRN_B] = bus_write(bus, BLL_TOPIC, &b_zero);
+	e.out[JRN_C] = bus_write(bus, CTR_TOPIC, &c_zero);
+	e.release = udp_stamp();
+	rec_put(rec, REC_JSPV, &e);
 }
 
 //---------------------------------------
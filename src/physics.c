@@ -1,4 +1,5 @@
 #include "physics.h"
+#include "prof.h"
 #include <math.h>
 #include <float.h>
 #include <string.h>
@@ -260,6 +261,7 @@ void d_set_rotor_dc(struct dstate* drone, float* rotor_dc) {
 void d_up_state(struct dstate* drone, struct cstate* control, float dt) {
 	float 	fx_lin_acc[SP_DIM];		// fx frame linear acceleration
 	float 	bd_ang_acc[SP_DIM]; 	// bd frame angular acceleration
+	PROF_ZONE("d_up_state");
 
 	d_set_rotor_dc(drone, control->rotor_dc);
 
@@ -328,12 +330,12 @@ static void b_up_pos(struct bstate* ball, float dt) {
 }
 
 // ---
-// Check if ball has collided with drone or floor
+// Check if ball has collided with drone or floor, if so ball is stopped
 // bstate* ball: pointer to ball state structure
 // dstate* drone: pointer to ball state structure
-// return: void
+// return: int - 1 if ball has collided, 0 otherwise
 // ---
-static int b_check_collision(struct bstate* ball, struct dstate* drone) {
+int b_check_collision(struct bstate* ball, struct dstate* drone) {
 	int 	i;				// array index [0-SP_DIM]
 	int		coll_d, coll_f;	// collision with drone or with floor
 	float 	b2d_d_xy = 0;	// ball to drone distance (only xy)
@@ -371,6 +373,8 @@ static int b_check_collision(struct bstate* ball, struct dstate* drone) {
 // return: void
 // ---
 void b_up_state(struct bstate* ball, struct dstate* drone, float dt) {
+	PROF_ZONE("b_up_state");
+
 	if(!b_check_collision(ball, drone)) {
 		b_up_vel(ball, dt);
 		b_up_pos(ball, dt);
@@ -431,6 +435,46 @@ void b_set_init_vel(struct bstate* ball, float velocity, float direction) {
 	ball->velocity[Z] = velocity * BLVELSCALEZ;
 }
 
+// ---
+// Return 1 if ball is not moving (stopped by a collision or on the floor)
+// bstate* ball: pointer to ball state structure
+// return: int - 1 if ball is still, 0 otherwise
+// ---
+int b_is_still(struct bstate* ball) {
+	if(ball->position[Z] <= 0)
+		return 1;
+	return ball->velocity[X] == 0 && ball->velocity[Y] == 0 && 
+		ball->velocity[Z] == 0;
+}
+
+// ---
+// Return 1 if ball has left the free fall arc that starts from origin.
+// In free fall only Z velocity changes, so a change of X/Y velocity or of
+// the still condition means a throw, a catch or a floor hit happened.
+// bstate* origin: pointer to ball state at the start of the arc
+// bstate* ball: pointer to actual ball state
+// return: int - 1 if ball is not on the arc anymore, 0 otherwise
+// ---
+int b_off_model(struct bstate* origin, struct bstate* ball) {
+	int 	i;	// array index [0-SP_DIM]
+
+	if(b_is_still(origin) != b_is_still(ball))
+		return 1;
+
+	// a still ball may have been moved (e.g. positioned by the user)
+	if(b_is_still(ball)) {
+		for(i = 0; i < SP_DIM; i++)
+			if(fabs(ball->position[i] - origin->position[i]) > BLMODELEPS)
+				return 1;
+		return 0;
+	}
+
+	for(i = 0; i < SP_DIM-1; i++)
+		if(fabs(ball->velocity[i] - origin->velocity[i]) > BLMODELEPS)
+			return 1;
+	return 0;
+}
+
 //----------------------------------------------
 // PRIVATE: CONTROLLER EMULATED SENSORS FUNCTIONS
 //----------------------------------------------
@@ -608,6 +652,7 @@ void c_calc_ball_pos(
 	float	sqrt_term;			// terms that will be sqrt-ed
 	float 	pos_i[SP_DIM];		// initial position of the ball
 	float	g;					// deceleration of the ball
+	PROF_ZONE("c_calc_ball_pos");
 
 	g = GRAVITY / BLACCSCALEZ;
 	sqrt_term = b_vel_a[Z] * b_vel_a[Z] + 2 * g * b_pos_a[Z];
@@ -657,6 +702,8 @@ static void c_ctrl_accel(
 // return: void
 // ---
 static void c_acc_to_ang(float* acc, float* des_ang) {
+	PROF_ZONE("c_acc_to_ang");
+
 	des_ang[X] = atanf(acc[Y] / (GRAVITY + acc[Z]));
 	des_ang[Y] = atanf(acc[X] / (acc[Z] + GRAVITY));
 	des_ang[Z] = 0;
@@ -674,6 +721,7 @@ static float c_calc_des_thrust(
 	
 	float 	R[SP_DIM];	// rotation matrix
 	float	thrust;		// des thrust
+	PROF_ZONE("c_calc_des_thrust");
 
 	R[X] = sin(des_ang[Y]) * cos(des_ang[X]);
 	R[Y] = - sin(des_ang[Y]);
@@ -715,6 +763,7 @@ void c_stab_control(
 	float 	act_pos[SP_DIM], act_vel[SP_DIM]; 	// actual data from gyro
 	float	ut[SP_DIM];							// desired torques
 	float 	rotor_force[NROTOR];				// desired rotor forces
+	PROF_ZONE("c_stab_control");
 	
 	// get data from sensors
 	c_gyro_get_pos(drone, act_pos);
@@ -741,6 +790,7 @@ void c_driver_control(
 	float	d_lin_pos[SP_DIM], d_lin_vel[SP_DIM];		// drone actual pos/vel
 	float	d_ang_pos[SP_DIM];							// drone act ang pos
 	float	des_acc[SP_DIM], des_ang[SP_DIM], des_th;	// desired attitude
+	PROF_ZONE("c_driver_control");
 		
 	// Get data from sensors
 	c_prox_get_pos(ball, b_pos_act);
@@ -751,6 +801,7 @@ void c_driver_control(
 
 	// Calculate ball final position
 	c_calc_ball_pos(b_pos_act, b_vel_act, DFINALH, b_pos_f);
+	memcpy(control->b_pos_f, b_pos_f, sizeof(b_pos_f));
 
 	// Calculate drone new angles and thrust
 	c_ctrl_accel(des_acc, b_pos_f, d_lin_pos, d_lin_vel);
@@ -42,6 +42,7 @@
 #define LXR 			3		// left rotor
 #define B2D_DIST_Z		1.5		// ball to drone collision distance (z axis)
 #define B2D_DIST_XY		0.5		// ball to drone collision distance	(xy plan)	
+#define BLMODELEPS		1E-3	// tolerance of ball model comparison (m, m/s)
 
 //-------------------------------------
 // SCALE AND BOUND
@@ -87,6 +88,7 @@ struct bstate {					// ball structure
 
 struct cstate {					// controller state structure
 	float 	rotor_dc[NROTOR];	// duty cycle [0, 1] imposed to rotor
+	float 	b_pos_f[SP_DIM];	// predicted ball final (catch) position
 };
 
 //----------------------------------------
@@ -110,6 +112,9 @@ void d_set_init_pos(struct dstate* drone, float* position);
 // Update the state of ball based on dt elapsed time
 void b_up_state(struct bstate* ball, struct dstate* drone, float dt);
 
+// Return 1 if ball collides with drone or floor (ball is stopped)
+int b_check_collision(struct bstate* ball, struct dstate* drone);
+
 //----------------------------------------
 // PUBLIC: BALL GETTER/SETTER
 //----------------------------------------
@@ -120,6 +125,12 @@ void b_set_init_pos(struct bstate* ball, float* position);
 // Set the initial velocity of ball towards origin
 void b_set_init_vel(struct bstate* ball, float velocity, float direction);
 
+// Return 1 if ball is not moving (stopped by a collision or on the floor)
+int b_is_still(struct bstate* ball);
+
+// Return 1 if ball has left the free fall arc that starts from origin
+int b_off_model(struct bstate* origin, struct bstate* ball);
+
 //---------------------------------------------
 // PUBLIC: CONTROLLER RELATED FUNCTIONS
 //--------------------------------------------
@@ -132,4 +143,8 @@ void c_stab_control(
 void c_driver_control(
 	struct dstate* drone, struct bstate* ball, struct cstate* control);
 
+// Try to predict the ball final position at given height
+void c_calc_ball_pos(
+	float* b_pos_a, float* b_vel_a, float b_height_f, float* b_pos_f);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "prof.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_TIMER		"tsc"
+#else
+#define PROF_TIMER		"monotonic raw"
+#endif
+
+#define PROF_CALIB		200000	// zones entered to measure their cost
+
+static char zone_name[PROF_MAXZONE][PROF_NAMELEN];	// names of zones
+static int nzone;							// zones registered
+static struct prof_thread* thread[PROF_MAXTHREAD];	// threads reported
+static _Atomic int nthread;					// threads registered
+static pthread_mutex_t reg = PTHREAD_MUTEX_INITIALIZER;	// registrations
+static pthread_once_t once = PTHREAD_ONCE_INIT;	// creation of key
+static pthread_key_t key;					// tree, dropped at thread end
+static uint64_t tick0;						// tick at first registration
+static double ns0;							// time at first registration (ns)
+static _Thread_local struct prof_thread* self;	// tree of calling thread
+
+//------------------------------------------
+// PRIVATE: TIMER
+//------------------------------------------
+
+// ---
+// Return time of monotonic raw clock in ns
+// return: double - ns elapsed from an unspecified point
+// ---
+static double now_ns() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_sec * 1E9 + t.tv_nsec;
+}
+
+// ---
+// Return current tick: tsc on x86, ns of monotonic raw clock elsewhere
+// return: uint64_t - tick
+// ---
+static inline uint64_t now_tick() {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return now_ns();
+#endif
+}
+
+// ---
+// Return ticks in a ns, from the ticks elapsed since first registration
+// return: double - ticks per ns
+// ---
+static double tick_rate() {
+	double 	dt = now_ns() - ns0;	// ns elapsed
+
+	return (dt > 0) ? (now_tick() - tick0) / dt : 1;
+}
+
+//------------------------------------------
+// PRIVATE: REGISTRATION (once for each zone and thread)
+//------------------------------------------
+
+// ---
+// Register zone called name, or find it if another site registered it
+// _Atomic int* zone: id of zone site, set to id + 1
+// char* name: zone name
+// return: int - id + 1, 0 if too many zones
+// ---
+static int zone_register(_Atomic int* zone, const char* name) {
+	int 	z;	// zone
+
+	pthread_mutex_lock(&reg);
+	for(z = 0; z < nzone && strcmp(zone_name[z], name); z++);
+	if(z == nzone && nzone < PROF_MAXZONE)
+		snprintf(zone_name[nzone++], PROF_NAMELEN, "%s", name);
+	pthread_mutex_unlock(&reg);
+	if(z == PROF_MAXZONE)
+		return 0;
+	atomic_store(zone, z + 1);
+	return z + 1;
+}
+
+// ---
+// Mark the tree of an ending thread, so a new one can go on with it
+// void* arg: pointer to tree
+// return: void
+// ---
+static void thread_end(void* arg) {
+	struct 	prof_thread* th = arg;	// tree of ending thread
+
+	pthread_mutex_lock(&reg);
+	th->live = 0;
+	pthread_mutex_unlock(&reg);
+}
+
+// ---
+// Create the key that marks trees at thread end
+// return: void
+// ---
+static void key_create() {
+	pthread_key_create(&key, thread_end);
+}
+
+// ---
+// Allocate the zone tree of the calling thread and register it
+// return: prof_thread* - tree of calling thread, NULL if out of memory
+// ---
+static struct prof_thread* thread_attach() {
+	struct 	prof_thread* th;	// new tree
+	int 	k;					// thread index
+
+	th = aligned_alloc(PROF_LINE, sizeof(struct prof_thread));
+	if(th == NULL)
+		return NULL;
+	memset(th, 0, sizeof(struct prof_thread));
+	th->nnode = 1;
+	th->live = 1;
+	pthread_once(&once, key_create);
+	pthread_setspecific(key, th);
+
+	pthread_mutex_lock(&reg);
+	if(tick0 == 0) {
+		ns0 = now_ns();
+		tick0 = now_tick();
+	}
+	k = atomic_load(&nthread);
+	if(k < PROF_MAXTHREAD) {
+		snprintf(th->name, PROF_NAMELEN, "thread %d", k);
+		thread[k] = th;
+		atomic_store(&nthread, k + 1);
+	}
+	pthread_mutex_unlock(&reg);
+	self = th;
+	return th;
+}
+
+// ---
+// Add node of zone z under parent, root if the tree is full
+// prof_thread* th: pointer to tree
+// int parent: parent node
+// int z: zone
+// return: int - node
+// ---
+static int node_add(struct prof_thread* th, int parent, int z) {
+	int 	n = th->nnode;	// new node
+
+	if(n == PROF_MAXNODE)
+		return 0;
+	th->nnode++;
+	th->node[n].zone = z;
+	th->node[n].parent = parent;
+	th->child[parent][z] = n;
+	return n;
+}
+
+//------------------------------------------
+// PUBLIC: ZONES
+//------------------------------------------
+
+// ---
+// Enter zone called name, counting in the tree of calling thread
+// _Atomic int* zone: id + 1 of zone site, 0 until registered
+// char* name: zone name
+// return: prof_scope - zone entered, to be passed to prof_leave
+// ---
+struct prof_scope prof_enter(_Atomic int* zone, const char* name) {
+	struct 	prof_scope s = {self};	// zone entered
+	int 	z;						// zone id + 1
+
+	z = atomic_load_explicit(zone, memory_order_relaxed);
+	if(z == 0)
+		z = zone_register(zone, name);
+	if(s.th == NULL)
+		s.th = thread_attach();
+	if(s.th == NULL || z == 0)
+		return s;
+
+	// zones over PROF_MAXNODE are counted in root
+	s.parent = s.th->cur;
+	s.node = s.th->child[s.parent][z - 1];
+	if(s.node == 0)
+		s.node = node_add(s.th, s.parent, z - 1);
+	s.th->cur = s.node;
+	s.t0 = now_tick();
+	return s;
+}
+
+// ---
+// Leave a zone and add its time to its node
+// prof_scope* s: pointer to zone entered
+// return: void
+// ---
+void prof_leave(struct prof_scope* s) {
+	struct 	prof_node* n;	// node of zone
+	uint64_t dt;			// ticks spent inside
+
+	if(s->t0 == 0)
+		return;
+	dt = now_tick() - s->t0;
+	n = &s->th->node[s->node];
+	n->count++;
+	n->total += dt;
+	if(dt > n->max)
+		n->max = dt;
+	s->th->cur = s->parent;
+}
+
+//------------------------------------------
+// PRIVATE: REPORT
+//------------------------------------------
+
+// ---
+// Measure the cost of a zone on a tree of its own
+// double rate: ticks per ns
+// double* inside: part of the cost counted inside the zone (ns), filled
+// return: double - cost of entering and leaving a zone (ns)
+// ---
+static double calibrate(double rate, double* inside) {
+	static struct prof_thread cal;	// tree of calibration
+	static _Atomic int zone;		// calibration zone
+	struct 	prof_thread* th = self;	// tree of calling thread
+	struct 	prof_scope s;			// zone entered
+	uint64_t t0, t1;				// ticks at start and end
+	long 	k;						// zone entered
+
+	memset(&cal, 0, sizeof(cal));
+	cal.nnode = 1;
+	self = &cal;
+	t0 = now_tick();
+	for(k = 0; k < PROF_CALIB; k++) {
+		s = prof_enter(&zone, "calibration");
+		prof_leave(&s);
+	}
+	t1 = now_tick();
+	self = th;
+	*inside = (cal.node[cal.nnode - 1].total / rate) / PROF_CALIB;
+	return ((t1 - t0) / rate) / PROF_CALIB;
+}
+
+// ---
+// Print node and its subtree, indented by depth
+// prof_thread* th: pointer to tree
+// int n: node
+// int depth: depth of node
+// double rate: ticks per ns
+// return: void
+// ---
+static void report_node(struct prof_thread* th, int n, int depth, double rate) {
+	struct 	prof_node* nd = &th->node[n];	// node
+	uint64_t self_t = nd->total;			// ticks outside children
+	int 	k;								// child
+
+	for(k = 1; k < th->nnode; k++)
+		if(th->node[k].parent == n)
+			self_t -= th->node[k].total;
+	printf("\t%*s%-*s %10lu %10.3f %9.0f %9.0f %6.1f\n", 2 * depth, "",
+		PROF_NAMELEN - 2 * depth, zone_name[nd->zone], nd->count,
+		nd->total / rate / 1E6, nd->total / rate / nd->count, nd->max / rate,
+		100.0 * self_t / nd->total);
+	for(k = 1; k < th->nnode; k++)
+		if(th->node[k].parent == n && th->node[k].count > 0)
+			report_node(th, k, depth + 1, rate);
+}
+
+//------------------------------------------
+// PUBLIC: THREADS AND REPORT
+//------------------------------------------
+
+// ---
+// Name the calling thread in the report. Tasks are created again at each
+// start: a thread with no tree yet goes on with the tree of an ended thread
+// of same name, if any
+// char* name: thread name
+// return: void
+// ---
+void prof_thread(const char* name) {
+	struct 	prof_thread* th = self;	// tree of calling thread
+	int 	k;						// thread index
+
+	pthread_mutex_lock(&reg);
+	for(k = 0; th == NULL && k < atomic_load(&nthread); k++)
+		if(!thread[k]->live && !strcmp(thread[k]->name, name)) {
+			th = self = thread[k];
+			th->live = 1;
+			th->cur = 0;
+			pthread_setspecific(key, th);
+		}
+	pthread_mutex_unlock(&reg);
+
+	if(th == NULL)
+		th = thread_attach();
+	if(th != NULL)
+		snprintf(th->name, PROF_NAMELEN, "%s", name);
+}
+
+// ---
+// Print zone tree of each thread, while threads may still count: figures of
+// a zone entered during the report can be off by that entry
+// return: void
+// ---
+void prof_report() {
+	struct 	prof_thread* th;		// tree of a thread
+	double 	rate, cost, inside;		// ticks per ns, cost of a zone (ns)
+	double 	total;					// ns inside root zones of a thread
+	uint64_t count;					// zones entered by a thread
+	int 	t, k;					// thread, node
+
+	if(atomic_load(&nthread) == 0)
+		return;
+	rate = tick_rate();
+	cost = calibrate(rate, &inside);
+
+	printf("-----------------------------------------------\n");
+	printf("PROFILED ZONES (timer: %s, %.3f ticks/ns):\n", PROF_TIMER, rate);
+	printf("\tcost of a zone: %.1f ns (%.1f ns counted inside it)\n",
+		cost, inside);
+	for(t = 0; t < atomic_load(&nthread); t++) {
+		th = thread[t];
+		total = 0;
+		count = 0;
+		for(k = 1; k < th->nnode; k++) {
+			count += th->node[k].count;
+			if(th->node[k].parent == 0)
+				total += th->node[k].total / rate;
+		}
+		printf("\t%s: %lu zones, profiling cost %.2f%% of %.3f ms\n",
+			th->name, count, (total > 0) ? 100 * count * cost / total : 0,
+			total / 1E6);
+		printf("\t%-*s %10s %10s %9s %9s %6s\n", PROF_NAMELEN, "zone",
+			"calls", "total_ms", "mean_ns", "max_ns", "self%");
+		for(k = 1; k < th->nnode; k++)
+			if(th->node[k].parent == 0 && th->node[k].count > 0)
+				report_node(th, k, 0, rate);
+		if(th->node[0].count > 0)
+			printf("\t%lu zones over %d nodes not shown\n",
+				th->node[0].count, PROF_MAXNODE);
+	}
+	printf("-----------------------------------------------\n");
+}
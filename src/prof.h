@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// PROF_H: SCOPED PROFILED ZONES, PER-THREAD COUNTERS, COMPILED OUT BY DEFAULT
+//-----------------------------------------------------------------------------
+// PROF_ZONE("name"); times the rest of the enclosing block. Zones nest: a zone
+// entered inside another one is its child in the report. Each thread counts
+// in its own cache-line-aligned tree, with no lock. Zones compile to nothing
+// unless PROF is defined (make PROF=1).
+//-----------------------------------------------------------------------------
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define PROF_MAXZONE	32		// max zones of the program
+#define PROF_MAXNODE	64		// max nodes of zone tree of a thread
+#define PROF_MAXTHREAD	32		// max threads reported
+#define PROF_NAMELEN	24		// max length of a zone or thread name
+#define PROF_LINE		64		// cache line size (byte)
+
+struct prof_node {				// a zone under a given parent
+	uint64_t count;				// times entered
+	uint64_t total;				// ticks spent inside
+	uint64_t max;				// longest stay (ticks)
+	uint16_t zone, parent;		// zone and parent node (0 is root)
+};
+
+struct prof_thread {			// zone tree of a thread, written by it only
+	_Alignas(PROF_LINE) char name[PROF_NAMELEN];	// thread name
+	uint16_t cur;				// node of innermost zone entered
+	uint16_t nnode;				// nodes used
+	int 	live;				// 1 while its thread runs
+	uint8_t child[PROF_MAXNODE][PROF_MAXZONE];	// node of zone under node
+	struct 	prof_node node[PROF_MAXNODE];		// nodes (0 is root)
+};
+
+struct prof_scope {				// a zone entered, left at end of block
+	struct 	prof_thread* th;	// thread
+	uint16_t node, parent;		// node entered and node to be restored
+	uint64_t t0;				// tick at entry
+};
+
+#ifdef PROF
+#define PROF_CAT_(a, b)		a##b
+#define PROF_CAT(a, b)		PROF_CAT_(a, b)
+#define PROF_ZONE(name) \
+	static _Atomic int PROF_CAT(prof_zone_, __LINE__); \
+	struct prof_scope PROF_CAT(prof_scope_, __LINE__) \
+		__attribute__((cleanup(prof_leave))) = \
+		prof_enter(&PROF_CAT(prof_zone_, __LINE__), name)
+#define PROF_THREAD(name)	prof_thread(name)
+#define PROF_REPORT()		prof_report()
+#else
+#define PROF_ZONE(name)
+#define PROF_THREAD(name)
+#define PROF_REPORT()
+#endif
+
+//------------------------------------------
+// PUBLIC: ZONES (used through PROF_ZONE)
+//------------------------------------------
+
+// Enter zone called name, *zone caches its id (0 until registered)
+struct prof_scope prof_enter(_Atomic int* zone, const char* name);
+
+// Leave zone entered by prof_enter
+void prof_leave(struct prof_scope* s);
+
+//------------------------------------------
+// PUBLIC: THREADS AND REPORT
+//------------------------------------------
+
+// Name the calling thread, it goes on with the tree of an ended thread so named
+void prof_thread(const char* name);
+
+// Print zone tree of each thread, with the cost of a zone measured now
+void prof_report();
+
+#endif
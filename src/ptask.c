@@ -3,7 +3,50 @@
 #include <sched.h>
 #include <time.h>
 #include <string.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "trace.h"
+
+struct task_start {				// what a task created with perf events runs
+	void 	*(*fun) (void *);	// starting routine of thread
+	struct 	task_par* tp;		// task parameters
+};
+
+static const struct {			// perf events counted in jobs (PERF_*)
+	uint32_t type;				// PERF_TYPE_*
+	uint64_t config;			// PERF_COUNT_*
+	const char* name;			// name shown in report
+} perf_ev[PERF_NEV] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instr"},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "llc miss"},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "csw"},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, "migr"},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "faults"}};
+
+static int perf_on;				// 1 if tasks count perf events
+
+struct mutex_thr {				// thread that locks profiled mutexes
+	int 	tid;				// kernel thread id
+	int 	prio;				// priority when it first locked
+	_Atomic int wait;			// mutex waited + 1, 0 if none
+	int 	live;				// 0 once its thread ended, slot to reuse
+};
+
+static struct mutex_stat mtx[MTX_MAX];		// profiled mutexes
+static _Atomic int nmtx;					// mutexes profiled
+static struct mutex_thr mtx_thr[MTX_MAXTHR];	// threads that lock them
+static int nthr;							// slots of threads used
+static pthread_mutex_t mtx_reg = PTHREAD_MUTEX_INITIALIZER;	// guards slots
+static pthread_once_t mtx_once = PTHREAD_ONCE_INIT;	// creates mtx_key
+static pthread_key_t mtx_key;				// slot, freed at thread end
+static int mtx_on, mtx_fast;				// profiling, trylock first
+static _Thread_local int mtx_me = -1;		// index of calling thread
+static _Thread_local uint64_t job_t0;	// start of current job (trace)
 
 //---------------------------------
 // PRIVATE: TIME UTILITY FUNCTIONS
@@ -57,6 +100,321 @@ static int time_cmp(struct timespec t1, struct timespec t2) {
 	return 0;
 }
 
+//---------------------------------
+// PRIVATE: PERF EVENTS OF JOBS
+//---------------------------------
+
+// ---
+// Open the perf events of calling thread: hardware events in a group and
+// software ones in another, so each group is read with one syscall. An
+// event that cannot be opened (no pmu, no permission) is not counted.
+// task_perf* p: pointer to perf events of task
+// return: void
+// ---
+static void perf_open(struct task_perf* p) {
+	struct 	perf_event_attr attr;	// event to be opened
+	int 	lead[2] = {-1, -1};		// leaders of hw and sw group
+	int 	n[2] = {0, 0};			// events in each group
+	int 	e, g;					// event, its group
+
+	for(e = 0; e < PERF_NEV; e++) {
+		g = (e < PERF_NHW) ? 0 : 1;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perf_ev[e].type;
+		attr.config = perf_ev[e].config;
+		attr.read_format = PERF_FORMAT_GROUP;
+		attr.exclude_hv = 1;
+		p->fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, lead[g], 0);
+
+		// unprivileged processes may count user space only
+		if(p->fd[e] < 0 && (errno == EACCES || errno == EPERM)) {
+			attr.exclude_kernel = 1;
+			p->fd[e] = syscall(__NR_perf_event_open, &attr, 0, -1, lead[g], 0);
+		}
+		if(p->fd[e] < 0) {
+			if(p->err == 0)
+				p->err = errno;
+			continue;
+		}
+		if(lead[g] < 0)
+			lead[g] = p->fd[e];
+		p->pos[e] = n[g]++;
+	}
+	p->on = 1;
+}
+
+// ---
+// Close the perf events of a task (at its end, or when it is cancelled)
+// void* arg: pointer to perf events of task
+// return: void
+// ---
+static void perf_close(void* arg) {
+	struct 	task_perf* p = arg;	// perf events of task
+	int 	e;					// event
+
+	p->on = 0;
+	for(e = PERF_NEV - 1; e >= 0; e--)
+		if(p->fd[e] >= 0)
+			close(p->fd[e]);
+}
+
+// ---
+// Read the counters of a task, one read for each group
+// task_perf* p: pointer to perf events of task
+// uint64_t* v: pointer to Vector[PERF_NEV] of counters, filled
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int perf_read(struct task_perf* p, uint64_t* v) {
+	uint64_t buf[1 + PERF_NEV];	// number of events and their counters
+	int 	e, lead = -1;		// event, leader of its group
+
+	for(e = 0; e < PERF_NEV; e++) {
+		if(e == PERF_NHW)
+			lead = -1;
+		if(p->fd[e] < 0)
+			continue;
+		if(lead < 0) {
+			lead = p->fd[e];
+			if(read(lead, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t))
+				return -1;
+		}
+		v[e] = buf[1 + p->pos[e]];
+	}
+	return 0;
+}
+
+// ---
+// Start routine of a task created with perf events: open, run, close
+// void* arg: pointer to task_start (freed)
+// return: void* - what the task routine returns
+// ---
+static void* perf_task(void* arg) {
+	struct 	task_start st = *(struct task_start*)arg;	// routine and tp
+	void* 	ret;	// result of routine
+
+	free(arg);
+	perf_open(&st.tp->perf);
+	perf_read(&st.tp->perf, st.tp->perf.start);
+	pthread_cleanup_push(perf_close, &st.tp->perf);
+	ret = st.fun(NULL);
+	pthread_cleanup_pop(1);
+	return ret;
+}
+
+// ---
+// Account the counters of the job just done, before the task sleeps
+// task_perf* p: pointer to perf events of task
+// return: void
+// ---
+static void perf_job_end(struct task_perf* p) {
+	uint64_t v[PERF_NEV], d;	// counters, counted in job
+	int 	e;					// event
+
+	if(!p->on || perf_read(p, v))
+		return;
+
+	// odd while updating, for readers of perf_get
+	atomic_fetch_add_explicit(&p->seq, 1, memory_order_acq_rel);
+	for(e = 0; e < PERF_NEV; e++) {
+		if(p->fd[e] < 0)
+			continue;
+		d = v[e] - p->start[e];
+		p->sum[e] += d;
+		if(d > p->max[e])
+			p->max[e] = d;
+	}
+	p->njob++;
+	atomic_fetch_add_explicit(&p->seq, 1, memory_order_release);
+}
+
+//---------------------------------
+// PRIVATE: MUTEX PROFILING
+//---------------------------------
+
+// ---
+// Return the profile of a mutex
+// pthread_mutex_t* mutex_id: pointer to identifier of the mutex
+// return: mutex_stat* - profile, NULL if mutex is not profiled
+// ---
+static struct mutex_stat* mtx_find(pthread_mutex_t* mutex_id) {
+	int 	k;	// mutex
+
+	for(k = 0; k < atomic_load_explicit(&nmtx, memory_order_acquire); k++)
+		if(mtx[k].id == mutex_id)
+			return &mtx[k];
+	return NULL;
+}
+
+// ---
+// Free the slot of an ending thread, so a new one can take it
+// void* arg: pointer to slot
+// return: void
+// ---
+static void mtx_thread_end(void* arg) {
+	struct 	mutex_thr* t = arg;	// slot of ending thread
+
+	pthread_mutex_lock(&mtx_reg);
+	t->live = 0;
+	pthread_mutex_unlock(&mtx_reg);
+}
+
+// ---
+// Create the key that frees slots at thread end
+// return: void
+// ---
+static void mtx_key_create() {
+	pthread_key_create(&mtx_key, mtx_thread_end);
+}
+
+// ---
+// Return the index of calling thread, registered at its first lock in the
+// slot of an ended thread if any (tasks are created again at each start)
+// return: int - thread index, -1 if too many threads
+// ---
+static int mtx_self() {
+	struct 	sched_param sp;	// scheduling parameters of thread
+	int 	pol, k;			// scheduling policy of thread, slot
+
+	if(mtx_me >= 0)
+		return mtx_me;
+	pthread_once(&mtx_once, mtx_key_create);
+	pthread_mutex_lock(&mtx_reg);
+	for(k = 0; k < nthr && mtx_thr[k].live; k++);
+	if(k == MTX_MAXTHR) {
+		pthread_mutex_unlock(&mtx_reg);
+		return -1;
+	}
+	if(k == nthr)
+		nthr++;
+	pthread_getschedparam(pthread_self(), &pol, &sp);
+	mtx_thr[k].tid = syscall(SYS_gettid);
+	mtx_thr[k].prio = sp.sched_priority;
+	atomic_store(&mtx_thr[k].wait, 0);
+	mtx_thr[k].live = 1;
+	pthread_mutex_unlock(&mtx_reg);
+	pthread_setspecific(mtx_key, &mtx_thr[k]);
+	return mtx_me = k;
+}
+
+// ---
+// Return the bin of histograms that counts a duration
+// uint64_t ns: duration (ns)
+// return: int - bin k, that counts [2^k, 2^k+1) ns
+// ---
+static int mtx_bin(uint64_t ns) {
+	int 	k = 63 - __builtin_clzll(ns | 1);	// floor of log2
+
+	return (k < MTX_NBIN) ? k : MTX_NBIN - 1;
+}
+
+// ---
+// Follow the owners of mutexes from the one the calling thread will wait:
+// the owner may be waiting another mutex, whose owner may be waiting ...
+// mutex_stat* m: pointer to profile of mutex to be waited
+// int me: calling thread, registered
+// mutex_chain* c: pointer to chain, filled (n is 0 if owner is unknown)
+// return: void
+// ---
+static void mtx_chain(struct mutex_stat* m, int me, struct mutex_chain* c) {
+	int 	o, w;	// owner, mutex it waits
+
+	// threads are copied: their slots may be taken by new ones later
+	c->tid[0] = mtx_thr[me].tid;
+	c->prio[0] = mtx_thr[me].prio;
+	for(c->n = 0; c->n < MTX_DEPTH; c->n++) {
+		o = atomic_load(&m->owner) - 1;
+		if(o < 0)
+			break;
+		c->mtx[c->n] = m - mtx;
+		c->tid[c->n + 1] = mtx_thr[o].tid;
+		c->prio[c->n + 1] = mtx_thr[o].prio;
+		w = atomic_load(&mtx_thr[o].wait) - 1;
+		if(w < 0 || w == c->mtx[0]) {
+			c->n++;
+			break;
+		}
+		m = &mtx[w];
+	}
+}
+
+// ---
+// Account an acquisition, called by the new owner (so with mutex held):
+// owner and chains are not recorded for an unregistered thread
+// mutex_stat* m: pointer to profile of mutex
+// int me: calling thread, -1 if not registered
+// mutex_chain* c: pointer to chain the thread was blocked by
+// int cont: 1 if mutex was found held
+// uint64_t t0: start of acquisition (ns)
+// return: void
+// ---
+static void mtx_acquired(struct mutex_stat* m, int me, struct mutex_chain* c,
+		int cont, uint64_t t0) {
+	uint64_t t = trace_now();	// time of acquisition
+	int 	k;					// chain kept
+
+	c->wait = t - t0;
+	m->nlock++;
+	m->wait_sum += c->wait;
+	m->wait_hist[mtx_bin(c->wait)]++;
+	if(c->wait > m->wait_max)
+		m->wait_max = c->wait;
+	if(cont) {
+		m->ncont++;
+
+		// with priority inheritance the owner ran at waiter priority
+		if(c->n > 0 && c->prio[0] > c->prio[1])
+			m->nboost++;
+
+		// chains kept longest first
+		for(k = MTX_CHAIN - 1; c->n > 0 && k >= 0 &&
+				c->wait > m->worst[k].wait; k--) {
+			if(k < MTX_CHAIN - 1)
+				m->worst[k + 1] = m->worst[k];
+			m->worst[k] = *c;
+		}
+	}
+	m->t_acq = t;
+	if(me >= 0)
+		atomic_store(&m->owner, me + 1);
+}
+
+// ---
+// Return the upper bound of the bin where a quantile of histogram falls
+// long* hist: pointer to Vector[MTX_NBIN] histogram
+// long n: number of samples
+// double q: quantile [0, 1]
+// uint64_t max: longest duration counted (ns), the bound of last bin
+// return: uint64_t - duration (ns)
+// ---
+static uint64_t mtx_quantile(long* hist, long n, double q, uint64_t max) {
+	long 	sum = 0;	// samples up to bin
+	int 	k;			// bin
+
+	for(k = 0; k < MTX_NBIN - 1; k++) {
+		sum += hist[k];
+		if(sum >= q * n)
+			break;
+	}
+	return ((2ull << k) < max) ? 2ull << k : max;
+}
+
+// ---
+// Print the non-empty bins of a histogram
+// char* what: name of histogram
+// long* hist: pointer to Vector[MTX_NBIN] histogram
+// return: void
+// ---
+static void mtx_hist_print(const char* what, long* hist) {
+	int 	k;	// bin
+
+	printf("\t\t%s (ns):", what);
+	for(k = 0; k < MTX_NBIN; k++)
+		if(hist[k])
+			printf(" <%llu: %ld", 2ull << k, hist[k]);
+	printf("\n");
+}
+
 //-------------------------------------------------------
 // PUBLIC: CREATE WAIT AND TERMINATION OF THREAD FUNCTIONS
 //-------------------------------------------------------
@@ -71,14 +429,43 @@ static int time_cmp(struct timespec t1, struct timespec t2) {
 void p_task_create(pthread_t* id, void *(*fun) (void *), struct task_par* tp) {		
 	pthread_attr_t t_att; 
 	struct sched_param t_sched_param;
+	struct 	task_start* st;	// routine and tp, if perf events are counted
 
 	pthread_attr_init(&t_att);
 	pthread_attr_setinheritsched(&t_att, PTHREAD_EXPLICIT_SCHED);
 	pthread_attr_setschedpolicy(&t_att, SCHED_FIFO); // FIFO scheduling
 	t_sched_param.sched_priority = tp->priority;
 	pthread_attr_setschedparam(&t_att, &t_sched_param);
+
+	// with perf events the task opens its own counters before its routine
+	st = perf_on ? malloc(sizeof(struct task_start)) : NULL;
+	if(st == NULL) {
+		pthread_create(id, &t_att, fun, NULL);
+		return;
+	}
+	st->fun = fun;
+	st->tp = tp;
+	pthread_create(id, &t_att, perf_task, st);
+}
+
+// ---
+// Create a background task (SCHED_OTHER), it runs when no rt task is ready
+// pthread_t* id: pointer to pthread_t in which will be leaved the id of task
+// void *(*fun) (void *): pointer to starting routine of thread
+// void* arg: argument passed to routine
+// return: void
+// ---
+void bg_task_create(pthread_t* id, void *(*fun) (void *), void* arg) {
+	pthread_attr_t t_att; 
+	struct sched_param t_sched_param;
+
+	pthread_attr_init(&t_att);
+	pthread_attr_setinheritsched(&t_att, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&t_att, SCHED_OTHER);
+	t_sched_param.sched_priority = 0;
+	pthread_attr_setschedparam(&t_att, &t_sched_param);
 	
-	pthread_create(id, &t_att, fun, NULL);
+	pthread_create(id, &t_att, fun, arg);
 }
 
 // ---
@@ -119,6 +506,7 @@ void set_period(struct task_par* tp) {
 	// adds period and deadline 
 	time_add_ms(&(tp->at), tp->period); 
 	time_add_ms(&(tp->dl), tp->deadline);
+	job_t0 = trace_now();
 }
 
 // ---
@@ -127,7 +515,27 @@ void set_period(struct task_par* tp) {
 // return: void
 // ---
 void wait_for_period(struct task_par* tp) {
+	struct timespec now;
+	long 	jit;	// delay of wake up from activation time (us)
+
+	perf_job_end(&tp->perf);
+	trace_span("task", "job", job_t0, "act", tp->nact);
 	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &(tp->at), NULL);
+
+	// wake up is taken first: reading counters would count as jitter
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	job_t0 = trace_now();
+	if(tp->perf.on)
+		perf_read(&tp->perf, tp->perf.start);
+
+	// account how late the thread is woken up
+	jit = (now.tv_sec - tp->at.tv_sec) * 1000000 + 
+		(now.tv_nsec - tp->at.tv_nsec) / 1000;
+	if(jit > tp->jit_max)
+		tp->jit_max = jit;
+	tp->jit_sum += jit;
+	tp->nact++;
+
 	time_add_ms(&(tp->at), tp->period);
 	time_add_ms(&(tp->dl), tp->period);
 }
@@ -144,6 +552,7 @@ int deadline_miss(struct task_par* tp) {
 	clock_gettime(CLOCK_MONOTONIC, &now);
 	if (time_cmp(now, tp->dl) > 0) { 
 		tp->dmiss++;
+		trace_mark("task", "deadline miss", "dmiss", tp->dmiss);
 		return 1; 
 	}
 	
@@ -165,6 +574,104 @@ void deadline_handle(struct task_par* tp, int n_of_thread) {
 	printf("-----------------------------------------------\n");
 }
 
+// ---
+// Simply print formatted the activation jitter of each thread
+// task_par* tp: pointer to Vector[n_of_thread] of tp data structure
+// int n_of_thread: number of threads
+// return: void
+// ---
+void jitter_handle(struct task_par* tp, int n_of_thread) {
+	int 	i;	// array indexes [0-n_of_thread]
+
+	printf("-----------------------------------------------\n");
+	printf("ACTIVATION JITTER (us):\n");
+	for(i = 0; i < n_of_thread; i++)
+		if(tp[i].nact)
+			printf("\tThread num: %d - act: %ld - avg: %.1f - max: %ld\n", 
+				i, tp[i].nact, tp[i].jit_sum / tp[i].nact, tp[i].jit_max);
+	printf("-----------------------------------------------\n");
+}
+
+//---------------------------------
+// PUBLIC: PERF EVENTS OF JOBS
+//---------------------------------
+
+// ---
+// Count perf events in the jobs of tasks created from now on
+// int on: 1 to count, 0 to stop counting
+// return: void
+// ---
+void perf_enable(int on) {
+	perf_on = on;
+}
+
+// ---
+// Simply print formatted the perf events per job of each thread (if enabled)
+// task_par* tp: pointer to Vector[n_of_thread] of tp data structure
+// int n_of_thread: number of threads
+// return: void
+// ---
+void perf_handle(struct task_par* tp, int n_of_thread) {
+	struct 	task_perf* p;	// perf events of a task
+	int 	i, e;			// array indexes [0-n_of_thread], event
+	int 	err = 0;		// errno of first event not opened
+
+	if(!perf_on)
+		return;
+	printf("-----------------------------------------------\n");
+	printf("PERF EVENTS PER JOB (avg/max):\n");
+	for(i = 0; i < n_of_thread; i++) {
+		p = &tp[i].perf;
+		if(p->njob == 0)
+			continue;
+		if(err == 0)
+			err = p->err;
+		printf("\tThread num: %d - jobs: %ld", i, p->njob);
+		for(e = 0; e < PERF_NEV; e++)
+			if(p->fd[e] >= 0)
+				printf(" - %s: %.1f/%lu", perf_ev[e].name,
+					(double)p->sum[e] / p->njob, p->max[e]);
+		if(p->fd[PERF_CYCLES] >= 0 && p->fd[PERF_INSTR] >= 0 &&
+				p->sum[PERF_CYCLES] > 0)
+			printf(" - ipc: %.2f",
+				(double)p->sum[PERF_INSTR] / p->sum[PERF_CYCLES]);
+		printf("\n");
+	}
+	if(err)
+		printf("\tsome events not counted: %s\n", strerror(err));
+	printf("-----------------------------------------------\n");
+}
+
+// ---
+// Copy the perf events counted in the jobs of a task ended so far. It can
+// be called by any thread while the task runs: the copy is consistent
+// (retried if the task ends a job meanwhile)
+// task_par* tp: pointer to task parameters
+// long* njob: pointer to jobs counted, filled
+// uint64_t* sum: pointer to Vector[PERF_NEV] counted in every job, filled
+// uint64_t* max: pointer to Vector[PERF_NEV] max counted in a job, filled
+// return: int - mask of events counted (bit PERF_*), 0 if none
+// ---
+int perf_get(struct task_par* tp, long* njob, uint64_t* sum, uint64_t* max) {
+	struct 	task_perf* p = &tp->perf;	// perf events of task
+	unsigned seq;						// version of counters copied
+	int 	e, mask = 0;				// event, events counted
+
+	do {
+		seq = atomic_load_explicit(&p->seq, memory_order_acquire);
+		*njob = p->njob;
+		memcpy(sum, p->sum, sizeof(p->sum));
+		memcpy(max, p->max, sizeof(p->max));
+		atomic_thread_fence(memory_order_acquire);
+	} while((seq & 1) || seq != atomic_load_explicit(&p->seq,
+		memory_order_relaxed));
+
+	for(e = 0; e < PERF_NEV && *njob > 0; e++)
+		if(p->fd[e] >= 0)
+			mask |= 1 << e;
+	return mask;
+}
+
 //---------------------------------
 // PUBLIC: MUTEX UTILITY FUNCTIONS
 //---------------------------------
@@ -176,6 +683,8 @@ void deadline_handle(struct task_par* tp, int n_of_thread) {
 // ---
 void mutex_init(pthread_mutex_t* mutex_id) {
 	pthread_mutexattr_t mattr;
+	int 	k;	// profile of mutex
+
 	pthread_mutexattr_init(&mattr);
 
 	// sem is set to robust to protect from inconsistency 
@@ -185,20 +694,57 @@ void mutex_init(pthread_mutex_t* mutex_id) {
 
 	pthread_mutex_init(mutex_id, &mattr);
 	pthread_mutexattr_destroy(&mattr);
+
+	// profiles are taken before tasks lock them
+	k = atomic_load(&nmtx);
+	if(mtx_on && k < MTX_MAX && mtx_find(mutex_id) == NULL) {
+		memset(&mtx[k], 0, sizeof(struct mutex_stat));
+		mtx[k].id = mutex_id;
+		snprintf(mtx[k].name, MTX_NAMELEN, "mutex %d", k);
+		atomic_store_explicit(&nmtx, k + 1, memory_order_release);
+	}
 }
 
 // ---
-// Mutex lock
+// Mutex lock. A profiled mutex is tried first (if asked): a thread that
+// finds it held notes the chain of owners it waits, then blocks
 // pthread_mutex_t* mutex_id: pointer to identifier of the mutex
 // return: void
 // ---
 void mutex_lock(pthread_mutex_t* mutex_id) {
-	int ret_value = pthread_mutex_lock(mutex_id);
+	struct 	mutex_stat* m = NULL;	// profile, NULL if not profiled
+	struct 	mutex_chain c = {0};	// chain of owners waited
+	uint64_t t0 = trace_now();		// start of wait
+	int 	ret_value = EBUSY;		// result of lock
+	int 	me = -1;				// calling thread (profiling)
+	int 	cont = 0;				// 1 if mutex was found held
+
+	if(mtx_on)
+		m = mtx_find(mutex_id);
+	if(m != NULL) {
+		me = mtx_self();
+		if(mtx_fast)
+			ret_value = pthread_mutex_trylock(mutex_id);
+		if(ret_value == EBUSY && me >= 0) {
+			mtx_chain(m, me, &c);
+			cont = mtx_fast || c.n > 0;
+		}
+	}
+	if(ret_value == EBUSY) {
+		if(me >= 0)
+			atomic_store(&mtx_thr[me].wait, m - mtx + 1);
+		ret_value = pthread_mutex_lock(mutex_id);
+		if(me >= 0)
+			atomic_store(&mtx_thr[me].wait, 0);
+	}
+	trace_span("lock", "mutex wait", t0, NULL, 0);
 
 	// if previous owner of semaphore is dead
 	// we have to make sem consisten again
 	if(ret_value == EOWNERDEAD)
 		pthread_mutex_consistent(mutex_id);
+	if(m != NULL)
+		mtx_acquired(m, me, &c, cont, t0);
 }
 
 // ---
@@ -207,9 +753,92 @@ void mutex_lock(pthread_mutex_t* mutex_id) {
 // return: void
 // ---
 void mutex_unlock(pthread_mutex_t* mutex_id) {
+	struct 	mutex_stat* m = NULL;	// profile, NULL if not profiled
+	uint64_t hold;					// time held (ns)
+
+	if(mtx_on)
+		m = mtx_find(mutex_id);
+	if(m != NULL && m->t_acq != 0) {
+		hold = trace_now() - m->t_acq;
+		m->hold_sum += hold;
+		m->hold_hist[mtx_bin(hold)]++;
+		if(hold > m->hold_max)
+			m->hold_max = hold;
+		m->t_acq = 0;
+		atomic_store(&m->owner, 0);
+	}
 	pthread_mutex_unlock(mutex_id);
 }
 
+// ---
+// Profile mutexes initialized from now on
+// int on: 1 to profile, 0 to stop profiling
+// int fast: 1 to try a mutex before blocking on it
+// return: void
+// ---
+void mutex_prof(int on, int fast) {
+	mtx_on = on;
+	mtx_fast = fast;
+}
+
+// ---
+// Name a profiled mutex in the report
+// pthread_mutex_t* mutex_id: pointer to identifier of the mutex
+// char* name: name of mutex
+// return: void
+// ---
+void mutex_name(pthread_mutex_t* mutex_id, const char* name) {
+	struct 	mutex_stat* m = mtx_find(mutex_id);	// profile of mutex
+
+	if(m != NULL)
+		snprintf(m->name, MTX_NAMELEN, "%s", name);
+}
+
+// ---
+// Simply print formatted contention, wait and hold time of each profiled
+// mutex and the chains that blocked a thread the longest
+// return: void
+// ---
+void mutex_handle() {
+	struct 	mutex_stat* m;		// profile of a mutex
+	struct 	mutex_chain* c;		// blocking chain
+	int 	k, i, j;			// mutex, chain, link
+
+	if(atomic_load(&nmtx) == 0)
+		return;
+	printf("-----------------------------------------------\n");
+	printf("MUTEX CONTENTION (%s):\n", mtx_fast ? "trylock first" : "lock");
+	for(k = 0; k < atomic_load(&nmtx); k++) {
+		m = &mtx[k];
+		if(m->nlock == 0)
+			continue;
+		printf("\t%s: locks: %ld - contended: %ld (%.1f%%) - "
+			"prio boosts: %ld\n", m->name, m->nlock, m->ncont,
+			100.0 * m->ncont / m->nlock, m->nboost);
+		printf("\t\twait avg/p99/max: %.0f/%llu/%llu ns - "
+			"hold avg/p99/max: %.0f/%llu/%llu ns\n",
+			m->wait_sum / m->nlock,
+			(unsigned long long)mtx_quantile(m->wait_hist, m->nlock, 0.99,
+				m->wait_max),
+			(unsigned long long)m->wait_max, m->hold_sum / m->nlock,
+			(unsigned long long)mtx_quantile(m->hold_hist, m->nlock, 0.99,
+				m->hold_max),
+			(unsigned long long)m->hold_max);
+		mtx_hist_print("wait", m->wait_hist);
+		mtx_hist_print("hold", m->hold_hist);
+		for(i = 0; i < MTX_CHAIN && m->worst[i].n > 0; i++) {
+			c = &m->worst[i];
+			printf("\t\tblocked %llu ns: prio %d (tid %d)",
+				(unsigned long long)c->wait, c->prio[0], c->tid[0]);
+			for(j = 0; j < c->n; j++)
+				printf(" -> %s held by prio %d (tid %d)",
+					mtx[c->mtx[j]].name, c->prio[j + 1], c->tid[j + 1]);
+			printf("\n");
+		}
+	}
+	printf("-----------------------------------------------\n");
+}
+
 //--------------------------------
 // PUBLIC: GETTER AND SETTER
 //--------------------------------
@@ -244,8 +873,12 @@ void set_tp_param(struct task_par* tp, int period, int priority) {
 // return: void
 // ---
 void safe_copy(pthread_mutex_t* mutex, void* dest, void* src, size_t len) {
+	uint64_t t0;	// start of critical section (trace)
+
 	mutex_lock(mutex);
+	t0 = trace_now();
 	memcpy(dest, src, len);
+	trace_span("lock", "safe_copy", t0, "len", len);
 	mutex_unlock(mutex);
 }
 
@@ -6,18 +6,80 @@
 #define PTASK_H
 
 #include <pthread.h>
+#include <stdint.h>
 
 #define _GNU_SOURCE
 #define LOW_PRIO 	1		// lowest fifo priority
 #define HIGH_PRIO	99		// highest fifo priority
 
+//---------------------------------
+// PERF EVENTS COUNTED IN EACH JOB (hw ones first, then sw ones)
+//---------------------------------
+#define PERF_CYCLES		0		// cpu cycles
+#define PERF_INSTR		1		// instructions retired
+#define PERF_LLC		2		// last level cache misses
+#define PERF_CSW		3		// context switches (preemptions in a job)
+#define PERF_MIGR		4		// migrations to another cpu
+#define PERF_FAULT		5		// page faults
+#define PERF_NEV		6		// number of events
+#define PERF_NHW		3		// events counted by hardware
+
+struct task_perf {				// perf events of the jobs of a task
+	int 	on;					// 1 once the task has opened its events
+	int 	fd[PERF_NEV];		// event descriptor, -1 if not counted
+	int 	pos[PERF_NEV];		// position in read of its group
+	int 	err;				// errno of first event not opened, 0 if none
+	long 	njob;				// jobs counted
+	_Atomic unsigned seq;		// odd while a job is being added
+	uint64_t start[PERF_NEV];	// counters at start of current job
+	uint64_t sum[PERF_NEV];		// counted in every job
+	uint64_t max[PERF_NEV];		// max counted in a job
+};
+
+//---------------------------------
+// MUTEX PROFILING (contention, hold time, blocking chains)
+//---------------------------------
+#define MTX_MAX			16		// max mutexes profiled
+#define MTX_MAXTHR		32		// max threads that lock profiled mutexes
+#define MTX_NAMELEN		24		// max length of a mutex name
+#define MTX_NBIN		32		// histogram bins, bin k counts [2^k, 2^k+1) ns
+#define MTX_CHAIN		4		// worst blocking chains kept for each mutex
+#define MTX_DEPTH		4		// max mutexes in a blocking chain
+
+struct mutex_chain {			// a thread blocked through owners of mutexes
+	uint64_t wait;				// time waited by first thread (ns)
+	int 	n;					// mutexes in chain
+	int 	tid[MTX_DEPTH + 1];	// tid[k] waits mtx[k], held by tid[k + 1]
+	int 	prio[MTX_DEPTH + 1];	// priority of thread tid[k]
+	int 	mtx[MTX_DEPTH];		// mutexes waited along the chain
+};
+
+struct mutex_stat {				// profile of a mutex, updated by its owner
+	pthread_mutex_t* id;		// mutex profiled
+	char 	name[MTX_NAMELEN];	// name shown in report
+	_Atomic int owner;			// thread holding it + 1, 0 if free
+	uint64_t t_acq;				// time of acquisition (ns), 0 if not held
+	long 	nlock;				// acquisitions
+	long 	ncont;				// acquisitions that found it held
+	long 	nboost;				// waits that boosted a lower prio owner
+	uint64_t wait_max, hold_max;	// longest wait and hold (ns)
+	double 	wait_sum, hold_sum;		// total wait and hold (ns)
+	long 	wait_hist[MTX_NBIN];	// waits by duration
+	long 	hold_hist[MTX_NBIN];	// holds by duration
+	struct 	mutex_chain worst[MTX_CHAIN];	// longest waits, longest first
+};
+
 struct task_par {
 	int 	period;			// period of task in millisecond
 	int 	deadline;		// relative deadline in millisecond
 	int 	priority;		// priority of task [1, 99] 
 	int 	dmiss;			// num of deadline misses
+	long 	nact;			// num of activations measured
+	long 	jit_max;		// max activation jitter (us)
+	double 	jit_sum;		// sum of activation jitters (us)
 	struct 	timespec at;	// next activation time 
 	struct 	timespec dl; 	// absolute deadline
+	struct 	task_perf perf;	// perf events of jobs (if enabled)
 };
 
 //------------------------------------------
@@ -27,6 +89,9 @@ struct task_par {
 // Create task w/ routine fun and prio specified in tp, leave pthread_id in id
 void p_task_create(pthread_t* id, void *(*fun) (void *), struct task_par *tp);
 
+// Create a background task (SCHED_OTHER), it runs when no rt task is ready
+void bg_task_create(pthread_t* id, void *(*fun) (void *), void* arg);
+
 // Kill the thread with pthread_id id
 void p_task_kill(pthread_t id);
 
@@ -49,6 +114,22 @@ int deadline_miss(struct task_par* tp);
 // Simply print formatted the number of dmiss of each thread
 void deadline_handle(struct task_par* tp, int n_of_thread);
 
+// Simply print formatted the activation jitter of each thread
+void jitter_handle(struct task_par* tp, int n_of_thread);
+
+//---------------------------------
+// PUBLIC: PERF EVENTS OF JOBS
+//---------------------------------
+
+// Count perf events in the jobs of tasks created from now on
+void perf_enable(int on);
+
+// Simply print formatted the perf events per job of each thread (if enabled)
+void perf_handle(struct task_par* tp, int n_of_thread);
+
+// Copy counters of jobs of a task so far (any thread), return events mask
+int perf_get(struct task_par* tp, long* njob, uint64_t* sum, uint64_t* max);
+
 //---------------------------------
 // PUBLIC: MUTEX UTILITY FUNCTIONS
 //---------------------------------
@@ -62,6 +143,15 @@ void mutex_lock(pthread_mutex_t* mutex_id);
 // Mutex unlock
 void mutex_unlock(pthread_mutex_t* mutex_id);
 
+// Profile mutexes initialized from now on, trylock first if fast is 1
+void mutex_prof(int on, int fast);
+
+// Name a profiled mutex in the report
+void mutex_name(pthread_mutex_t* mutex_id, const char* name);
+
+// Simply print formatted contention and worst blocking chains of mutexes
+void mutex_handle();
+
 //--------------------------------
 // PUBLIC: GETTER AND SETTER
 //--------------------------------
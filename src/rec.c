@@ -0,0 +1,367 @@
+#include "rec.h"
+#include "ptask.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//------------------------------------------
+// PRIVATE: CLOCK
+//------------------------------------------
+
+// ---
+// Return the current time of the monotonic clock in nanoseconds
+// return: uint64_t - nanoseconds elapsed from an unspecified point
+// ---
+static uint64_t rec_now() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+//------------------------------------------
+// PRIVATE: WRITER
+//------------------------------------------
+
+// ---
+// Close the chunk being filled by stream id and open a new one at the end
+// of file, its index entry is published only once it is mapped
+// rec* r: pointer to recorder
+// int id: stream identifier
+// uint64_t stamp: stamp of first record of new chunk
+// return: int - 0 in case of success, -1 if file is full or on error
+// ---
+static int new_chunk(struct rec* r, int id, uint64_t stamp) {
+	struct 	rec_index* idx;		// index entry of new chunk
+	uint32_t k;					// number of new chunk
+	void* 	mem;				// new chunk
+
+	if(r->chunk[id] != NULL) {
+		msync(r->chunk[id], REC_CHUNK, MS_ASYNC);
+		munmap(r->chunk[id], REC_CHUNK);
+		r->chunk[id] = NULL;
+	}
+
+	k = atomic_load(&r->hdr->nchunk);
+	if(k >= REC_MAXCHUNK)
+		return -1;
+	if(ftruncate(r->fd, REC_DATA + (off_t)(k + 1) * REC_CHUNK))
+		return -1;
+	mem = mmap(NULL, REC_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED,
+		r->fd, REC_DATA + (off_t)k * REC_CHUNK);
+	if(mem == MAP_FAILED)
+		return -1;
+
+	idx = &r->hdr->index[k];
+	idx->stream = id;
+	idx->t_first = stamp;
+	idx->t_last = stamp;
+	atomic_store(&idx->count, 0);
+	atomic_store(&r->hdr->nchunk, k + 1);
+
+	r->chunk[id] = mem;
+	r->cur[id] = k;
+	return 0;
+}
+
+// ---
+// Append a record of stream id to file. Count is updated after the record
+// is copied: a crash can only lose the record being written.
+// rec* r: pointer to recorder
+// int id: stream identifier
+// rec_item* it: pointer to record
+// return: void
+// ---
+static void append(struct rec* r, int id, struct rec_item* it) {
+	struct 	rec_index* idx;		// index entry of chunk being filled
+	uint32_t size;				// record size (byte)
+	uint32_t n;					// records in chunk
+
+	size = r->hdr->stream[id].size;
+	if(r->chunk[id] == NULL ||
+			atomic_load(&r->hdr->index[r->cur[id]].count) == REC_CHUNK / size)
+		if(new_chunk(r, id, it->stamp)) {
+			r->file_drops++;
+			return;
+		}
+
+	idx = &r->hdr->index[r->cur[id]];
+	n = atomic_load_explicit(&idx->count, memory_order_relaxed);
+	memcpy(r->chunk[id] + (size_t)n * size, it, size);
+	idx->t_last = it->stamp;
+	atomic_store_explicit(&idx->count, n + 1, memory_order_release);
+}
+
+// ---
+// Writer: drain every ring in file each REC_FLUSH ms, till asked to stop
+// void* arg: pointer to recorder
+// return: void
+// ---
+static void* rec_writer(void* arg) {
+	struct 	rec* r = arg;	// recorder
+	struct 	timespec t = {0, REC_FLUSH * 1000000L};	// sleep between drains
+	union {
+		struct 	rec_item it;
+		char 	b[sizeof(struct rec_item) + REC_MAXSIZE];
+	} buf;					// record popped from a ring
+	int 	id;				// stream identifier
+	int 	stop;			// last drain
+
+	do {
+		stop = atomic_load(&r->stop);
+		for(id = 0; id < r->hdr->nstream; id++)
+			while(r->ring[id] != NULL && spsc_pop(r->ring[id], &buf) == 0)
+				append(r, id, &buf.it);
+		if(!stop)
+			nanosleep(&t, NULL);
+	} while(!stop);
+	return NULL;
+}
+
+//------------------------------------------
+// PUBLIC: RECORDING
+//------------------------------------------
+
+// ---
+// Create record file (truncated if it exists) and map its header
+// char* file: path of record file
+// return: rec* - pointer to recorder, NULL in case of error
+// ---
+struct rec* rec_open(const char* file) {
+	struct 	rec* r;		// new recorder
+	void* 	mem;		// mapped header
+
+	r = calloc(1, sizeof(struct rec));
+	if(r == NULL)
+		return NULL;
+
+	r->fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(r->fd < 0 || ftruncate(r->fd, REC_DATA)) {
+		free(r);
+		return NULL;
+	}
+	mem = mmap(NULL, REC_DATA, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0);
+	if(mem == MAP_FAILED) {
+		close(r->fd);
+		free(r);
+		return NULL;
+	}
+
+	r->hdr = mem;
+	memcpy(r->hdr->magic, REC_MAGIC, sizeof(REC_MAGIC));
+	r->hdr->version = REC_VERSION;
+	r->hdr->chunk = REC_CHUNK;
+	r->hdr->t_start = rec_now() / 1000;
+	return r;
+}
+
+// ---
+// Add stream id of records with size byte payload
+// rec* r: pointer to recorder
+// int id: stream identifier [0, REC_MAXSTREAM)
+// char* name: stream name
+// size_t size: payload size (byte), at most REC_MAXSIZE
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int rec_add_stream(struct rec* r, int id, const char* name, size_t size) {
+	struct 	rec_stream* s;	// stream description
+
+	if(id < 0 || id >= REC_MAXSTREAM || size > REC_MAXSIZE)
+		return -1;
+
+	s = &r->hdr->stream[id];
+	strncpy(s->name, name, REC_NAMELEN - 1);
+	s->size = sizeof(struct rec_item) + (size + 7) / 8 * 8;
+	r->size[id] = size;
+	r->item[id] = s->size;
+	r->ring[id] = spsc_create(NULL, REC_QLEN, s->size);
+	if(r->ring[id] == NULL)
+		return -1;
+	if(id >= r->hdr->nstream)
+		r->hdr->nstream = id + 1;
+	return 0;
+}
+
+// ---
+// Start the writer (background, below every rt task)
+// rec* r: pointer to recorder
+// return: void
+// ---
+void rec_start(struct rec* r) {
+	bg_task_create(&r->writer, rec_writer, r);
+}
+
+// ---
+// Non blocking: put a record of stream id stamped now (one thread a stream).
+// Cost is a copy in the ring and two clock reads, nothing if r is NULL.
+// The file mapping is not touched, so a put after rec_close is harmless.
+// rec* r: pointer to recorder, NULL if not recording
+// int id: stream identifier
+// void* data: pointer to payload
+// return: void
+// ---
+void rec_put(struct rec* r, int id, const void* data) {
+	union {
+		struct 	rec_item it;
+		char 	b[sizeof(struct rec_item) + REC_MAXSIZE];
+	} buf;					// record pushed in ring
+	struct 	rec_stat* st;	// cost of stream
+	uint64_t t0, cost;		// put start time, put duration (ns)
+
+	if(r == NULL || r->ring[id] == NULL)
+		return;
+
+	t0 = rec_now();
+	buf.it.stamp = t0 / 1000;
+	memcpy(buf.it.data, data, r->size[id]);
+	memset(buf.it.data + r->size[id], 0,
+		r->item[id] - sizeof(struct rec_item) - r->size[id]);
+	st = &r->stat[id];
+	if(spsc_push(r->ring[id], &buf))
+		st->drops++;
+	st->puts++;
+
+	cost = rec_now() - t0;
+	st->cost_sum += cost;
+	if(cost > st->cost_max)
+		st->cost_max = cost;
+}
+
+// ---
+// Drain the rings, close the file and print the cost of recording.
+// Rings are kept: puts still running in rt tasks only fill them.
+// rec* r: pointer to recorder
+// return: void
+// ---
+void rec_close(struct rec* r) {
+	struct 	rec_stat* st;	// cost of a stream
+	int 	id;				// stream identifier
+
+	atomic_store(&r->stop, 1);
+	pthread_join(r->writer, NULL);
+
+	printf("-----------------------------------------------\n");
+	printf("FLIGHT RECORDER (cost per put):\n");
+	for(id = 0; id < r->hdr->nstream; id++) {
+		st = &r->stat[id];
+		if(r->ring[id] == NULL || st->puts == 0)
+			continue;
+		printf("\tstream: %s - puts: %ld - drops: %ld - avg: %lu ns - "
+			"max: %lu ns\n", r->hdr->stream[id].name, st->puts, st->drops,
+			(unsigned long)(st->cost_sum / st->puts),
+			(unsigned long)st->cost_max);
+	}
+	printf("\tchunks: %u - lost (file full): %ld\n",
+		atomic_load(&r->hdr->nchunk), r->file_drops);
+	printf("-----------------------------------------------\n");
+
+	for(id = 0; id < REC_MAXSTREAM; id++)
+		if(r->chunk[id] != NULL)
+			munmap(r->chunk[id], REC_CHUNK);
+	msync(r->hdr, REC_DATA, MS_SYNC);
+	munmap(r->hdr, REC_DATA);
+	close(r->fd);
+}
+
+//------------------------------------------
+// PUBLIC: READING
+//------------------------------------------
+
+// ---
+// Map a record file read only, NULL if it is not valid
+// char* file: path of record file
+// size_t* len: pointer to length of mapping, filled
+// return: rec_header* - pointer to mapped file, NULL in case of error
+// ---
+const struct rec_header* rec_map(const char* file, size_t* len) {
+	const struct rec_header* h;	// mapped file
+	struct 	stat st;			// status of file
+	void* 	mem;				// mapped file
+	int 	fd;					// file descriptor
+
+	fd = open(file, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) || st.st_size < REC_DATA) {
+		close(fd);
+		return NULL;
+	}
+
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mem == MAP_FAILED)
+		return NULL;
+
+	h = mem;
+	if(memcmp(h->magic, REC_MAGIC, sizeof(REC_MAGIC)) ||
+			h->version != REC_VERSION || h->chunk != REC_CHUNK ||
+			h->nstream > REC_MAXSTREAM) {
+		munmap(mem, st.st_size);
+		return NULL;
+	}
+	*len = st.st_size;
+	return h;
+}
+
+// ---
+// Unmap a record file
+// rec_header* h: pointer to mapped file
+// size_t len: length of mapping
+// return: void
+// ---
+void rec_unmap(const struct rec_header* h, size_t len) {
+	munmap((void*)h, len);
+}
+
+// ---
+// Return records of chunk that can be read safely: committed ones, inside
+// the chunk and inside the file (a crash can leave a short file)
+// rec_header* h: pointer to mapped file
+// size_t len: length of mapping
+// uint32_t chunk: chunk number
+// return: uint32_t - number of records
+// ---
+uint32_t rec_count(const struct rec_header* h, size_t len, uint32_t chunk) {
+	const struct rec_index* idx;	// index entry of chunk
+	uint32_t size;					// record size (byte)
+	uint32_t n;						// records
+	size_t 	off;					// offset of chunk in file
+
+	if(chunk >= atomic_load(&h->nchunk) || chunk >= REC_MAXCHUNK)
+		return 0;
+	idx = &h->index[chunk];
+	if(idx->stream >= h->nstream || h->stream[idx->stream].size == 0)
+		return 0;
+
+	size = h->stream[idx->stream].size;
+	off = REC_DATA + (size_t)chunk * REC_CHUNK;
+	if(off >= len)
+		return 0;
+
+	n = atomic_load_explicit(&idx->count, memory_order_acquire);
+	if(n > REC_CHUNK / size)
+		n = REC_CHUNK / size;
+	if(off + (size_t)n * size > len)
+		n = (len - off) / size;
+	return n;
+}
+
+// ---
+// Return pointer to record i of chunk (i must be less than rec_count)
+// rec_header* h: pointer to mapped file
+// uint32_t chunk: chunk number
+// uint32_t i: record number in chunk
+// return: rec_item* - pointer to record
+// ---
+const struct rec_item* rec_record(const struct rec_header* h,
+		uint32_t chunk, uint32_t i) {
+	uint32_t size = h->stream[h->index[chunk].stream].size;	// record size
+
+	return (const struct rec_item*)((const char*)h + REC_DATA +
+		(size_t)chunk * REC_CHUNK + (size_t)i * size);
+}
@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+// REC_H: FLIGHT RECORDER, RT RINGS DRAINED IN A MAPPED APPEND-ONLY FILE
+//-----------------------------------------------------------------------------
+
+#ifndef REC_H
+#define REC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "spsc.h"
+
+#define REC_MAGIC		"CDREC01"	// first bytes of a record file
+#define REC_VERSION		1			// version of file layout
+#define REC_PAGE		4096		// data is aligned to pages (byte)
+#define REC_CHUNK		(1 << 20)	// chunk of records of one stream (byte)
+#define REC_MAXCHUNK	4096		// max chunks of a file (index entries)
+#define REC_MAXSTREAM	8			// max number of streams
+#define REC_MAXSIZE		256			// max payload of a record (byte)
+#define REC_NAMELEN		12			// max length of a stream name
+#define REC_QLEN		256			// records a ring holds (power of 2)
+#define REC_FLUSH		50			// writer sleep between two drains (ms)
+
+struct rec_item {					// record as stored in file
+	uint64_t stamp;					// time of put (us, monotonic clock)
+	char 	data[];					// payload, padded to 8 byte
+};
+
+struct rec_stream {					// stream description in file header
+	char 	name[REC_NAMELEN];		// stream name
+	uint32_t size;					// record size, stamp included (byte)
+};
+
+struct rec_index {					// index entry of a chunk
+	uint32_t stream;				// stream whose records are in chunk
+	_Atomic uint32_t count;			// records committed in chunk
+	uint64_t t_first;				// stamp of first record
+	uint64_t t_last;				// stamp of last committed record
+};
+
+struct rec_header {					// file header, followed by chunks
+	char 	magic[8];				// REC_MAGIC
+	uint32_t version;				// REC_VERSION
+	uint32_t chunk;					// chunk size (byte)
+	uint32_t nstream;				// number of streams
+	_Atomic uint32_t nchunk;		// chunks in file
+	uint64_t t_start;				// stamp of recorder creation
+	struct 	rec_stream stream[REC_MAXSTREAM];	// streams
+	struct 	rec_index index[REC_MAXCHUNK];		// chunks, in file order
+};
+
+// offset of data (chunks) in file
+#define REC_DATA ((sizeof(struct rec_header) + REC_PAGE - 1) / REC_PAGE * REC_PAGE)
+
+struct rec_stat {					// cost of recording, for each stream
+	long 	puts;					// records put by rt task
+	long 	drops;					// records lost (ring full or file full)
+	uint64_t cost_sum;				// time spent in rec_put (ns)
+	uint64_t cost_max;				// max time spent in a rec_put (ns)
+};
+
+struct rec {						// recorder (writer side)
+	int 	fd;						// file descriptor
+	struct 	rec_header* hdr;		// mapped header and index
+	struct 	spsc* ring[REC_MAXSTREAM];	// rt task to writer rings
+	struct 	rec_stat stat[REC_MAXSTREAM];	// recording cost
+	uint32_t size[REC_MAXSTREAM];	// payload size of stream (byte)
+	uint32_t item[REC_MAXSTREAM];	// record size of stream, padded (byte)
+	char* 	chunk[REC_MAXSTREAM];	// mapped chunk being filled (NULL none)
+	int 	cur[REC_MAXSTREAM];		// index entry of chunk being filled
+	long 	file_drops;				// records lost because file is full
+	_Atomic int stop;				// asks writer to drain and exit
+	pthread_t writer;				// writer thread
+};
+
+//------------------------------------------
+// PUBLIC: RECORDING
+//------------------------------------------
+
+// Create record file, streams must be added before rec_start
+struct rec* rec_open(const char* file);
+
+// Add stream id of records with size byte payload
+int rec_add_stream(struct rec* r, int id, const char* name, size_t size);
+
+// Start the writer (background, below every rt task)
+void rec_start(struct rec* r);
+
+// Non blocking: put a record of stream id stamped now (one thread a stream)
+void rec_put(struct rec* r, int id, const void* data);
+
+// Drain the rings, close the file and print the cost of recording
+void rec_close(struct rec* r);
+
+//------------------------------------------
+// PUBLIC: READING (also a file left by a crash)
+//------------------------------------------
+
+// Map a record file read only, NULL if it is not valid
+const struct rec_header* rec_map(const char* file, size_t* len);
+
+// Unmap a record file
+void rec_unmap(const struct rec_header* h, size_t len);
+
+// Return records of chunk that can be read safely
+uint32_t rec_count(const struct rec_header* h, size_t len, uint32_t chunk);
+
+// Return pointer to record i of chunk
+const struct rec_item* rec_record(const struct rec_header* h,
+	uint32_t chunk, uint32_t i);
+
+#endif
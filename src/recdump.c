@@ -0,0 +1,113 @@
+//-----------------------------------------------------
+//
+// RECDUMP: PRINT A FLIGHT RECORD (ALSO ONE LEFT BY A CRASH)
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "rec.h"
+
+//--------------------------------
+// PRIVATE: DUMP FUNCTIONS
+//--------------------------------
+
+// ---
+// Print streams and chunk index of a record file
+// rec_header* h: pointer to mapped file
+// size_t len: length of mapping
+// return: void
+// ---
+static void dump_index(const struct rec_header* h, size_t len) {
+	const struct rec_index* idx;	// index entry of a chunk
+	long 	num[REC_MAXSTREAM] = {0};	// records of each stream
+	uint32_t c, n;					// chunk, records in chunk
+	int 	s;						// stream identifier
+
+	printf("-----------------------------------------------\n");
+	printf("FLIGHT RECORD (version %u):\n", h->version);
+	printf("\tchunks: %u of %d byte - file: %zu byte\n",
+		atomic_load(&h->nchunk), REC_CHUNK, len);
+	for(c = 0; c < atomic_load(&h->nchunk) && c < REC_MAXCHUNK; c++) {
+		idx = &h->index[c];
+		n = rec_count(h, len, c);
+		if(idx->stream < REC_MAXSTREAM)
+			num[idx->stream] += n;
+		printf("\tchunk: %u - stream: %u - records: %u - "
+			"from: %.3f s - to: %.3f s\n", c, idx->stream, n,
+			(idx->t_first - h->t_start) / 1e6,
+			(idx->t_last - h->t_start) / 1e6);
+	}
+	for(s = 0; s < h->nstream; s++)
+		if(h->stream[s].size > 0)
+			printf("\tstream: %d - %s - record: %u byte - records: %ld\n",
+				s, h->stream[s].name, h->stream[s].size, num[s]);
+	printf("-----------------------------------------------\n");
+}
+
+// ---
+// Print records of stream as csv: time from start (s), then payload read
+// as a vector of float
+// rec_header* h: pointer to mapped file
+// size_t len: length of mapping
+// int s: stream identifier
+// return: void
+// ---
+static void dump_stream(const struct rec_header* h, size_t len, int s) {
+	const struct rec_item* it;	// record
+	const float* v;				// payload
+	uint32_t c, i, n;			// chunk, record in chunk, records
+	int 	k, nv;				// value, values in a record
+
+	nv = (h->stream[s].size - sizeof(struct rec_item)) / sizeof(float);
+	for(c = 0; c < atomic_load(&h->nchunk) && c < REC_MAXCHUNK; c++) {
+		if(h->index[c].stream != s)
+			continue;
+		n = rec_count(h, len, c);
+		for(i = 0; i < n; i++) {
+			it = rec_record(h, c, i);
+			v = (const float*)it->data;
+			printf("%.6f", (it->stamp - h->t_start) / 1e6);
+			for(k = 0; k < nv; k++)
+				printf(",%g", v[k]);
+			printf("\n");
+		}
+	}
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+int main(int argc, char** argv) {
+	const struct rec_header* h;	// mapped file
+	size_t 	len;				// length of mapping
+	int 	s;					// stream identifier
+
+	if(argc < 2 || argc > 3) {
+		printf("usage: %s record_file [stream_name]\n", argv[0]);
+		return 1;
+	}
+
+	h = rec_map(argv[1], &len);
+	if(h == NULL) {
+		fprintf(stderr, "%s: not a valid record file\n", argv[1]);
+		return 1;
+	}
+
+	if(argc == 2)
+		dump_index(h, len);
+	else {
+		for(s = 0; s < h->nstream; s++)
+			if(!strncmp(h->stream[s].name, argv[2], REC_NAMELEN))
+				break;
+		if(s == h->nstream) {
+			fprintf(stderr, "%s: no stream %s\n", argv[1], argv[2]);
+			rec_unmap(h, len);
+			return 1;
+		}
+		dump_stream(h, len, s);
+	}
+	rec_unmap(h, len);
+	return 0;
+}
@@ -0,0 +1,285 @@
+#include "replay.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//------------------------------------------
+// PRIVATE: UTILITY FUNCTIONS
+//------------------------------------------
+
+// ---
+// Return the current time of the monotonic clock (same as record stamps)
+// return: uint64_t - microseconds elapsed from an unspecified point
+// ---
+static uint64_t rpl_now() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+// ---
+// Return stamp of record i of chunk k of a track
+// replay* rp: pointer to replay
+// replay_track* tr: pointer to track
+// uint32_t k: chunk (position in track)
+// uint32_t i: record in chunk
+// return: uint64_t - stamp of record (us)
+// ---
+static uint64_t stamp_of(struct replay* rp, struct replay_track* tr,
+		uint32_t k, uint32_t i) {
+	return rec_record(rp->h, tr->chunk[k], i)->stamp;
+}
+
+// ---
+// Return last record of chunk k in [lo, count) stamped at or before t,
+// lo if there is none (binary search, stamps grow inside a chunk)
+// replay* rp: pointer to replay
+// replay_track* tr: pointer to track
+// uint32_t k: chunk (position in track)
+// uint32_t lo: first record searched
+// uint64_t t: record time (us)
+// return: uint32_t - record in chunk
+// ---
+static uint32_t find_record(struct replay* rp, struct replay_track* tr,
+		uint32_t k, uint32_t lo, uint64_t t) {
+	uint32_t hi = tr->count[k];	// first record known to be after t
+	uint32_t mid;				// record tested
+
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if(stamp_of(rp, tr, k, mid) <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+//------------------------------------------
+// PUBLIC: OPEN AND CLOSE
+//------------------------------------------
+
+// ---
+// Map a record file and build the time index of its streams: an entry a
+// chunk, so that a seek is a search among chunks and then in one chunk
+// char* file: path of record file
+// return: replay* - pointer to replay, NULL if file is not a valid record
+// ---
+struct replay* replay_open(const char* file) {
+	struct 	replay* rp;				// new replay
+	struct 	replay_track* tr;		// track of a stream
+	const struct rec_index* idx;	// index entry of a chunk
+	uint32_t c, n, nchunk;			// chunk, records in chunk, chunks
+	uint64_t t;						// stamp of last record of chunk
+	int 	s;						// stream identifier
+
+	rp = calloc(1, sizeof(struct replay));
+	if(rp == NULL)
+		return NULL;
+	rp->h = rec_map(file, &rp->len);
+	if(rp->h == NULL) {
+		free(rp);
+		return NULL;
+	}
+
+	nchunk = atomic_load(&rp->h->nchunk);
+	if(nchunk > REC_MAXCHUNK)
+		nchunk = REC_MAXCHUNK;
+	for(s = 0; s < REC_MAXSTREAM; s++) {
+		tr = &rp->track[s];
+		tr->chunk = malloc(nchunk * sizeof(uint32_t) + 1);
+		tr->t_first = malloc(nchunk * sizeof(uint64_t) + 1);
+		tr->count = malloc(nchunk * sizeof(uint32_t) + 1);
+		if(tr->chunk == NULL || tr->t_first == NULL || tr->count == NULL) {
+			replay_close(rp);
+			return NULL;
+		}
+	}
+
+	rp->t_begin = UINT64_MAX;
+	for(c = 0; c < nchunk; c++) {
+		n = rec_count(rp->h, rp->len, c);
+		if(n == 0)
+			continue;
+		idx = &rp->h->index[c];
+		tr = &rp->track[idx->stream];
+		tr->chunk[tr->n] = c;
+		tr->t_first[tr->n] = rec_record(rp->h, c, 0)->stamp;
+		tr->count[tr->n] = n;
+
+		t = rec_record(rp->h, c, n - 1)->stamp;
+		if(tr->t_first[tr->n] < rp->t_begin)
+			rp->t_begin = tr->t_first[tr->n];
+		if(t > rp->t_end)
+			rp->t_end = t;
+		tr->n++;
+	}
+	if(rp->t_begin > rp->t_end)
+		rp->t_begin = rp->t_end;
+	return rp;
+}
+
+// ---
+// Unmap the record file and free the index
+// replay* rp: pointer to replay
+// return: void
+// ---
+void replay_close(struct replay* rp) {
+	int 	s;	// stream identifier
+
+	for(s = 0; s < REC_MAXSTREAM; s++) {
+		free(rp->track[s].chunk);
+		free(rp->track[s].t_first);
+		free(rp->track[s].count);
+	}
+	rec_unmap(rp->h, rp->len);
+	free(rp);
+}
+
+// ---
+// Return identifier of stream called name, -1 if there is none
+// replay* rp: pointer to replay
+// char* name: stream name
+// return: int - stream identifier, -1 if not found
+// ---
+int replay_stream(struct replay* rp, const char* name) {
+	int 	s;	// stream identifier
+
+	for(s = 0; s < rp->h->nstream; s++)
+		if(!strncmp(rp->h->stream[s].name, name, REC_NAMELEN))
+			return s;
+	return -1;
+}
+
+//------------------------------------------
+// PUBLIC: READ (NO COPY, POINTERS INTO THE MAPPING)
+//------------------------------------------
+
+// ---
+// Move cursor of stream to the last record stamped at or before t, to the
+// first record if t comes before it: O(log n) in the records of stream
+// replay* rp: pointer to replay
+// replay_cur* c: pointer to cursor, filled
+// int stream: stream identifier
+// uint64_t t: record time (us)
+// return: void
+// ---
+void replay_seek(struct replay* rp, struct replay_cur* c, int stream, uint64_t t) {
+	struct 	replay_track* tr = &rp->track[stream];	// track of stream
+	uint32_t lo = 0, hi = tr->n;	// chunks searched
+	uint32_t mid;					// chunk tested
+
+	c->stream = stream;
+	c->k = 0;
+	c->i = 0;
+	if(tr->n == 0)
+		return;
+
+	// last chunk starting at or before t
+	while(hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if(tr->t_first[mid] <= t)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	c->k = lo;
+	c->i = find_record(rp, tr, lo, 0, t);
+}
+
+// ---
+// Return payload of last record stamped at or before t. Playing forward
+// the search starts from cursor, in any other case it is a new seek.
+// replay* rp: pointer to replay
+// replay_cur* c: pointer to cursor of stream, moved to the record
+// uint64_t t: record time (us)
+// return: void* - payload in the mapping, NULL if no record is that old
+// ---
+const void* replay_at(struct replay* rp, struct replay_cur* c, uint64_t t) {
+	struct 	replay_track* tr = &rp->track[c->stream];	// track of stream
+	const struct rec_item* it;	// record found
+
+	if(tr->n == 0)
+		return NULL;
+
+	if(c->k >= tr->n || t < stamp_of(rp, tr, c->k, c->i) ||
+			(c->k + 1 < tr->n && tr->t_first[c->k + 1] <= t))
+		replay_seek(rp, c, c->stream, t);
+	else
+		c->i = find_record(rp, tr, c->k, c->i, t);
+
+	it = rec_record(rp->h, tr->chunk[c->k], c->i);
+	if(it->stamp > t)
+		return NULL;
+	return it->data;
+}
+
+// ---
+// Return record at cursor and move cursor to the next one: a stream is read
+// in order from the position of a seek
+// replay* rp: pointer to replay
+// replay_cur* c: pointer to cursor of stream
+// return: rec_item* - record in the mapping, NULL at the end of stream
+// ---
+const struct rec_item* replay_next(struct replay* rp, struct replay_cur* c) {
+	struct 	replay_track* tr = &rp->track[c->stream];	// track of stream
+	const struct rec_item* it;	// record at cursor
+
+	if(c->k >= tr->n)
+		return NULL;
+
+	it = rec_record(rp->h, tr->chunk[c->k], c->i);
+	if(++c->i == tr->count[c->k]) {
+		c->k++;
+		c->i = 0;
+	}
+	return it;
+}
+
+//------------------------------------------
+// PUBLIC: VIRTUAL CLOCK
+//------------------------------------------
+
+// ---
+// Anchor clock at record time t with speed: record time then runs from t,
+// speed times faster than wall time, unless paused
+// replay* rp: pointer to replay
+// replay_clock* clk: pointer to clock
+// uint64_t t: record time (us), clamped to the file
+// double speed: playback speed, clamped to [RPL_MINSPEED, RPL_MAXSPEED]
+// int paused: 1 if record time is frozen
+// return: void
+// ---
+void replay_set(struct replay* rp, struct replay_clock* clk, uint64_t t,
+		double speed, int paused) {
+	if(t < rp->t_begin)
+		t = rp->t_begin;
+	if(t > rp->t_end)
+		t = rp->t_end;
+	if(speed < RPL_MINSPEED)
+		speed = RPL_MINSPEED;
+	if(speed > RPL_MAXSPEED)
+		speed = RPL_MAXSPEED;
+
+	clk->t_rec = t;
+	clk->t_wall = rpl_now();
+	clk->speed = speed;
+	clk->paused = paused;
+}
+
+// ---
+// Return record time of clock now, it stops at the end of file
+// replay* rp: pointer to replay
+// replay_clock* clk: pointer to clock
+// return: uint64_t - record time (us)
+// ---
+uint64_t replay_time(struct replay* rp, struct replay_clock* clk) {
+	uint64_t t = clk->t_rec;	// record time
+
+	if(!clk->paused)
+		t += (rpl_now() - clk->t_wall) * clk->speed;
+	if(t > rp->t_end)
+		t = rp->t_end;
+	return t;
+}
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// REPLAY_H: PLAYBACK OF A FLIGHT RECORD, SEEK AND SPEED ON A VIRTUAL CLOCK
+//-----------------------------------------------------------------------------
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rec.h"
+
+#define RPL_MINSPEED	0.1		// slowest playback (times real time)
+#define RPL_MAXSPEED	100.0	// fastest playback (times real time)
+
+struct replay_track {			// sparse time index of a stream
+	uint32_t n;					// non empty chunks of stream
+	uint32_t* chunk;			// chunk numbers, in time order
+	uint64_t* t_first;			// stamp of first record of each chunk
+	uint32_t* count;			// readable records of each chunk
+};
+
+struct replay {					// mapped record file
+	const struct rec_header* h;	// mapped file
+	size_t 	len;				// length of mapping
+	struct 	replay_track track[REC_MAXSTREAM];	// index of each stream
+	uint64_t t_begin, t_end;	// first and last stamp of file (us)
+};
+
+struct replay_cur {				// read position in a stream
+	int 	stream;				// stream identifier
+	uint32_t k;					// chunk (position in track)
+	uint32_t i;					// record in chunk
+};
+
+struct replay_clock {			// record time driven by wall time
+	uint64_t t_rec;				// record time at anchor (us)
+	uint64_t t_wall;			// wall time at anchor (us, monotonic)
+	double 	speed;				// record time elapsed each wall second
+	int 	paused;				// record time is frozen
+};
+
+struct replay_stat {			// playback state shown by panel
+	float 	t;					// record time from begin (s)
+	float 	len;				// record length (s)
+	float 	speed;				// playback speed
+	int 	paused;				// playback is paused
+	int 	seeks;				// number of seeks (position jumped)
+};
+
+//------------------------------------------
+// PUBLIC: OPEN AND CLOSE
+//------------------------------------------
+
+// Map a record file and build the time index of its streams, NULL if invalid
+struct replay* replay_open(const char* file);
+
+// Unmap the record file and free the index
+void replay_close(struct replay* rp);
+
+// Return identifier of stream called name, -1 if there is none
+int replay_stream(struct replay* rp, const char* name);
+
+//------------------------------------------
+// PUBLIC: READ (NO COPY, POINTERS INTO THE MAPPING)
+//------------------------------------------
+
+// Move cursor of stream to the last record stamped at or before t
+void replay_seek(struct replay* rp, struct replay_cur* c, int stream, uint64_t t);
+
+// Return payload of last record stamped at or before t, NULL if none
+const void* replay_at(struct replay* rp, struct replay_cur* c, uint64_t t);
+
+// Return record at cursor and move cursor to the next one, NULL at the end
+const struct rec_item* replay_next(struct replay* rp, struct replay_cur* c);
+
+//------------------------------------------
+// PUBLIC: VIRTUAL CLOCK
+//------------------------------------------
+
+// Anchor clock at record time t (clamped to the file) with speed (clamped)
+void replay_set(struct replay* rp, struct replay_clock* clk, uint64_t t,
+	double speed, int paused);
+
+// Return record time of clock now (us), clamped to the file
+uint64_t replay_time(struct replay* rp, struct replay_clock* clk);
+
+#endif
@@ -0,0 +1,168 @@
+#include "scn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* outcome_name[] = {"unknown", "caught", "missed", "timeout"};
+
+//------------------------------------------
+// PRIVATE: PARSING
+//------------------------------------------
+
+// ---
+// Return SIM_* outcome called name (or SCN_ANY)
+// char* name: outcome name
+// return: int - outcome, SIM_UNKNOWN if name is not valid
+// ---
+static int parse_outcome(const char* name) {
+	int 	k;	// outcome
+
+	if(!strcmp(name, "any"))
+		return SCN_ANY;
+	for(k = SIM_CAUGHT; k <= SIM_TIMEOUT; k++)
+		if(!strcmp(name, outcome_name[k]))
+			return k;
+	return SIM_UNKNOWN;
+}
+
+// ---
+// Parse the disturbances that follow a throw
+// char* p: text after expected outcome
+// scn* sc: pointer to scenario, disturbances filled
+// return: int - 0 in case of success, -1 if text is not valid
+// ---
+static int parse_dist(const char* p, struct scn* sc) {
+	struct 	sim_dist* d;	// disturbance parsed
+	char 	kind[8];		// wind or gust
+	char 	c;				// first character left
+	int 	len;			// characters parsed
+
+	while(sscanf(p, " %c", &c) == 1 && c != '#') {
+		if(sc->ndist == SCN_MAXDIST)
+			return -1;
+		d = &sc->dist[sc->ndist];
+		if(sscanf(p, " %7s %ld %ld %f %f %f%n", kind, &d->t0, &d->t1,
+				&d->acc[X], &d->acc[Y], &d->acc[Z], &len) != 6)
+			return -1;
+		if(!strcmp(kind, "wind"))
+			d->obj = SIM_BALL;
+		else if(!strcmp(kind, "gust"))
+			d->obj = SIM_DRONE;
+		else
+			return -1;
+		sc->ndist++;
+		p += len;
+	}
+	return 0;
+}
+
+// ---
+// Parse a line of a scenario file
+// char* line: line of file
+// scn* sc: pointer to scenario, filled
+// return: int - 1 if a scenario is parsed, 0 if line is empty, -1 on error
+// ---
+static int parse_line(const char* line, struct scn* sc) {
+	char 	expect[16];	// outcome expected
+	char 	c;			// first character
+	int 	len;		// characters parsed
+
+	if(sscanf(line, " %c", &c) != 1 || c == '#')
+		return 0;
+
+	memset(sc, 0, sizeof(struct scn));
+	if(sscanf(line, " %31s %f %f %f %f %f %f %f %f %15s%n", sc->name,
+			&sc->d_pos[X], &sc->d_pos[Y], &sc->d_pos[Z],
+			&sc->b_pos[X], &sc->b_pos[Y], &sc->b_pos[Z],
+			&sc->pw, &sc->dir, expect, &len) != 10)
+		return -1;
+	sc->expect = parse_outcome(expect);
+	if(sc->expect == SIM_UNKNOWN)
+		return -1;
+	return parse_dist(line + len, sc) ? -1 : 1;
+}
+
+//------------------------------------------
+// PUBLIC: SCENARIO FILES
+//------------------------------------------
+
+// ---
+// Parse a scenario file (format in scn.h)
+// char* file: path of scenario file
+// uint32_t* n: number of scenarios, filled
+// return: scn* - vector of scenarios (to be freed), NULL on error
+// ---
+struct scn* scn_load(const char* file, uint32_t* n) {
+	struct 	scn* v;				// scenarios
+	struct 	scn* nv;			// scenarios reallocated
+	char 	line[SCN_LINE];		// line of file
+	uint32_t cap;				// scenarios allocated
+	long 	num = 0;			// line number
+	FILE* 	f;					// scenario file
+	int 	ret;				// result of parsing
+
+	f = fopen(file, "r");
+	if(f == NULL) {
+		perror(file);
+		return NULL;
+	}
+
+	*n = 0;
+	cap = SCN_ALLOC;
+	v = malloc(cap * sizeof(struct scn));
+	while(v != NULL && fgets(line, sizeof(line), f) != NULL) {
+		num++;
+		if(*n == cap) {
+			cap *= 2;
+			nv = realloc(v, cap * sizeof(struct scn));
+			if(nv == NULL)
+				break;
+			v = nv;
+		}
+		ret = parse_line(line, &v[*n]);
+		if(ret < 0) {
+			fprintf(stderr, "%s:%ld: not a valid scenario\n", file, num);
+			break;
+		}
+		*n += ret;
+	}
+
+	if(v != NULL && !feof(f)) {
+		free(v);
+		v = NULL;
+	}
+	fclose(f);
+	return v;
+}
+
+// ---
+// Return name of SIM_* outcome (or SCN_ANY)
+// int outcome: outcome
+// return: char* - name
+// ---
+const char* scn_outcome_name(int outcome) {
+	if(outcome == SCN_ANY)
+		return "any";
+	return outcome_name[outcome];
+}
+
+//------------------------------------------
+// PUBLIC: RUN
+//------------------------------------------
+
+// ---
+// Run scenario headless (steps and rates of rt tasks) and fill its result
+// scn* sc: pointer to scenario
+// scn_result* r: pointer to result, filled (idx untouched)
+// return: void
+// ---
+void scn_run(const struct scn* sc, struct scn_result* r) {
+	struct 	sim s;	// headless simulation
+
+	sim_init(&s, (float*)sc->d_pos, (float*)sc->b_pos, sc->pw, sc->dir);
+	sim_disturb(&s, sc->dist, sc->ndist);
+	r->outcome = sim_run(&s);
+	r->pass = sc->expect == SCN_ANY || r->outcome == sc->expect;
+	r->miss = s.miss;
+	r->t = s.tick * SIM_TICK / 1000.0;
+}
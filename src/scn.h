@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// SCN_H: THROW SCENARIOS, PARSED FROM TEXT AND RUN HEADLESS
+//-----------------------------------------------------------------------------
+// A scenario file has a throw on each line ('#' starts a comment):
+//
+//	name  dx dy dz  bx by bz  power dir  expect  [disturbance...]
+//
+// drone and ball start in real coord (m), power and dir as set by panel,
+// expect is caught, missed, timeout or any. A disturbance is
+//
+//	wind t0 t1 ax ay az		ball accelerated from t0 to t1 (ms, m/s^2)
+//	gust t0 t1 ax ay az		drone accelerated from t0 to t1 (ms, m/s^2)
+//-----------------------------------------------------------------------------
+
+#ifndef SCN_H
+#define SCN_H
+
+#include <stdint.h>
+#include "sim.h"
+
+#define SCN_NAMELEN		32		// max length of a scenario name
+#define SCN_MAXDIST		4		// max disturbances of a scenario
+#define SCN_LINE		512		// max length of a line of file
+#define SCN_ALLOC		1024	// scenarios allocated at first
+#define SCN_ANY			-1		// any outcome is expected
+
+struct scn {					// a throw and what it should give
+	char 	name[SCN_NAMELEN];	// scenario name
+	float 	d_pos[SP_DIM];		// drone start (real coord)
+	float 	b_pos[SP_DIM];		// ball start (real coord)
+	float 	pw, dir;			// throw power and direction
+	int 	expect;				// SIM_* outcome expected, or SCN_ANY
+	int 	ndist;				// number of disturbances
+	struct 	sim_dist dist[SCN_MAXDIST];	// disturbances
+};
+
+struct scn_result {				// outcome of a scenario
+	uint32_t idx;				// scenario index in file
+	int 	outcome;			// SIM_* outcome
+	int 	pass;				// 1 if outcome is the expected one
+	float 	miss;				// closest drone to ball distance (m)
+	float 	t;					// simulated time till ball stopped (s)
+};
+
+//------------------------------------------
+// PUBLIC: SCENARIO FILES
+//------------------------------------------
+
+// Parse a scenario file, NULL on error (reported with its line)
+struct scn* scn_load(const char* file, uint32_t* n);
+
+// Return name of SIM_* outcome (or SCN_ANY)
+const char* scn_outcome_name(int outcome);
+
+//------------------------------------------
+// PUBLIC: RUN
+//------------------------------------------
+
+// Run scenario headless and fill its result (idx untouched)
+void scn_run(const struct scn* sc, struct scn_result* r);
+
+#endif
@@ -0,0 +1,97 @@
+#include "shmem.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#define SHM_MODE		0660	// region is read and written by owner and group
+
+//---------------------------------
+// PRIVATE: MAPPING
+//---------------------------------
+
+// ---
+// Map len byte of shared memory object fd, then close fd
+// int fd: descriptor of shared memory object
+// size_t len: length of region (byte)
+// return: void* - pointer to region, NULL in case of error
+// ---
+static void* map_fd(int fd, size_t len) {
+	void* 	mem;	// mapped region
+
+	mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mem == MAP_FAILED)
+		return NULL;
+
+	// rt processes must not page fault on shared state
+	mlock(mem, len);
+	return mem;
+}
+
+//------------------------------------------
+// PUBLIC: CREATE, ATTACH AND REMOVE
+//------------------------------------------
+
+// ---
+// Create (or re-create empty) region name of len byte, return it or NULL.
+// Only owner and group can attach the region: under sudo the group is the
+// one of the invoking user, so an unprivileged panel of that user attaches.
+// char* name: name of region (starting with /)
+// size_t len: length of region (byte)
+// return: void* - pointer to zero-filled region, NULL in case of error
+// ---
+void* shmem_create(const char* name, size_t len) {
+	int 	fd;		// descriptor of shared memory object
+	char* 	gid;	// group of the user who ran sudo, NULL if none
+
+	// a region left by a crashed process is never reused
+	shm_unlink(name);
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, SHM_MODE);
+	if(fd < 0)
+		return NULL;
+
+	// umask may have cleared group bits
+	gid = getenv("SUDO_GID");
+	if(fchmod(fd, SHM_MODE) || (gid != NULL && fchown(fd, -1, atoi(gid))) ||
+			ftruncate(fd, len)) {
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	return map_fd(fd, len);
+}
+
+// ---
+// Map existing region name of len byte, return it or NULL if not created
+// char* name: name of region (starting with /)
+// size_t len: length of region (byte)
+// return: void* - pointer to region, NULL in case of error
+// ---
+void* shmem_attach(const char* name, size_t len) {
+	int 	fd;		// descriptor of shared memory object
+	struct 	stat st;	// status of shared memory object
+
+	fd = shm_open(name, O_RDWR, 0);
+	if(fd < 0)
+		return NULL;
+
+	if(fstat(fd, &st) || st.st_size < len) {
+		close(fd);
+		return NULL;
+	}
+	return map_fd(fd, len);
+}
+
+// ---
+// Unmap region and remove its name, so that no process can attach anymore
+// char* name: name of region (starting with /)
+// void* mem: pointer to region
+// size_t len: length of region (byte)
+// return: void
+// ---
+void shmem_remove(const char* name, void* mem, size_t len) {
+	shm_unlink(name);
+	munmap(mem, len);
+}
@@ -0,0 +1,19 @@
+//-----------------------------------------------------------------------------
+// SHMEM_H: NAMED SHARED MEMORY REGIONS AMONG PROCESSES
+//-----------------------------------------------------------------------------
+
+#ifndef SHMEM_H
+#define SHMEM_H
+
+#include <stddef.h>
+
+// Create (or re-create empty) region name of len byte, return it or NULL
+void* shmem_create(const char* name, size_t len);
+
+// Map existing region name of len byte, return it or NULL if not created
+void* shmem_attach(const char* name, size_t len);
+
+// Unmap region and remove its name, so that no process can attach anymore
+void shmem_remove(const char* name, void* mem, size_t len);
+
+#endif
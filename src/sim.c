@@ -0,0 +1,161 @@
+#include "sim.h"
+#include <string.h>
+#include <math.h>
+
+//------------------------------------------
+// PRIVATE: RATES
+//------------------------------------------
+
+// ---
+// Return 1 if a task of period per (ms) is activated at this tick
+// sim* s: pointer to simulation
+// int per: period of task (ms)
+// return: int - 1 if task runs at this tick, 0 otherwise
+// ---
+static int due(struct sim* s, int per) {
+	return (s->tick * SIM_TICK) % per == 0;
+}
+
+//------------------------------------------
+// PRIVATE: DISTURBANCES
+//------------------------------------------
+
+// ---
+// Add to velocity of obj the disturbances active at this tick, over the
+// step of its task (a flying ball only: a still one has been caught)
+// sim* s: pointer to simulation
+// int obj: SIM_BALL or SIM_DRONE
+// int per: period of task of obj (ms)
+// return: void
+// ---
+static void apply_dist(struct sim* s, int obj, int per) {
+	const struct sim_dist* d;	// disturbance
+	float* 	vel;				// velocity of obj
+	long 	t;					// time of tick (ms)
+	int 	k, i;				// disturbance, axis
+
+	if(obj == SIM_BALL && s->tick > 1 && b_is_still(&s->b))
+		return;
+	vel = (obj == SIM_BALL) ? s->b.velocity : s->d.fx_lin_vel;
+	t = s->tick * SIM_TICK;
+	for(k = 0; k < s->ndist; k++) {
+		d = &s->dist[k];
+		if(d->obj != obj || t < d->t0 || t >= d->t1)
+			continue;
+		for(i = 0; i < SP_DIM; i++)
+			vel[i] += d->acc[i] * per / 1000.0;
+	}
+}
+
+//------------------------------------------
+// PUBLIC: HEADLESS SIMULATION
+//------------------------------------------
+
+// ---
+// Init drone and ball as obj_init does (real coord, panel power and dir)
+// sim* s: pointer to simulation
+// float* d_pos: pointer to Vector[3] with drone initial position
+// float* b_pos: pointer to Vector[3] with ball initial position
+// float pw: throw power from panel
+// float dir: throw direction from panel
+// return: void
+// ---
+void sim_init(struct sim* s, float* d_pos, float* b_pos, float pw, float dir) {
+	memset(s, 0, sizeof(struct sim));
+	d_set_init_pos(&s->d, d_pos);
+	b_set_init_pos(&s->b, b_pos);
+	b_set_init_vel(&s->b, pw / 2, dir);
+	s->miss = INFINITY;
+}
+
+// ---
+// Add disturbances to simulation, applied at the steps of drone and ball
+// sim* s: pointer to simulation (after sim_init)
+// sim_dist* dist: vector of disturbances, must outlive simulation
+// int ndist: number of disturbances
+// return: void
+// ---
+void sim_disturb(struct sim* s, const struct sim_dist* dist, int ndist) {
+	s->dist = dist;
+	s->ndist = ndist;
+}
+
+// ---
+// Advance of one base tick, running the tasks due, return 1 if ball still.
+// At a common activation drone and ball (higher prio) run before driver.
+// sim* s: pointer to simulation
+// return: int - 1 if ball is not moving anymore, 0 otherwise
+// ---
+int sim_step(struct sim* s) {
+	float 	dist;	// drone to ball distance
+
+	if(due(s, SIM_DRN_PER)) {
+		d_up_state(&s->d, &s->c, SIM_DRN_PER / 1000.0);
+		if(s->ndist > 0)
+			apply_dist(s, SIM_DRONE, SIM_DRN_PER);
+	}
+	if(due(s, SIM_BLL_PER)) {
+		b_up_state(&s->b, &s->d, SIM_BLL_PER / 1000.0);
+		if(s->ndist > 0)
+			apply_dist(s, SIM_BALL, SIM_BLL_PER);
+	}
+	if(due(s, SIM_DRV_PER))
+		c_driver_control(&s->d, &s->b, &s->c);
+	s->tick++;
+
+	dist = sqrtf(powf(s->b.position[X] - s->d.fx_lin_pos[X], 2) + 
+		powf(s->b.position[Y] - s->d.fx_lin_pos[Y], 2) + 
+		powf(s->b.position[Z] - s->d.fx_lin_pos[Z], 2));
+	if(dist < s->miss)
+		s->miss = dist;
+
+	// ball is stopped only by a collision or by the floor
+	return s->tick > 1 && b_is_still(&s->b);
+}
+
+// ---
+// Run until ball stops or SIM_MAXTIME, return SIM_* outcome
+// sim* s: pointer to simulation
+// return: int - SIM_CAUGHT, SIM_MISSED or SIM_TIMEOUT
+// ---
+int sim_run(struct sim* s) {
+	while(s->tick * SIM_TICK < SIM_MAXTIME)
+		if(sim_step(s))
+			return s->b.position[Z] > 0 ? SIM_CAUGHT : SIM_MISSED;
+	return SIM_TIMEOUT;
+}
+
+//------------------------------------------
+// PUBLIC: ANALYTIC PREDICTION
+//------------------------------------------
+
+// ---
+// Fill trajectory, landing and catch point of a throw (no rollout)
+// predict* p: pointer to prediction to be filled (id and outcome untouched)
+// float* b_pos: pointer to Vector[3] with ball initial position
+// float pw: throw power from panel
+// float dir: throw direction from panel
+// return: void
+// ---
+void sim_predict(struct predict* p, float* b_pos, float pw, float dir) {
+	struct 	bstate b = {{0}};	// ball at throw
+	float 	g;					// deceleration of the ball
+	float 	t_land, t;			// time to reach the floor, sample time
+	int 	i;					// trajectory point index
+
+	b_set_init_pos(&b, b_pos);
+	b_set_init_vel(&b, pw / 2, dir);
+	c_calc_ball_pos(b.position, b.velocity, 0, p->land);
+	c_calc_ball_pos(b.position, b.velocity, DFINALH, p->catch_pos);
+
+	// free fall arc sampled from throw to floor
+	g = GRAVITY / BLACCSCALEZ;
+	t_land = (b.velocity[Z] + sqrtf(b.velocity[Z] * b.velocity[Z] + 
+		2 * g * fmaxf(b.position[Z], 0))) / g;
+	for(i = 0; i < SIM_TRJ; i++) {
+		t = t_land * i / (SIM_TRJ - 1);
+		p->traj[i][X] = b.position[X] + b.velocity[X] * t;
+		p->traj[i][Y] = b.position[Y] + b.velocity[Y] * t;
+		p->traj[i][Z] = fmaxf(b.position[Z] + (b.velocity[Z] - g / 2 * t) * t, 0);
+	}
+}
@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// SIM_H: HEADLESS SIMULATION OF A THROW, SAME STEPS AND RATES OF RT TASKS
+//-----------------------------------------------------------------------------
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "physics.h"
+
+//------------------------------------
+// TASK RATES REPRODUCED BY SIMULATION
+//------------------------------------
+#define SIM_DRV_PER		20		// driver task period (ms)
+#define SIM_DRN_PER		30		// drone task period (ms)
+#define SIM_BLL_PER		30		// ball task period (ms)
+#define SIM_TICK		10		// simulation base tick (ms)
+#define SIM_MAXTIME		30000	// rollout stops after this time (ms)
+
+//------------------------------------
+// OUTCOME OF A THROW
+//------------------------------------
+#define SIM_UNKNOWN		0		// not simulated (yet)
+#define SIM_CAUGHT		1		// ball stopped by drone
+#define SIM_MISSED		2		// ball reached the floor
+#define SIM_TIMEOUT		3		// ball still flying at SIM_MAXTIME
+
+#define SIM_TRJ			24		// points of predicted trajectory
+
+//------------------------------------
+// DISTURBANCES
+//------------------------------------
+#define SIM_BALL		0		// disturbance pushes the ball
+#define SIM_DRONE		1		// disturbance pushes the drone
+
+struct sim_dist {				// acceleration applied at every step
+	int 	obj;				// SIM_BALL or SIM_DRONE
+	long 	t0, t1;				// active from t0 to t1 (ms)
+	float 	acc[SP_DIM];		// acceleration (m/s^2, fixed frame)
+};
+
+struct sim {					// state of a headless simulation
+	struct 	dstate d;			// drone state
+	struct 	bstate b;			// ball state
+	struct 	cstate c;			// controller state
+	long 	tick;				// number of base ticks done
+	float 	miss;				// closest drone to ball distance (m)
+	const struct sim_dist* dist;	// disturbances, NULL if none
+	int 	ndist;				// number of disturbances
+};
+
+struct predict {				// analytic prediction of a throw
+	uint32_t id;				// configuration it refers to
+	int 	outcome;			// SIM_* outcome of rollout
+	float 	miss;				// closest drone to ball distance (m)
+	float 	traj[SIM_TRJ][SP_DIM];	// ball trajectory till the floor
+	float 	land[SP_DIM];		// where ball reaches the floor
+	float 	catch_pos[SP_DIM];	// where ball crosses drone final height
+};
+
+//------------------------------------------
+// PUBLIC: HEADLESS SIMULATION
+//------------------------------------------
+
+// Init drone and ball as obj_init does (real coord, panel power and dir)
+void sim_init(struct sim* s, float* d_pos, float* b_pos, float pw, float dir);
+
+// Add disturbances to simulation (after sim_init), dist must outlive it
+void sim_disturb(struct sim* s, const struct sim_dist* dist, int ndist);
+
+// Advance of one base tick, running the tasks due, return 1 if ball still
+int sim_step(struct sim* s);
+
+// Run until ball stops or SIM_MAXTIME, return SIM_* outcome
+int sim_run(struct sim* s);
+
+//------------------------------------------
+// PUBLIC: ANALYTIC PREDICTION
+//------------------------------------------
+
+// Fill trajectory, landing and catch point of a throw (no rollout)
+void sim_predict(struct predict* p, float* b_pos, float pw, float dir);
+
+#endif
@@ -0,0 +1,127 @@
+#include "spsc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+//------------------------------------------
+// PUBLIC: QUEUE CREATION
+//------------------------------------------
+
+// ---
+// Return the memory needed by a queue of cap elements of size byte
+// uint32_t cap: number of elements
+// size_t size: size of an element (byte)
+// return: size_t - byte needed by the queue
+// ---
+size_t spsc_mem(uint32_t cap, size_t size) {
+	return sizeof(struct spsc) + cap * size;
+}
+
+// ---
+// Init a queue at mem (allocated if NULL), cap must be a power of 2.
+// The queue holds no pointer, so mem can be shared among processes.
+// void* mem: pointer to spsc_mem(cap, size) byte (cache aligned) or NULL
+// uint32_t cap: number of elements
+// size_t size: size of an element (byte)
+// return: spsc* - pointer to queue, NULL in case of error
+// ---
+struct spsc* spsc_create(void* mem, uint32_t cap, size_t size) {
+	struct 	spsc* q;	// new queue
+
+	if(cap == 0 || (cap & (cap - 1)))
+		return NULL;
+	if(mem == NULL)
+		mem = aligned_alloc(SPSC_LINE,
+			(spsc_mem(cap, size) + SPSC_LINE - 1) / SPSC_LINE * SPSC_LINE);
+	if(mem == NULL)
+		return NULL;
+
+	q = mem;
+	q->size = size;
+	q->cap = cap;
+	atomic_init(&q->head, 0);
+	atomic_init(&q->tail, 0);
+	sem_init(&q->items, 1, 0);
+	return q;
+}
+
+//------------------------------------------
+// PUBLIC: PRODUCER
+//------------------------------------------
+
+// ---
+// Copy src at the end of queue, return 0 on success, -1 if queue is full
+// spsc* q: pointer to queue
+// void* src: pointer to element to be copied
+// return: int - 0 in case of success, -1 if queue is full
+// ---
+int spsc_push(struct spsc* q, const void* src) {
+	uint32_t head, tail;	// producer and consumer index
+
+	head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+	if(head - tail == q->cap)
+		return -1;
+
+	memcpy(q->data + (head & (q->cap - 1)) * q->size, src, q->size);
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+
+	// sem_post enters the kernel only if the consumer is sleeping
+	sem_post(&q->items);
+	return 0;
+}
+
+//------------------------------------------
+// PUBLIC: CONSUMER
+//------------------------------------------
+
+// ---
+// Move the first element in dest (queue must not be empty)
+// spsc* q: pointer to queue
+// void* dest: pointer to memory that receives the element
+// return: void
+// ---
+static void spsc_take(struct spsc* q, void* dest) {
+	uint32_t tail;	// consumer index
+
+	tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	memcpy(dest, q->data + (tail & (q->cap - 1)) * q->size, q->size);
+	atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+}
+
+// ---
+// Non blocking: move first element in dest, return 0, or -1 if queue empty
+// spsc* q: pointer to queue
+// void* dest: pointer to memory that receives the element
+// return: int - 0 in case of success, -1 if queue is empty
+// ---
+int spsc_pop(struct spsc* q, void* dest) {
+	// every element has its own token in the semaphore
+	if(sem_trywait(&q->items))
+		return -1;
+
+	spsc_take(q, dest);
+	return 0;
+}
+
+// ---
+// Blocking: wait for an element and move it in dest
+// spsc* q: pointer to queue
+// void* dest: pointer to memory that receives the element
+// return: void
+// ---
+void spsc_pop_wait(struct spsc* q, void* dest) {
+	while(sem_wait(&q->items) && errno == EINTR)
+		;
+	spsc_take(q, dest);
+}
+
+// ---
+// Return the number of elements in the queue
+// spsc* q: pointer to queue
+// return: uint32_t - number of elements
+// ---
+uint32_t spsc_count(struct spsc* q) {
+	return atomic_load_explicit(&q->head, memory_order_acquire) -
+		atomic_load_explicit(&q->tail, memory_order_acquire);
+}
@@ -0,0 +1,54 @@
+//-----------------------------------------------------------------------------
+// SPSC_H: LOCK-FREE SINGLE PRODUCER SINGLE CONSUMER QUEUE
+//-----------------------------------------------------------------------------
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+
+#define SPSC_LINE	64		// cache line size (byte)
+
+struct spsc {							// queue header, elements follow it
+	size_t 	size;						// size of an element (byte)
+	uint32_t cap;						// number of elements (power of 2)
+	sem_t 	items;						// wakes a consumer blocked in pop
+	_Alignas(SPSC_LINE) _Atomic uint32_t head;	// next element to be pushed
+	_Alignas(SPSC_LINE) _Atomic uint32_t tail;	// next element to be popped
+	_Alignas(SPSC_LINE) char data[];	// elements
+};
+
+//------------------------------------------
+// PUBLIC: QUEUE CREATION
+//------------------------------------------
+
+// Return the memory needed by a queue of cap elements of size byte
+size_t spsc_mem(uint32_t cap, size_t size);
+
+// Init a queue at mem (allocated if NULL), cap must be a power of 2
+struct spsc* spsc_create(void* mem, uint32_t cap, size_t size);
+
+//------------------------------------------
+// PUBLIC: PRODUCER (only one thread)
+//------------------------------------------
+
+// Copy src at the end of queue, return 0 on success, -1 if queue is full
+int spsc_push(struct spsc* q, const void* src);
+
+//------------------------------------------
+// PUBLIC: CONSUMER (only one thread)
+//------------------------------------------
+
+// Non blocking: move first element in dest, return 0, or -1 if queue empty
+int spsc_pop(struct spsc* q, void* dest);
+
+// Blocking: wait for an element and move it in dest
+void spsc_pop_wait(struct spsc* q, void* dest);
+
+// Return the number of elements in the queue
+uint32_t spsc_count(struct spsc* q);
+
+#endif
@@ -0,0 +1,629 @@
+//-----------------------------------------------------
+//
+// STRESS: INTERFERENCE LOAD AND ROBUSTNESS OF THE RT TASK SET
+//
+//-----------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include "ptask.h"
+#include "udp.h"
+#include "scn.h"
+
+#define STR_LEVEL		4			// levels swept by default (0 is no load)
+#define STR_MAXLEVEL	16			// max levels swept
+#define STR_TIME		60			// duration of a level by default (s)
+#define STR_MAXTHR		64			// max interference threads
+#define STR_HOG_PER		10			// period of a cpu hog (ms)
+#define STR_HOG_PRIO	2			// priority of cpu hogs by default
+#define STR_HOG_BUSY	50			// busy part of hog period by default (%)
+#define STR_MEM_KB		16384		// buffer of a thrasher by default (kB)
+#define STR_LINE		64			// cache line (byte)
+#define STR_RATE		20000		// packets/s of flood by default, per level
+#define STR_SYS_BATCH	256			// syscalls of a storm between two checks
+#define STR_FLOOD_IP	"127.0.0.1"	// destination of flood
+#define STR_NBIN		24			// resp bins, bin k counts [2^k, 2^k+1) us
+
+//--------------------------------
+// TASK SET (periods and priorities of the tasks of main)
+//--------------------------------
+#define STR_DRV			0			// driver task
+#define STR_DRN			1			// drone task
+#define STR_BLL			2			// ball task
+#define STR_NTASK		3			// tasks of the set
+#define STR_DRV_PRIO	2			// driver task priority, as DRV_PRIO
+#define STR_DRN_PRIO	3			// drone task priority, as DRN_PRIO
+#define STR_BLL_PRIO	3			// ball task priority, as BLL_PRIO
+
+//--------------------------------
+// INTERFERENCE KINDS
+//--------------------------------
+#define STR_HOG			0			// cpu hog jobs
+#define STR_MEM			1			// cache lines written by thrashers
+#define STR_SYS			2			// syscalls of storms
+#define STR_NET			3			// packets of flood
+#define STR_NKIND		4			// kinds of interference
+
+struct stress_cfg {					// interference added at each level
+	int 	hog;					// cpu hogs
+	int 	hog_prio;				// priority of hogs, 0 for not rt
+	int 	hog_busy;				// busy part of hog period (%)
+	int 	mem;					// cache and memory thrashers
+	size_t 	mem_len;				// buffer of a thrasher (byte)
+	int 	sys;					// syscall storms
+	int 	port;					// udp port flooded, 0 for none
+	int 	rate;					// packets/s of flood
+};
+
+struct load {						// interference threads of a level
+	_Atomic int stop;				// 1 when threads have to end
+	_Atomic long work[STR_NKIND];	// work done, by kind
+	pthread_t id[STR_MAXTHR];		// threads
+	struct 	task_par tp[STR_MAXTHR];	// parameters of rt hogs
+	int 	n;						// threads
+	int 	busy;					// busy time of a hog job (us)
+	size_t 	mem_len;				// buffer of a thrasher (byte)
+	int 	sock;					// socket of flood
+	int 	rate;					// packets/s of flood
+};
+
+struct run {						// throws run by the task set
+	pthread_mutex_t mtx;			// states, shared by the tasks
+	struct 	sim s;					// drone, ball and controller states
+	const struct scn* sc;			// scenarios thrown in turn
+	uint32_t n, next;				// scenarios, next one thrown
+	long 	nball;					// ball jobs of current throw
+	_Atomic int stop;				// 1 when tasks have to end
+	struct 	task_par tp[STR_NTASK];	// task parameters
+	pthread_t id[STR_NTASK];		// tasks
+};
+
+struct level_res {					// what the task set took at a level
+	long 	work[STR_NKIND];		// interference work per second
+	long 	dmiss[STR_NTASK];		// deadline misses
+	long 	njob[STR_NTASK];		// jobs
+	double 	resp_sum[STR_NTASK];	// sum of response times (us)
+	long 	resp_max[STR_NTASK];	// max response time (us)
+	long 	hist[STR_NTASK][STR_NBIN];	// response times by duration
+	long 	thrown, caught, missed, timeout, pass;	// throws and outcomes
+};
+
+static struct load ld;				// interference of current level
+static struct run run;				// task set of current level
+static struct level_res res[STR_MAXLEVEL + 1];	// results of each level
+static struct level_res* cur;		// results of current level
+static const char* task_name[STR_NTASK] = {"driver", "drone", "ball"};
+static const char* kind_name[STR_NKIND] = {
+	"hog jobs/s", "lines/s", "syscalls/s", "packets/s"};
+
+//--------------------------------
+// PRIVATE: TIME
+//--------------------------------
+
+// ---
+// Return the current time of the monotonic clock in ns
+// return: uint64_t - ns elapsed from an unspecified point
+// ---
+static uint64_t now_ns() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+//--------------------------------
+// PRIVATE: INTERFERENCE
+//--------------------------------
+
+// ---
+// Cpu hog: busy for part of every STR_HOG_PER ms, at rt priority if tp is
+// given (it preempts the tasks of lower priority), as a normal thread else
+// void* arg: pointer to task parameters, NULL if not rt
+// return: void
+// ---
+static void* hog_task(void* arg) {
+	struct 	task_par* tp = arg;	// task parameters
+	uint64_t t0;				// start of busy time (ns)
+
+	if(tp != NULL)
+		set_period(tp);
+	while(!atomic_load(&ld.stop)) {
+		t0 = now_ns();
+		while(now_ns() - t0 < ld.busy * 1000ull);
+		atomic_fetch_add(&ld.work[STR_HOG], 1);
+		if(tp != NULL)
+			wait_for_period(tp);
+		else
+			usleep(STR_HOG_PER * 1000 - ld.busy);
+	}
+	return NULL;
+}
+
+// ---
+// Thrasher: write a line of its buffer after the other, the buffer being
+// larger than last level cache it evicts the tasks and eats memory bandwidth
+// void* arg: not used
+// return: void
+// ---
+static void* mem_task(void* arg) {
+	volatile char* buf;	// buffer thrashed
+	size_t 	k;			// byte
+
+	buf = calloc(ld.mem_len, 1);
+	if(buf == NULL)
+		return NULL;
+	while(!atomic_load(&ld.stop)) {
+		for(k = 0; k < ld.mem_len; k += STR_LINE)
+			buf[k]++;
+		atomic_fetch_add(&ld.work[STR_MEM], ld.mem_len / STR_LINE);
+	}
+	free((void*)buf);
+	return NULL;
+}
+
+// ---
+// Syscall storm: enter and leave the kernel without end
+// void* arg: not used
+// return: void
+// ---
+static void* sys_task(void* arg) {
+	int 	k;	// syscall
+
+	while(!atomic_load(&ld.stop)) {
+		for(k = 0; k < STR_SYS_BATCH; k++)
+			syscall(SYS_getppid);
+		atomic_fetch_add(&ld.work[STR_SYS], STR_SYS_BATCH);
+	}
+	return NULL;
+}
+
+// ---
+// Flood: send packets as long as a graphic packet to the udp port, at the
+// rate of the level (packets refused by a closed port are not counted)
+// void* arg: not used
+// return: void
+// ---
+static void* net_task(void* arg) {
+	char 	pkt[UDP_LEGACY_LEN] = {0};	// packet sent
+	uint64_t t0 = now_ns();				// start of flood (ns)
+	long 	sent = 0, due;				// packets sent, due by now
+
+	while(!atomic_load(&ld.stop)) {
+		due = (now_ns() - t0) / 1E9 * ld.rate;
+		for(; sent < due; sent++)
+			if(send(ld.sock, pkt, sizeof(pkt), 0) > 0)
+				atomic_fetch_add(&ld.work[STR_NET], 1);
+		usleep(1000);
+	}
+	return NULL;
+}
+
+// ---
+// Start the interference of a level: level times the threads of each kind
+// stress_cfg* cfg: pointer to interference added at each level
+// int level: level
+// return: void
+// ---
+static void load_start(const struct stress_cfg* cfg, int level) {
+	int 	k;	// thread
+
+	memset(&ld, 0, sizeof(ld));
+	ld.busy = STR_HOG_PER * 10 * cfg->hog_busy;
+	ld.mem_len = cfg->mem_len;
+	ld.rate = cfg->rate * level;
+	for(k = 0; k < cfg->hog * level && ld.n < STR_MAXTHR; k++, ld.n++)
+		if(cfg->hog_prio > 0) {
+			set_tp_param(&ld.tp[ld.n], STR_HOG_PER, cfg->hog_prio);
+			p_task_create(&ld.id[ld.n], hog_task, &ld.tp[ld.n]);
+		}
+		else
+			bg_task_create(&ld.id[ld.n], hog_task, NULL);
+	for(k = 0; k < cfg->mem * level && ld.n < STR_MAXTHR; k++, ld.n++)
+		bg_task_create(&ld.id[ld.n], mem_task, NULL);
+	for(k = 0; k < cfg->sys * level && ld.n < STR_MAXTHR; k++, ld.n++)
+		bg_task_create(&ld.id[ld.n], sys_task, NULL);
+	if(cfg->port > 0 && level > 0 && ld.n < STR_MAXTHR) {
+		ld.sock = udp_init(STR_FLOOD_IP, cfg->port);
+		if(ld.sock >= 0)
+			bg_task_create(&ld.id[ld.n++], net_task, NULL);
+	}
+}
+
+// ---
+// Stop the interference of current level and leave its work per second
+// double sec: time it lasted (s)
+// long* work: pointer to Vector[STR_NKIND] to be filled
+// return: void
+// ---
+static void load_stop(double sec, long* work) {
+	int 	k;	// thread, kind
+
+	atomic_store(&ld.stop, 1);
+	for(k = 0; k < ld.n; k++)
+		wait_for_task_end(ld.id[k]);
+	if(ld.sock > 0)
+		close(ld.sock);
+	for(k = 0; k < STR_NKIND; k++)
+		work[k] = atomic_load(&ld.work[k]) / sec;
+}
+
+//--------------------------------
+// PRIVATE: TASK SET
+//--------------------------------
+
+// ---
+// Start the next scenario of the corpus
+// return: void
+// ---
+static void throw_next() {
+	const struct scn* sc = &run.sc[run.next++ % run.n];	// scenario
+
+	sim_init(&run.s, (float*)sc->d_pos, (float*)sc->b_pos, sc->pw, sc->dir);
+	run.nball = 0;
+}
+
+// ---
+// Account the outcome of current throw and start the next one
+// int outcome: SIM_* outcome
+// return: void
+// ---
+static void throw_end(int outcome) {
+	const struct scn* sc = &run.sc[(run.next - 1) % run.n];	// scenario
+
+	cur->thrown++;
+	cur->caught += outcome == SIM_CAUGHT;
+	cur->missed += outcome == SIM_MISSED;
+	cur->timeout += outcome == SIM_TIMEOUT;
+	cur->pass += sc->expect == SCN_ANY || sc->expect == outcome;
+	throw_next();
+}
+
+// ---
+// End a job of task k: account its response time (from its activation)
+// and its deadline, then wait next activation
+// int k: task
+// return: void
+// ---
+static void job_end(int k) {
+	struct 	task_par* tp = &run.tp[k];	// task parameters
+	struct 	timespec t;					// current time
+	long 	resp;						// response time (us)
+	int 	bin;						// bin of response time
+
+	// after the wake up at is already the next activation
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	resp = (t.tv_sec - tp->at.tv_sec) * 1000000 +
+		(t.tv_nsec - tp->at.tv_nsec) / 1000 + tp->period * 1000;
+	bin = (resp > 1) ? 63 - __builtin_clzl(resp) : 0;
+	cur->hist[k][(bin < STR_NBIN) ? bin : STR_NBIN - 1]++;
+	cur->resp_sum[k] += resp;
+	if(resp > cur->resp_max[k])
+		cur->resp_max[k] = resp;
+	cur->njob[k]++;
+	deadline_miss(tp);
+	wait_for_period(tp);
+}
+
+// ---
+// Driver task: control of the drone, as driver_task of main
+// void* arg: not used
+// return: void
+// ---
+static void* driver_task(void* arg) {
+	set_period(&run.tp[STR_DRV]);
+	while(!atomic_load(&run.stop)) {
+		mutex_lock(&run.mtx);
+		c_driver_control(&run.s.d, &run.s.b, &run.s.c);
+		mutex_unlock(&run.mtx);
+		job_end(STR_DRV);
+	}
+	return NULL;
+}
+
+// ---
+// Drone task: step of the drone, as drone_task of main
+// void* arg: not used
+// return: void
+// ---
+static void* drone_task(void* arg) {
+	set_period(&run.tp[STR_DRN]);
+	while(!atomic_load(&run.stop)) {
+		mutex_lock(&run.mtx);
+		d_up_state(&run.s.d, &run.s.c, SIM_DRN_PER / 1000.0);
+		mutex_unlock(&run.mtx);
+		job_end(STR_DRN);
+	}
+	return NULL;
+}
+
+// ---
+// Ball task: step of the ball, as ball_task of main; it ends a throw when
+// the ball stops (or at SIM_MAXTIME) and starts the next one
+// void* arg: not used
+// return: void
+// ---
+static void* ball_task(void* arg) {
+	set_period(&run.tp[STR_BLL]);
+	while(!atomic_load(&run.stop)) {
+		mutex_lock(&run.mtx);
+		b_up_state(&run.s.b, &run.s.d, SIM_BLL_PER / 1000.0);
+		run.nball++;
+		if(run.nball > 1 && b_is_still(&run.s.b))
+			throw_end(run.s.b.position[Z] > 0 ? SIM_CAUGHT : SIM_MISSED);
+		else if(run.nball * SIM_BLL_PER >= SIM_MAXTIME)
+			throw_end(SIM_TIMEOUT);
+		mutex_unlock(&run.mtx);
+		job_end(STR_BLL);
+	}
+	return NULL;
+}
+
+// ---
+// Run the task set throwing the scenarios for sec seconds
+// int sec: duration (s)
+// return: void
+// ---
+static void run_tasks(int sec) {
+	int 	k;	// task
+
+	memset(run.tp, 0, sizeof(run.tp));
+	set_tp_param(&run.tp[STR_DRV], SIM_DRV_PER, STR_DRV_PRIO);
+	set_tp_param(&run.tp[STR_DRN], SIM_DRN_PER, STR_DRN_PRIO);
+	set_tp_param(&run.tp[STR_BLL], SIM_BLL_PER, STR_BLL_PRIO);
+	atomic_store(&run.stop, 0);
+
+	// every level throws the same scenarios from the first one
+	run.next = 0;
+	throw_next();
+
+	p_task_create(&run.id[STR_DRN], drone_task, &run.tp[STR_DRN]);
+	p_task_create(&run.id[STR_BLL], ball_task, &run.tp[STR_BLL]);
+	p_task_create(&run.id[STR_DRV], driver_task, &run.tp[STR_DRV]);
+	sleep(sec);
+	atomic_store(&run.stop, 1);
+	for(k = 0; k < STR_NTASK; k++) {
+		wait_for_task_end(run.id[k]);
+		cur->dmiss[k] = run.tp[k].dmiss;
+	}
+}
+
+//--------------------------------
+// PRIVATE: REPORT
+//--------------------------------
+
+// ---
+// Return the upper bound of the bin where a quantile of histogram falls
+// long* hist: pointer to Vector[STR_NBIN] histogram
+// long n: number of samples
+// double q: quantile [0, 1]
+// long max: longest duration counted (us), the bound of last bin
+// return: long - duration (us)
+// ---
+static long quantile(long* hist, long n, double q, long max) {
+	long 	sum = 0;	// samples up to bin
+	int 	k;			// bin
+
+	for(k = 0; k < STR_NBIN - 1; k++) {
+		sum += hist[k];
+		if(sum >= q * n)
+			break;
+	}
+	return ((2l << k) < max) ? 2l << k : max;
+}
+
+// ---
+// Print the interference of a level
+// stress_cfg* cfg: pointer to interference added at each level
+// int level: level
+// return: void
+// ---
+static void print_load(const struct stress_cfg* cfg, int level) {
+	printf("-----------------------------------------------\n");
+	printf("LEVEL %d: %d cpu hogs (prio %d, %d%% of %d ms) - %d thrashers "
+		"(%zu kB) - %d syscall storms - ", level, cfg->hog * level,
+		cfg->hog_prio, cfg->hog_busy, STR_HOG_PER, cfg->mem * level,
+		cfg->mem_len >> 10, cfg->sys * level);
+	if(cfg->port > 0)
+		printf("flood of port %d at %d packets/s\n", cfg->port,
+			cfg->rate * level);
+	else
+		printf("no flood\n");
+}
+
+// ---
+// Print the interference work done at a level
+// level_res* r: pointer to results of level
+// return: void
+// ---
+static void print_work(struct level_res* r) {
+	int 	k;	// kind
+
+	printf("\tload:");
+	for(k = 0; k < STR_NKIND; k++)
+		printf(" %s %ld", kind_name[k], r->work[k]);
+	printf("\n");
+}
+
+// ---
+// Print what the task set took at a level
+// level_res* r: pointer to results of level
+// return: void
+// ---
+static void print_level(struct level_res* r) {
+	int 	k, b;	// task, bin
+
+	print_work(r);
+	for(k = 0; k < STR_NTASK; k++) {
+		printf("\t%s: jobs: %ld - dmiss: %ld - resp avg/p99/max: "
+			"%.0f/%ld/%ld us\n", task_name[k], r->njob[k], r->dmiss[k],
+			r->njob[k] ? r->resp_sum[k] / r->njob[k] : 0,
+			quantile(r->hist[k], r->njob[k], 0.99, r->resp_max[k]),
+			r->resp_max[k]);
+		printf("\t\tresp (us):");
+		for(b = 0; b < STR_NBIN; b++)
+			if(r->hist[k][b])
+				printf(" <%ld: %ld", 2l << b, r->hist[k][b]);
+		printf("\n");
+	}
+	printf("\tthrows: %ld - caught: %ld (%.1f%%) - missed: %ld - "
+		"timeout: %ld - as expected: %ld\n", r->thrown, r->caught,
+		r->thrown ? 100.0 * r->caught / r->thrown : 0, r->missed,
+		r->timeout, r->pass);
+}
+
+// ---
+// Print dmiss, p99 response time and catch success against level
+// int levels: last level swept
+// return: void
+// ---
+static void print_summary(int levels) {
+	struct 	level_res* r;	// results of a level
+	int 	l, k;			// level, task
+
+	printf("-----------------------------------------------\n");
+	printf("STRESS SUMMARY (dmiss and p99 resp in us of driver/drone/ball):\n");
+	printf("\t%5s %20s %26s %7s %7s\n", "level", "dmiss", "p99 resp",
+		"throws", "caught");
+	for(l = 0; l <= levels; l++) {
+		r = &res[l];
+		printf("\t%5d", l);
+		for(k = 0; k < STR_NTASK; k++)
+			printf(" %6ld", r->dmiss[k]);
+		for(k = 0; k < STR_NTASK; k++)
+			printf(" %8ld", quantile(r->hist[k], r->njob[k], 0.99,
+				r->resp_max[k]));
+		printf(" %7ld %6.1f%%\n", r->thrown,
+			r->thrown ? 100.0 * r->caught / r->thrown : 0);
+	}
+	printf("-----------------------------------------------\n");
+}
+
+//--------------------------------
+// MAIN
+//--------------------------------
+
+// ---
+// Print command line usage
+// char* name: program name
+// return: void
+// ---
+static void usage(char* name) {
+	printf("usage: %s [-l levels] [-d sec] [load] file.scn\n"
+		"\t%s -L level [-d sec] [load]\n"
+		"load: [-c hogs] [-p prio] [-b busy%%] [-m thrashers] [-k kB] "
+		"[-y storms] [-u port] [-r packets/s]\n", name, name);
+}
+
+int main(int argc, char** argv) {
+	struct 	stress_cfg cfg = {1, STR_HOG_PRIO, STR_HOG_BUSY, 1,
+		STR_MEM_KB << 10, 1, 0, STR_RATE};	// interference of a level
+	int 	levels = STR_LEVEL;		// last level swept
+	int 	only = -1;				// level of load only, -1 to sweep
+	int 	sec = STR_TIME;			// duration of a level (s)
+	struct 	scn* v;					// scenarios
+	uint64_t t0;					// start of a level (ns)
+	uint32_t n, k;					// scenarios, scenario
+	int 	l, opt;					// level, option
+
+	// -l: levels swept, -L: load only at a level, -d: duration of a level,
+	// per level: -c: cpu hogs (-p prio, -b busy %), -m: thrashers (-k kB),
+	// -y: syscall storms, -u: udp port flooded (-r packets/s)
+	while((opt = getopt(argc, argv, "l:L:d:c:p:b:m:k:y:u:r:")) != -1) {
+		switch(opt) {
+			case 'l':
+				levels = atoi(optarg);
+				break;
+			case 'L':
+				only = atoi(optarg);
+				break;
+			case 'd':
+				sec = atoi(optarg);
+				break;
+			case 'c':
+				cfg.hog = atoi(optarg);
+				break;
+			case 'p':
+				cfg.hog_prio = atoi(optarg);
+				break;
+			case 'b':
+				cfg.hog_busy = atoi(optarg);
+				break;
+			case 'm':
+				cfg.mem = atoi(optarg);
+				break;
+			case 'k':
+				cfg.mem_len = (size_t)atol(optarg) << 10;
+				break;
+			case 'y':
+				cfg.sys = atoi(optarg);
+				break;
+			case 'u':
+				cfg.port = atoi(optarg);
+				break;
+			case 'r':
+				cfg.rate = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if((only < 0 && optind != argc - 1) || levels < 0 ||
+			levels > STR_MAXLEVEL || cfg.hog_busy < 0 ||
+			cfg.hog_busy > 100 || cfg.mem_len < STR_LINE) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// companion of main: load only, sec 0 until killed
+	if(only >= 0) {
+		cur = &res[0];
+		print_load(&cfg, only);
+		t0 = now_ns();
+		load_start(&cfg, only);
+		if(sec > 0)
+			sleep(sec);
+		else
+			pause();
+		load_stop((now_ns() - t0) / 1E9, cur->work);
+		print_work(cur);
+		return 0;
+	}
+
+	if((v = scn_load(argv[optind], &n)) == NULL)
+		return 1;
+
+	// disturbances are applied by sim_step only: throws with some are left
+	// out, so the outcome expected holds for the others
+	for(k = 0; k < n; k++)
+		if(v[k].ndist == 0)
+			v[run.n++] = v[k];
+	if(run.n == 0) {
+		fprintf(stderr, "%s: no throw without disturbances\n", argv[optind]);
+		return 1;
+	}
+	run.sc = v;
+	mutex_prof(1, 0);
+	mutex_init(&run.mtx);
+	mutex_name(&run.mtx, "task set states");
+
+	for(l = 0; l <= levels; l++) {
+		cur = &res[l];
+		print_load(&cfg, l);
+		fflush(stdout);
+		t0 = now_ns();
+		load_start(&cfg, l);
+		run_tasks(sec);
+		load_stop((now_ns() - t0) / 1E9, cur->work);
+		print_level(cur);
+	}
+	print_summary(levels);
+	mutex_handle();
+	return 0;
+}
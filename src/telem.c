@@ -0,0 +1,103 @@
+#include "telem.h"
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------
+// PUBLIC: CREATION
+//------------------------------------------
+
+// ---
+// Init telemetry at mem (allocated if NULL), mem is sizeof(struct telem).
+// Telemetry holds no pointer, so mem can be shared among processes.
+// void* mem: pointer to memory (cache line aligned) or NULL
+// return: telem* - pointer to telemetry, NULL in case of error
+// ---
+struct telem* telem_create(void* mem) {
+	struct 	telem* t;	// new telemetry
+
+	if(mem == NULL)
+		mem = aligned_alloc(TELEM_LINE, sizeof(struct telem));
+	if(mem == NULL)
+		return NULL;
+
+	t = mem;
+	memset(t, 0, sizeof(struct telem));
+	return t;
+}
+
+// ---
+// Create signal id with name and range [lo, hi] shown on charts
+// telem* t: pointer to telemetry
+// int id: signal identifier [0-TELEM_MAXSIG]
+// char* name: name of signal
+// float lo: lowest value shown
+// float hi: highest value shown
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int telem_signal(struct telem* t, int id, const char* name, float lo, float hi) {
+	if(id < 0 || id >= TELEM_MAXSIG || hi <= lo)
+		return -1;
+
+	strncpy(t->sig[id].name, name, TELEM_NAMELEN - 1);
+	t->sig[id].lo = lo;
+	t->sig[id].hi = hi;
+	atomic_init(&t->sig[id].head, 0);
+	if(id >= t->nsig)
+		t->nsig = id + 1;
+	return 0;
+}
+
+//------------------------------------------
+// PUBLIC: WRITER
+//------------------------------------------
+
+// ---
+// Append sample v to signal id
+// telem* t: pointer to telemetry
+// int id: signal identifier
+// float v: sample value
+// return: void
+// ---
+void telem_put(struct telem* t, int id, float v) {
+	struct 	telem_sig* s = &t->sig[id];
+	uint64_t head;	// number of samples written
+
+	head = atomic_load_explicit(&s->head, memory_order_relaxed);
+	s->v[head & (TELEM_CAP - 1)] = v;
+	atomic_store_explicit(&s->head, head + 1, memory_order_release);
+}
+
+//------------------------------------------
+// PUBLIC: READER
+//------------------------------------------
+
+// ---
+// Copy in v the sample at *pos and advance it, return 0 if no new sample.
+// A reader left behind by TELEM_CAP samples skips the lost ones.
+// telem* t: pointer to telemetry
+// int id: signal identifier
+// uint64_t* pos: pointer to position of reader (0 at first call)
+// float* v: pointer to memory that receives the sample
+// return: int - 1 if a sample has been copied, 0 otherwise
+// ---
+int telem_get(struct telem* t, int id, uint64_t* pos, float* v) {
+	struct 	telem_sig* s = &t->sig[id];
+	uint64_t head;	// number of samples written
+
+	// retry only if the writer lapped the reader during the copy
+	do {
+		head = atomic_load_explicit(&s->head, memory_order_acquire);
+		if(*pos >= head)
+			return 0;
+		// slot of sample head - TELEM_CAP may be under write
+		if(head - *pos >= TELEM_CAP)
+			*pos = head - TELEM_CAP + 1;
+
+		*v = s->v[*pos & (TELEM_CAP - 1)];
+		atomic_thread_fence(memory_order_acquire);
+		head = atomic_load_explicit(&s->head, memory_order_relaxed);
+	} while(head - *pos >= TELEM_CAP);
+
+	(*pos)++;
+	return 1;
+}
@@ -0,0 +1,52 @@
+//-----------------------------------------------------------------------------
+// TELEM_H: PER-SIGNAL TELEMETRY RINGS, ONE WRITER AND ANY READER, LOCK-FREE
+//-----------------------------------------------------------------------------
+
+#ifndef TELEM_H
+#define TELEM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define TELEM_CAP		512		// samples kept by each signal (power of 2)
+#define TELEM_MAXSIG	16		// max number of signals
+#define TELEM_NAMELEN	12		// max length of a signal name
+#define TELEM_LINE		64		// cache line size (byte)
+
+struct telem_sig {						// ring of one signal
+	char 	name[TELEM_NAMELEN];		// name shown on charts
+	float 	lo, hi;						// range shown on charts
+	_Alignas(TELEM_LINE) _Atomic uint64_t head;	// samples written so far
+	float 	v[TELEM_CAP];				// samples
+};
+
+struct telem {							// set of signals (no pointers)
+	int 	nsig;						// number of signals created
+	struct 	telem_sig sig[TELEM_MAXSIG];
+};
+
+//------------------------------------------
+// PUBLIC: CREATION
+//------------------------------------------
+
+// Init telemetry at mem (allocated if NULL), mem is sizeof(struct telem)
+struct telem* telem_create(void* mem);
+
+// Create signal id with name and range [lo, hi] shown on charts
+int telem_signal(struct telem* t, int id, const char* name, float lo, float hi);
+
+//------------------------------------------
+// PUBLIC: WRITER (only one thread for each signal, never blocks)
+//------------------------------------------
+
+// Append sample v to signal id
+void telem_put(struct telem* t, int id, float v);
+
+//------------------------------------------
+// PUBLIC: READER (each reader keeps its own position)
+//------------------------------------------
+
+// Copy in v the sample at *pos and advance it, return 0 if no new sample
+int telem_get(struct telem* t, int id, uint64_t* pos, float* v);
+
+#endif
@@ -0,0 +1,308 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "ptask.h"
+#include "spsc.h"
+
+struct trace_buf {					// ring of a thread
+	struct 	spsc* q;				// events, pushed by its thread only
+	char 	name[TRACE_NAMELEN];	// thread name
+	_Atomic int live;				// 1 while its thread runs
+	long 	drop;					// events lost with ring full
+};
+
+static struct trace_buf buf[TRACE_MAXTHREAD];	// rings of threads
+static _Atomic int nbuf;			// rings in use
+static _Atomic int on;				// 1 while tracing
+static _Atomic int stopping;		// 1 when writer has to end
+static pthread_mutex_t reg = PTHREAD_MUTEX_INITIALIZER;	// ring registration
+static pthread_key_t key;			// ring, marked at thread end
+static pthread_t writer;			// writer of file
+static FILE* 	out;				// trace file
+static const char* out_name;		// path of trace file
+static uint64_t t_start;			// start of tracing (ns)
+static long 	written;			// events written
+static _Thread_local struct trace_buf* self;	// ring of calling thread
+
+//------------------------------------------
+// PRIVATE: RINGS
+//------------------------------------------
+
+// ---
+// Mark the ring of an ending thread, so a new one can go on with it
+// void* arg: pointer to ring
+// return: void
+// ---
+static void thread_end(void* arg) {
+	struct 	trace_buf* b = arg;	// ring of ending thread
+
+	atomic_store(&b->live, 0);
+}
+
+// ---
+// Take a ring for the calling thread: the one of an ended thread with same
+// name if name is given and there is one, a new one otherwise
+// char* name: thread name, or NULL
+// return: trace_buf* - ring of calling thread, NULL if none is left
+// ---
+static struct trace_buf* attach(const char* name) {
+	struct 	trace_buf* b = NULL;	// ring taken
+	int 	k, n;					// ring, rings in use
+
+	pthread_mutex_lock(&reg);
+	n = atomic_load(&nbuf);
+	for(k = 0; name != NULL && k < n; k++)
+		if(!atomic_load(&buf[k].live) && !strcmp(buf[k].name, name)) {
+			b = &buf[k];
+			break;
+		}
+	if(b == NULL && n < TRACE_MAXTHREAD) {
+		b = &buf[n];
+		b->q = spsc_create(NULL, TRACE_RING, sizeof(struct trace_event));
+		snprintf(b->name, TRACE_NAMELEN, "thread %d", n);
+		if(b->q != NULL)
+			atomic_store(&nbuf, n + 1);
+		else
+			b = NULL;
+	}
+	if(b != NULL) {
+		atomic_store(&b->live, 1);
+		pthread_setspecific(key, b);
+	}
+	pthread_mutex_unlock(&reg);
+	self = b;
+	return b;
+}
+
+// ---
+// Push an event in the ring of calling thread
+// trace_event* e: pointer to event
+// return: void
+// ---
+static void emit(const struct trace_event* e) {
+	struct 	trace_buf* b = self;	// ring of calling thread
+
+	if(b == NULL)
+		b = attach(NULL);
+	if(b != NULL && spsc_push(b->q, e))
+		b->drop++;
+}
+
+//------------------------------------------
+// PRIVATE: WRITER OF FILE
+//------------------------------------------
+
+// ---
+// Write an event of thread tid in trace event format
+// int tid: thread (ring index)
+// trace_event* e: pointer to event
+// return: void
+// ---
+static void write_event(int tid, const struct trace_event* e) {
+	fprintf(out, "%s{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\","
+		"\"pid\":%d,\"tid\":%d,\"ts\":%.3f", written ? ",\n" : "",
+		e->dur ? 'X' : 'i', e->cat, e->name, getpid(), tid,
+		(e->ts - t_start) / 1E3);
+	if(e->dur)
+		fprintf(out, ",\"dur\":%.3f", e->dur / 1E3);
+	else
+		fprintf(out, ",\"s\":\"t\"");
+	if(e->arg != NULL)
+		fprintf(out, ",\"args\":{\"%s\":%lld}", e->arg, (long long)e->val);
+	fprintf(out, "}");
+	written++;
+}
+
+// ---
+// Move the events of every ring to file
+// return: void
+// ---
+static void drain() {
+	struct 	trace_event e;	// event
+	int 	k;				// ring
+
+	for(k = 0; k < atomic_load(&nbuf); k++)
+		while(spsc_pop(buf[k].q, &e) == 0)
+			write_event(k, &e);
+}
+
+// ---
+// Writer: drain rings every TRACE_FLUSH ms until tracing stops
+// void* arg: not used
+// return: void
+// ---
+static void* writer_task(void* arg) {
+	while(!atomic_load(&stopping)) {
+		drain();
+		usleep(TRACE_FLUSH * 1000);
+	}
+	return NULL;
+}
+
+// ---
+// Measure the cost of an event on a ring of its own
+// return: double - cost of an event (ns)
+// ---
+static double calibrate() {
+	struct 	trace_buf cal = {0};	// ring of calibration
+	struct 	trace_buf* b = self;	// ring of calling thread
+	uint64_t t0;					// start (ns)
+	int 	k;						// event
+
+	cal.q = spsc_create(NULL, TRACE_RING, sizeof(struct trace_event));
+	if(cal.q == NULL)
+		return 0;
+	self = &cal;
+	t0 = trace_now();
+	for(k = 0; k < TRACE_RING - 1; k++)
+		trace_span("trace", "calibration", t0, "k", k);
+	t0 = trace_now() - t0;
+	self = b;
+	sem_destroy(&cal.q->items);
+	free(cal.q);
+	return (double)t0 / (TRACE_RING - 1);
+}
+
+//------------------------------------------
+// PUBLIC: START AND STOP
+//------------------------------------------
+
+// ---
+// Start tracing in file, the writer runs in background
+// char* file: path of trace file
+// return: int - 0 in case of success, -1 otherwise
+// ---
+int trace_start(const char* file) {
+	out = fopen(file, "w");
+	if(out == NULL)
+		return -1;
+	out_name = file;
+	pthread_key_create(&key, thread_end);
+	fprintf(out, "{\"traceEvents\":[\n");
+	t_start = trace_now();
+	atomic_store(&on, 1);
+	bg_task_create(&writer, writer_task, NULL);
+	return 0;
+}
+
+// ---
+// Stop tracing: write the events left and the names of threads, close file
+// and print what was traced
+// return: void
+// ---
+void trace_stop() {
+	double 	cost;		// cost of an event (ns)
+	long 	drop = 0;	// events dropped
+	int 	k;			// ring
+
+	if(!atomic_load(&on))
+		return;
+	cost = calibrate();
+	atomic_store(&on, 0);
+	atomic_store(&stopping, 1);
+	pthread_join(writer, NULL);
+	drain();
+
+	for(k = 0; k < atomic_load(&nbuf); k++) {
+		fprintf(out, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+			"\"tid\":%d,\"args\":{\"name\":\"%s\"}}", written ? ",\n" : "",
+			getpid(), k, buf[k].name);
+		written++;
+		drop += buf[k].drop;
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(out);
+
+	printf("-----------------------------------------------\n");
+	printf("TRACE (%s):\n", out_name);
+	printf("\tevents: %ld - dropped: %ld - threads: %d\n",
+		written - atomic_load(&nbuf), drop, atomic_load(&nbuf));
+	printf("\tcost of an event: %.0f ns\n", cost);
+	printf("-----------------------------------------------\n");
+}
+
+//------------------------------------------
+// PUBLIC: EVENTS
+//------------------------------------------
+
+// ---
+// Name the calling thread in the trace. Tasks are created again at each
+// start: a thread goes on with the ring of an ended thread of same name
+// char* name: thread name
+// return: void
+// ---
+void trace_thread(const char* name) {
+	struct 	trace_buf* b = self;	// ring of calling thread
+
+	if(!atomic_load_explicit(&on, memory_order_relaxed))
+		return;
+	if(b == NULL)
+		b = attach(name);
+	if(b != NULL)
+		snprintf(b->name, TRACE_NAMELEN, "%s", name);
+}
+
+// ---
+// Return time of monotonic clock
+// return: uint64_t - ns elapsed from an unspecified point
+// ---
+uint64_t trace_now() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+// ---
+// Add a span of calling thread from t0 to now
+// char* cat: category
+// char* name: name of span
+// uint64_t t0: start of span, from trace_now
+// char* arg: name of argument, NULL if none
+// int64_t val: value of argument
+// return: void
+// ---
+void trace_span(const char* cat, const char* name, uint64_t t0,
+		const char* arg, int64_t val) {
+	struct 	trace_event e;	// event
+
+	if(!atomic_load_explicit(&on, memory_order_relaxed))
+		return;
+	e.ts = t0;
+	e.dur = trace_now() - t0;
+	if(e.dur == 0)
+		e.dur = 1;
+	e.cat = cat;
+	e.name = name;
+	e.arg = arg;
+	e.val = val;
+	emit(&e);
+}
+
+// ---
+// Add an instant event of calling thread
+// char* cat: category
+// char* name: name of event
+// char* arg: name of argument, NULL if none
+// int64_t val: value of argument
+// return: void
+// ---
+void trace_mark(const char* cat, const char* name, const char* arg,
+		int64_t val) {
+	struct 	trace_event e;	// event
+
+	if(!atomic_load_explicit(&on, memory_order_relaxed))
+		return;
+	e.ts = trace_now();
+	e.dur = 0;
+	e.cat = cat;
+	e.name = name;
+	e.arg = arg;
+	e.val = val;
+	emit(&e);
+}
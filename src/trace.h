@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// TRACE_H: TIMELINE OF TASK EVENTS IN CHROME TRACE EVENT FORMAT (PERFETTO)
+//-----------------------------------------------------------------------------
+// Each thread pushes its events in a lock-free ring of its own, a background
+// thread drains the rings into a JSON file that chrome://tracing and
+// ui.perfetto.dev open. With tracing off an event costs a test.
+//-----------------------------------------------------------------------------
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_RING		8192	// events of a thread ring (power of 2)
+#define TRACE_MAXTHREAD	32		// max threads traced
+#define TRACE_NAMELEN	24		// max length of a thread name
+#define TRACE_FLUSH		20		// period of writer of file (ms)
+
+struct trace_event {			// event of a thread
+	uint64_t ts;				// start (ns, monotonic clock)
+	uint64_t dur;				// duration (ns), 0 for an instant event
+	const char* cat;			// category (static string)
+	const char* name;			// name (static string)
+	const char* arg;			// name of argument (static string), or NULL
+	int64_t val;				// value of argument
+};
+
+//------------------------------------------
+// PUBLIC: START AND STOP
+//------------------------------------------
+
+// Start tracing in file, return 0 in case of success, -1 otherwise
+int trace_start(const char* file);
+
+// Stop tracing, drain rings, close file and print what was traced
+void trace_stop();
+
+//------------------------------------------
+// PUBLIC: EVENTS (any thread, on its own ring)
+//------------------------------------------
+
+// Name the calling thread, it goes on with the ring of an ended thread so named
+void trace_thread(const char* name);
+
+// Return time of monotonic clock (ns), start of a span
+uint64_t trace_now();
+
+// Add a span of calling thread from t0 (trace_now) to now
+void trace_span(const char* cat, const char* name, uint64_t t0,
+	const char* arg, int64_t val);
+
+// Add an instant event of calling thread
+void trace_mark(const char* cat, const char* name, const char* arg,
+	int64_t val);
+
+#endif
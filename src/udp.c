@@ -1,7 +1,13 @@
 #include "udp.h"
 #include <string.h>
+#include <time.h>
+#include <math.h>
 #include <arpa/inet.h>
 
+#define UDP_MAXSOCK 1024    // max socket descriptor with its own seq
+
+static uint32_t udp_seq[UDP_MAXSOCK];   // next graphic packet seq of each sock
+
 //--------------------------------
 // PRIVATE: UDP MANAGMENT FUNCTIONS
 //--------------------------------
@@ -34,6 +40,17 @@ static int udp_connect(int sock, char* ip_address, unsigned short udp_port) {
     return connect(sock, (struct sockaddr*)&recipient, sizeof(recipient)); 
 }
 
+// ---
+// Return the next sequence number of packets sent on sock
+// int sock: socket descriptor identifier
+// return: uint32_t - sequence number (0 if sock is out of table)
+// ---
+static uint32_t udp_next_seq(int sock) {
+    if(sock < 0 || sock >= UDP_MAXSOCK)
+        return 0;
+    return udp_seq[sock]++;
+}
+
 // ---
 // Send buffer to a connected sock, return the num of byte sent or -1 otherwise
 // int sock: socket descriptor identifier
@@ -69,6 +86,34 @@ int udp_init(char* ip_address, unsigned short udp_port) {
     return sock;
 }
 
+// ---
+// Create an UDP sock bound on port provided, with rcv buffer of buf_len byte
+// unsigned short udp_port: port number on which packet are received
+// int buf_len: kernel receive buffer size in byte (0 to keep default)
+// return: int - socket descriptor in case of success, -1 otherwise
+// ---
+int udp_bind(unsigned short udp_port, int buf_len) {
+    struct  sockaddr_in local;
+    int     sock = udp_socket();
+
+    if(sock < 0)
+        return -1;
+
+    // a big buffer absorbs bursts while the receiver is not scheduled
+    if(buf_len > 0)
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buf_len, sizeof(buf_len));
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(udp_port);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if(bind(sock, (struct sockaddr*)&local, sizeof(local)))
+        return -1;
+
+    return sock;
+}
+
 // ---
 // Send graphic data to connected UDP sock, return the num of byte sent or -1
 // int sock: socket descriptor identifier
@@ -78,20 +123,120 @@ int udp_init(char* ip_address, unsigned short udp_port) {
 // return: int - num of byte sent in case of success, -1 otherwise
 // ---
 int udp_grap_send(int sock, float* d_lin_pos, float* d_ang_pos, float* b_pos) {
-    struct udp_graph_data {
-	    float   d_lin_pos[SP_DIM]; 	// drone linear position
-	    float   d_ang_pos[SP_DIM]; 	// drone angular position
-	    float   b_pos[SP_DIM]; 		// ball linear position
-    }; 
-    
-    int     i;                      // array index [0-SP_DIM]
     struct  udp_graph_data data;    // data to be sended
     
+    udp_grap_pack(&data, sock, d_lin_pos, d_ang_pos, b_pos);
+	return udp_send(sock, &data, sizeof(struct udp_graph_data));	
+}
+
+// ---
+// Fill graphic packet of sock with positions, next seq and stamp
+// udp_graph_data* data: pointer to packet, filled
+// int sock: socket descriptor identifier (its seq is consumed)
+// float* d_lin_pos: pointer to Vector[3] that contains drone lin position
+// float* d_ang_pos: pointer to Vector[3] that contains drone ang position
+// float* b_pos: pointer to Vector[3] that contains ball lin position
+// return: void
+// ---
+void udp_grap_pack(struct udp_graph_data* data, int sock, float* d_lin_pos,
+        float* d_ang_pos, float* b_pos) {
+    int     i;                      // array index [0-SP_DIM]
+
+    for(i = 0; i < SP_DIM; i++) {
+        data->d_lin_pos[i] = d_lin_pos[i];
+        data->d_ang_pos[i] = d_ang_pos[i];
+        data->b_pos[i] = b_pos[i];
+    }
+
+    // seq and stamp are appended, so old receivers read only the positions
+    data->seq = udp_next_seq(sock);
+    data->stamp = udp_stamp();
+}
+
+//--------------------------------
+// PUBLIC: UDP MODEL STREAMING
+//--------------------------------
+
+// ---
+// Send drone pose to connected UDP sock, return the num of byte sent or -1
+// int sock: socket descriptor identifier
+// float* d_lin_pos: pointer to Vector[3] that contains drone lin position
+// float* d_ang_pos: pointer to Vector[3] that contains drone ang position
+// return: int - num of byte sent in case of success, -1 otherwise
+// ---
+int udp_drone_send(int sock, float* d_lin_pos, float* d_ang_pos) {
+    int     i;                      // array index [0-SP_DIM]
+    struct  udp_drone_data data;    // data to be sended
+
     for(i = 0; i < SP_DIM; i++) {
         data.d_lin_pos[i] = d_lin_pos[i];
         data.d_ang_pos[i] = d_ang_pos[i];
-        data.b_pos[i] = b_pos[i];
     }
 
-	return udp_send(sock, &data, sizeof(struct udp_graph_data));	
+    data.type = UDP_MSG_DRONE;
+    data.seq = udp_next_seq(sock);
+    data.stamp = udp_stamp();
+
+    return udp_send(sock, &data, sizeof(struct udp_drone_data));
+}
+
+// ---
+// Send ball model to connected UDP sock, return the num of byte sent or -1
+// int sock: socket descriptor identifier
+// udp_ball_model* model: pointer to model (type, seq and stamp are filled)
+// return: int - num of byte sent in case of success, -1 otherwise
+// ---
+int udp_ball_send(int sock, struct udp_ball_model* model) {
+    model->type = UDP_MSG_BALL;
+    model->seq = udp_next_seq(sock);
+    model->stamp = udp_stamp();
+
+    return udp_send(sock, model, sizeof(struct udp_ball_model));
+}
+
+// ---
+// Evaluate ball model at time t (us, sender clock), leave position in b_pos.
+// The sender integrates v += -acc * step, p += v * step: the curve below
+// passes exactly through each integration step, and it is smooth between.
+// udp_ball_model* model: pointer to received model
+// uint64_t t: time at which the ball position is wanted (us)
+// float* b_pos: pointer to Vector[3] in which result is leaved
+// return: void
+// ---
+void udp_ball_eval(struct udp_ball_model* model, uint64_t t, float* b_pos) {
+    int     i;          // array index [0-SP_DIM]
+    float   dt;         // time elapsed from t0 (s)
+    float   a, b, c;    // coefficient of z(dt) - floor = a dt^2 + b dt + c
+
+    dt = t > model->t0 ? (t - model->t0) / 1e6 : 0;
+    a = - model->acc / 2;
+    b = model->b_vel[SP_DIM-1] - model->acc * model->step / 2;
+    c = model->b_pos[SP_DIM-1] - model->floor;
+
+    // once on the floor the ball does not move anymore
+    if(c <= 0) {
+        dt = 0;
+    } else if(a * dt * dt + b * dt + c < 0) {
+        if(a < 0)
+            dt = (- b - sqrtf(b * b - 4 * a * c)) / (2 * a);
+        else
+            dt = - c / b;
+    }
+
+    for(i = 0; i < SP_DIM-1; i++)
+        b_pos[i] = model->b_pos[i] + model->b_vel[i] * dt;
+    b_pos[SP_DIM-1] = model->b_pos[SP_DIM-1] + (a * dt + b) * dt;
+    if(b_pos[SP_DIM-1] < model->floor)
+        b_pos[SP_DIM-1] = model->floor;
+}
+
+// ---
+// Return the current time of the monotonic clock in microseconds
+// return: uint64_t - microseconds elapsed from an unspecified point
+// ---
+uint64_t udp_stamp() {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
 }
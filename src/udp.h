@@ -5,8 +5,50 @@
 #ifndef UDP_H
 #define UDP_H
 
+#include <stdint.h>
+
 #define SP_DIM 3	// Dimension of space in which we work
 
+//--------------------------------
+// UDP GRAPHIC PACKET LAYOUT
+//--------------------------------
+#define UDP_LEGACY_LEN	36	// length of packet without seq and stamp (byte)
+
+struct udp_graph_data {
+    float       d_lin_pos[SP_DIM];  // drone linear position
+    float       d_ang_pos[SP_DIM];  // drone angular position
+    float       b_pos[SP_DIM];      // ball linear position
+    uint32_t    seq;                // sequence number of the packet
+    uint64_t    stamp;              // send time (us, sender monotonic clock)
+};
+
+//--------------------------------
+// UDP MODEL STREAMING PACKET LAYOUT
+//--------------------------------
+#define UDP_MSG_DRONE   1   // drone pose, ball is streamed as a model
+#define UDP_MSG_BALL    2   // ball trajectory model
+
+struct udp_drone_data {             // sent every tick in model mode
+    uint32_t    type;               // UDP_MSG_DRONE
+    uint32_t    seq;                // sequence number of the packet
+    uint64_t    stamp;              // send time (us, sender monotonic clock)
+    float       d_lin_pos[SP_DIM];  // drone linear position
+    float       d_ang_pos[SP_DIM];  // drone angular position
+};
+
+struct udp_ball_model {             // sent at every ball discontinuity
+    uint32_t    type;               // UDP_MSG_BALL
+    uint32_t    seq;                // sequence number of the packet
+    uint64_t    stamp;              // send time (us, sender monotonic clock)
+    uint64_t    t0;                 // time at which pos and vel hold (us)
+    float       b_pos[SP_DIM];      // ball position at t0 (m)
+    float       b_vel[SP_DIM];      // ball velocity at t0 (m/s)
+    float       acc;                // downward acceleration (m/s^2)
+    float       step;               // integration step of the sender (s)
+    float       floor;              // height at which the ball stops (m)
+    uint32_t    epoch;              // number of discontinuities so far
+};
+
 //--------------------------------
 // PUBLIC: UDP INIT AND SEND
 //--------------------------------
@@ -14,9 +56,30 @@
 // Create an UDP sock and connect to client/server with ip and port provided
 int udp_init(char* ip_address, unsigned short udp_port);
 
+// Create an UDP sock bound on port provided, with rcv buffer of buf_len byte
+int udp_bind(unsigned short udp_port, int buf_len);
+
 // Send graphic data to connected UDP sock, return the num of byte sent or -1
 int udp_grap_send(int sock, float* d_lin_pos, float* d_ang_pos, float* b_pos);
 
-#endif
+// Fill graphic packet of sock with positions, next seq and stamp
+void udp_grap_pack(struct udp_graph_data* data, int sock, float* d_lin_pos,
+	float* d_ang_pos, float* b_pos);
+
+//--------------------------------
+// PUBLIC: UDP MODEL STREAMING
+//--------------------------------
 
+// Send drone pose to connected UDP sock, return the num of byte sent or -1
+int udp_drone_send(int sock, float* d_lin_pos, float* d_ang_pos);
 
+// Send ball model to connected UDP sock, return the num of byte sent or -1
+int udp_ball_send(int sock, struct udp_ball_model* model);
+
+// Evaluate ball model at time t (us, sender clock), leave position in b_pos
+void udp_ball_eval(struct udp_ball_model* model, uint64_t t, float* b_pos);
+
+// Return the current time of the monotonic clock in microseconds
+uint64_t udp_stamp();
+
+#endif
@@ -0,0 +1,618 @@
+//-----------------------------------------------------
+//
+// UDPSINK: VISUALIZER STAND-IN FOR NETWORK MEASUREMENTS
+//
+//-----------------------------------------------------
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "udp.h"
+
+//-----------------------------------------------------
+// SINK CONSTANTS
+//-----------------------------------------------------
+#define UDP_PORT 	8000		// port on which simulation sends packets
+#define FWD_IP		"127.0.0.1"	// default forward address
+#define RCVBUF		(8 << 20)	// kernel receive buffer (byte)
+#define VLEN		64			// datagrams read/sent with a single syscall
+#define MAXPKT		256			// max forwarded datagram length (byte)
+#define QLEN		65536		// max datagrams held by the delay line
+#define MAXFLOW		64			// max number of distinct senders tracked
+#define REPORT_MS	1000		// default report interval (ms)
+#define JITTER_GAIN	16			// jitter estimator gain (RFC 3550)
+
+//-----------------------------------------------------
+// SINK DATA STRUCTURES
+//-----------------------------------------------------
+struct impair {					// impairment parameters
+	int 	delay;				// fixed one way delay (us)
+	int 	jitter;				// uniform random delay added (us)
+	double 	loss;				// drop probability [0, 1]
+	double	reorder;			// probability of holding a datagram back
+	int 	gap;				// extra delay of a held back datagram (us)
+	unsigned int seed;			// seed of the random generator
+};
+
+struct flow {					// statistics of one sender
+	struct sockaddr_in addr;	// sender address
+	int 	used;				// slot in use
+	long 	recv, bytes;		// datagrams and bytes received
+	long 	legacy;				// datagrams without seq and stamp
+	long	reord, dup;			// late and duplicated datagrams
+	int64_t first, high;		// first and highest unwrapped seq
+	int64_t last_transit;		// previous arrival - send time (us)
+	double 	jitter;				// inter-arrival jitter estimate (us)
+	int64_t	last_arr;			// previous arrival time (us)
+	int64_t	iat_max;			// max inter-arrival time (us)
+	long	iv_recv, iv_bytes;	// datagrams and bytes in current interval
+	long	models;				// ball models received
+	struct 	udp_graph_data last;// last decoded positions, seq and stamp
+	struct 	udp_ball_model model;// last ball model received
+};
+
+struct held {					// datagram waiting in the delay line
+	uint64_t release;			// time at which it is forwarded (us)
+	int 	len;				// length of datagram
+	char 	buf[MAXPKT];		// datagram payload
+};
+
+struct dline {					// delay line ordered by release time
+	struct held* pool;			// datagram storage
+	int* 	heap;				// min-heap of pool index on release time
+	int* 	free;				// stack of free pool index
+	int 	n_heap, n_free;		// number of element in heap and stack
+	long 	overflow;			// datagrams dropped because line was full
+	long 	unsent;				// datagrams the forward socket failed to send
+};
+
+static volatile sig_atomic_t stop = 0;	// set by SIGINT/SIGTERM
+static uint32_t kdrop = 0;				// datagrams dropped by sink socket
+
+//--------------------------------
+// PRIVATE: UTILITY FUNCTIONS
+//--------------------------------
+
+// ---
+// Signal handler: ask the main loop to terminate
+// int sig: signal number
+// return: void
+// ---
+static void on_signal(int sig) {
+	stop = 1;
+}
+
+// ---
+// Return a random number uniformly distributed in [0, 1)
+// unsigned int* seed: pointer to state of the generator
+// return: double - random number
+// ---
+static double rnd(unsigned int* seed) {
+	return rand_r(seed) / ((double)RAND_MAX + 1);
+}
+
+// ---
+// Extend a 32 bit seq to 64 bit using the closest value to ref
+// uint32_t seq: sequence number read from datagram
+// int64_t ref: highest unwrapped sequence number seen
+// return: int64_t - unwrapped sequence number
+// ---
+static int64_t unwrap(uint32_t seq, int64_t ref) {
+	return ref + (int32_t)(seq - (uint32_t)ref);
+}
+
+//--------------------------------
+// PRIVATE: FLOW STATISTICS
+//--------------------------------
+
+// ---
+// Find (or create) the flow of sender addr
+// flow* tab: pointer to Vector[MAXFLOW] of flows
+// sockaddr_in* addr: address of sender
+// return: flow* - pointer to flow, NULL if table is full
+// ---
+static struct flow* flow_get(struct flow* tab, struct sockaddr_in* addr) {
+	int 	i, h;	// probe index and hash
+
+	h = (addr->sin_addr.s_addr ^ addr->sin_port) % MAXFLOW;
+	for(i = 0; i < MAXFLOW; i++, h = (h + 1) % MAXFLOW) {
+		if(!tab[h].used) {
+			memset(&tab[h], 0, sizeof(struct flow));
+			tab[h].used = 1;
+			tab[h].addr = *addr;
+			return &tab[h];
+		}
+		if(tab[h].addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+				tab[h].addr.sin_port == addr->sin_port)
+			return &tab[h];
+	}
+	return NULL;
+}
+
+// ---
+// Decode a datagram in the positions of the flow, ball model is evaluated
+// flow* f: pointer to flow of the sender
+// char* buf: datagram payload
+// int len: datagram length
+// return: int - 1 if datagram carries seq and stamp, 0 otherwise
+// ---
+static int flow_decode(struct flow* f, char* buf, int len) {
+	struct 	udp_drone_data dd;	// decoded drone datagram
+	uint32_t type;				// type of model streaming datagram
+
+	memcpy(&type, buf, len < sizeof(type) ? len : sizeof(type));
+
+	if(len == sizeof(struct udp_drone_data) && type == UDP_MSG_DRONE) {
+		memcpy(&dd, buf, len);
+		memcpy(f->last.d_lin_pos, dd.d_lin_pos, sizeof(dd.d_lin_pos));
+		memcpy(f->last.d_ang_pos, dd.d_ang_pos, sizeof(dd.d_ang_pos));
+		f->last.seq = dd.seq;
+		f->last.stamp = dd.stamp;
+	} else if(len == sizeof(struct udp_ball_model) && type == UDP_MSG_BALL) {
+		memcpy(&f->model, buf, len);
+		f->last.seq = f->model.seq;
+		f->last.stamp = f->model.stamp;
+		f->models++;
+	} else if(len >= UDP_LEGACY_LEN) {
+		memcpy(&f->last, buf, len < sizeof(f->last) ? len : sizeof(f->last));
+		// datagrams sent by old simulations carry only positions
+		return len >= sizeof(struct udp_graph_data);
+	} else {
+		return 0;
+	}
+
+	// in model streaming the ball is evaluated at the time of last datagram
+	if(f->models > 0)
+		udp_ball_eval(&f->model, f->last.stamp, f->last.b_pos);
+	return 1;
+}
+
+// ---
+// Account a received datagram in its flow
+// flow* f: pointer to flow of the sender
+// char* buf: datagram payload
+// int len: datagram length
+// int64_t arr: arrival time of datagram (us)
+// return: void
+// ---
+static void flow_account(struct flow* f, char* buf, int len, int64_t arr) {
+	int64_t seq, transit, diff;	// unwrapped seq, transit time, its variation
+
+	f->recv++;
+	f->iv_recv++;
+	f->bytes += len;
+	f->iv_bytes += len;
+	if(f->last_arr && arr - f->last_arr > f->iat_max)
+		f->iat_max = arr - f->last_arr;
+	f->last_arr = arr;
+
+	if(!flow_decode(f, buf, len)) {
+		f->legacy++;
+		return;
+	}
+
+	if(f->recv - f->legacy == 1) {
+		f->first = f->high = f->last.seq;
+	} else {
+		seq = unwrap(f->last.seq, f->high);
+		if(seq > f->high)
+			f->high = seq;
+		else if(seq == f->high)
+			f->dup++;
+		else
+			f->reord++;
+	}
+
+	// jitter is the smoothed variation of transit time (RFC 3550)
+	transit = arr - (int64_t)f->last.stamp;
+	if(f->last_transit) {
+		diff = llabs(transit - f->last_transit);
+		f->jitter += (diff - f->jitter) / JITTER_GAIN;
+	}
+	f->last_transit = transit;
+}
+
+// ---
+// Print statistics of each flow and reset interval counters
+// flow* tab: pointer to Vector[MAXFLOW] of flows
+// dline* dl: pointer to delay line
+// double elapsed: length of the interval (s)
+// return: void
+// ---
+static void flow_report(struct flow* tab, struct dline* dl, double elapsed) {
+	int 	i;				// flow index [0-MAXFLOW]
+	long	expct, lost;	// expected and lost datagrams
+	char	ip[INET_ADDRSTRLEN];
+	struct 	flow* f;
+
+	printf("-----------------------------------------------\n");
+	for(i = 0; i < MAXFLOW; i++) {
+		f = &tab[i];
+		if(!f->used)
+			continue;
+
+		expct = f->high - f->first + 1;
+		lost = expct - (f->recv - f->legacy - f->dup);
+		if(f->recv == f->legacy)
+			expct = lost = 0;
+
+		inet_ntop(AF_INET, &f->addr.sin_addr, ip, sizeof(ip));
+		printf("%s:%d rate %.1f pkt/s %.1f kbit/s recv %ld lost %ld (%.2f%%) "
+			"reord %ld dup %ld jitter %.3f ms max iat %.3f ms\n",
+			ip, ntohs(f->addr.sin_port), f->iv_recv / elapsed,
+			f->iv_bytes * 8 / elapsed / 1000, f->recv, lost,
+			expct ? 100.0 * lost / expct : 0, f->reord, f->dup,
+			f->jitter / 1000, f->iat_max / 1000.0);
+		if(f->models > 0)
+			printf("\tball models %ld, epoch %u\n", f->models, f->model.epoch);
+		printf("\tdrone (%.2f %.2f %.2f) ang (%.2f %.2f %.2f) "
+			"ball (%.2f %.2f %.2f)\n",
+			f->last.d_lin_pos[0], f->last.d_lin_pos[1], f->last.d_lin_pos[2],
+			f->last.d_ang_pos[0], f->last.d_ang_pos[1], f->last.d_ang_pos[2],
+			f->last.b_pos[0], f->last.b_pos[1], f->last.b_pos[2]);
+
+		f->iv_recv = f->iv_bytes = 0;
+		f->iat_max = 0;
+	}
+	printf("sink socket drops: %u\n", kdrop);
+	if(dl->pool)
+		printf("delay line: %d held, %ld overflow, %ld unsent\n", dl->n_heap,
+			dl->overflow, dl->unsent);
+	fflush(stdout);
+}
+
+//--------------------------------
+// PRIVATE: DELAY LINE
+//--------------------------------
+
+// ---
+// Allocate the delay line storage
+// dline* dl: pointer to delay line
+// return: int - 0 in case of success, -1 otherwise
+// ---
+static int dline_init(struct dline* dl) {
+	int 	i;	// pool index [0-QLEN]
+
+	dl->pool = malloc(QLEN * sizeof(struct held));
+	dl->heap = malloc(QLEN * sizeof(int));
+	dl->free = malloc(QLEN * sizeof(int));
+	if(!dl->pool || !dl->heap || !dl->free)
+		return -1;
+
+	for(i = 0; i < QLEN; i++)
+		dl->free[i] = QLEN - 1 - i;
+	dl->n_free = QLEN;
+	dl->n_heap = 0;
+	return 0;
+}
+
+// ---
+// Swap two heap elements
+// dline* dl: pointer to delay line
+// int a, b: heap positions
+// return: void
+// ---
+static void dline_swap(struct dline* dl, int a, int b) {
+	int 	tmp = dl->heap[a];
+
+	dl->heap[a] = dl->heap[b];
+	dl->heap[b] = tmp;
+}
+
+// ---
+// Insert a datagram in the delay line
+// dline* dl: pointer to delay line
+// char* buf: datagram payload
+// int len: datagram length
+// uint64_t release: time at which datagram has to be forwarded (us)
+// return: void
+// ---
+static void dline_push(struct dline* dl, char* buf, int len, uint64_t release) {
+	int 	i, p, slot;	// heap position, its parent, pool index
+
+	if(dl->n_free == 0 || len > MAXPKT) {
+		dl->overflow++;
+		return;
+	}
+
+	slot = dl->free[--dl->n_free];
+	dl->pool[slot].release = release;
+	dl->pool[slot].len = len;
+	memcpy(dl->pool[slot].buf, buf, len);
+
+	// sift up the new element
+	i = dl->n_heap++;
+	dl->heap[i] = slot;
+	while(i > 0) {
+		p = (i - 1) / 2;
+		if(dl->pool[dl->heap[p]].release <= release)
+			break;
+		dline_swap(dl, i, p);
+		i = p;
+	}
+}
+
+// ---
+// Remove the element with the earliest release time
+// dline* dl: pointer to delay line
+// return: int - pool index of removed element
+// ---
+static int dline_pop(struct dline* dl) {
+	int 	i, c, top;	// heap position, child, removed pool index
+
+	top = dl->heap[0];
+	dl->heap[0] = dl->heap[--dl->n_heap];
+
+	// sift down the moved element
+	i = 0;
+	while((c = 2 * i + 1) < dl->n_heap) {
+		if(c + 1 < dl->n_heap &&
+				dl->pool[dl->heap[c+1]].release < dl->pool[dl->heap[c]].release)
+			c++;
+		if(dl->pool[dl->heap[i]].release <= dl->pool[dl->heap[c]].release)
+			break;
+		dline_swap(dl, i, c);
+		i = c;
+	}
+
+	dl->free[dl->n_free++] = top;
+	return top;
+}
+
+// ---
+// Forward every datagram whose release time has passed: a batch partially
+// sent goes on from the first datagram left, those that fail are counted
+// dline* dl: pointer to delay line
+// int sock: connected socket of forward destination
+// uint64_t now: current time (us)
+// return: void
+// ---
+static void dline_flush(struct dline* dl, int sock, uint64_t now) {
+	struct 	mmsghdr msg[VLEN];	// datagrams sent with one syscall
+	struct 	iovec iov[VLEN];	// payload of each datagram
+	int 	n, slot;			// datagrams in batch, pool index
+	int 	sent, ret;			// datagrams of batch sent, result of send
+
+	while(dl->n_heap > 0 && dl->pool[dl->heap[0]].release <= now) {
+		for(n = 0; n < VLEN && dl->n_heap > 0 &&
+				dl->pool[dl->heap[0]].release <= now; n++) {
+			// pool slot stays valid until next push
+			slot = dline_pop(dl);
+			iov[n].iov_base = dl->pool[slot].buf;
+			iov[n].iov_len = dl->pool[slot].len;
+			memset(&msg[n], 0, sizeof(struct mmsghdr));
+			msg[n].msg_hdr.msg_iov = &iov[n];
+			msg[n].msg_hdr.msg_iovlen = 1;
+		}
+		for(sent = 0; sent < n; sent += ret) {
+			ret = sendmmsg(sock, msg + sent, n - sent, 0);
+			if(ret < 0 && errno == EINTR)
+				ret = 0;
+			else if(ret < 0) {
+				// skip the datagram that failed (as ECONNREFUSED)
+				dl->unsent++;
+				ret = 1;
+			}
+		}
+	}
+}
+
+// ---
+// Return the time to wait (ms) before next release or report
+// dline* dl: pointer to delay line
+// uint64_t now: current time (us)
+// uint64_t next_rep: time of next report (us)
+// return: int - timeout to be passed to poll
+// ---
+static int next_timeout(struct dline* dl, uint64_t now, uint64_t next_rep) {
+	uint64_t next = next_rep;	// earliest event
+
+	if(dl->n_heap > 0 && dl->pool[dl->heap[0]].release < next)
+		next = dl->pool[dl->heap[0]].release;
+	if(next <= now)
+		return 0;
+	return (next - now + 999) / 1000;
+}
+
+//--------------------------------
+// PRIVATE: RECEIVE LOOP
+//--------------------------------
+
+// ---
+// Return the time of realtime clock, the one of kernel timestamps
+// return: int64_t - us elapsed since the epoch
+// ---
+static int64_t realtime_us() {
+	struct 	timespec ts;	// current time
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ---
+// Read arrival time of a datagram from its kernel timestamp and the
+// number of datagrams the kernel dropped on the sink socket. Transit times
+// are differences of arrivals, so a missing timestamp is replaced by a
+// time of the same (realtime) clock
+// msghdr* hdr: message header filled by recvmmsg
+// int64_t def: realtime returned if no timestamp is present (us)
+// return: int64_t - arrival time (us)
+// ---
+static int64_t arrival_time(struct msghdr* hdr, int64_t def) {
+	struct 	cmsghdr* c;		// control message
+	struct 	timespec ts;	// kernel timestamp
+	int64_t	arr = def;		// arrival time
+
+	for(c = CMSG_FIRSTHDR(hdr); c != NULL; c = CMSG_NXTHDR(hdr, c)) {
+		if(c->cmsg_level != SOL_SOCKET)
+			continue;
+		if(c->cmsg_type == SCM_TIMESTAMPNS) {
+			memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+			arr = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+		} else if(c->cmsg_type == SO_RXQ_OVFL) {
+			memcpy(&kdrop, CMSG_DATA(c), sizeof(kdrop));
+		}
+	}
+	return arr;
+}
+
+// ---
+// Read every pending datagram, account it and push it in the delay line
+// int sock: bound receiving socket
+// flow* tab: pointer to Vector[MAXFLOW] of flows
+// dline* dl: pointer to delay line (pool is NULL if no forward)
+// impair* imp: pointer to impairment parameters
+// return: void
+// ---
+static void drain(
+		int sock, struct flow* tab, struct dline* dl, struct impair* imp) {
+
+	static char 	buf[VLEN][MAXPKT];				// datagram payloads
+	static char		ctl[VLEN][CMSG_SPACE(sizeof(struct timespec)) +
+						CMSG_SPACE(sizeof(uint32_t))];
+	struct 	mmsghdr msg[VLEN];						// datagram headers
+	struct 	iovec 	iov[VLEN];						// payload vectors
+	struct 	sockaddr_in from[VLEN];					// senders
+	struct 	flow* 	f;
+	int 	i, n;									// datagram index and num
+	uint64_t now, release;							// current and fw time
+	int64_t	rt;										// realtime of drain (us)
+
+	do {
+		for(i = 0; i < VLEN; i++) {
+			iov[i].iov_base = buf[i];
+			iov[i].iov_len = MAXPKT;
+			memset(&msg[i], 0, sizeof(struct mmsghdr));
+			msg[i].msg_hdr.msg_iov = &iov[i];
+			msg[i].msg_hdr.msg_iovlen = 1;
+			msg[i].msg_hdr.msg_name = &from[i];
+			msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			msg[i].msg_hdr.msg_control = ctl[i];
+			msg[i].msg_hdr.msg_controllen = sizeof(ctl[i]);
+		}
+
+		n = recvmmsg(sock, msg, VLEN, MSG_DONTWAIT, NULL);
+		if(n <= 0)
+			return;
+
+		now = udp_stamp();
+		rt = realtime_us();
+		for(i = 0; i < n; i++) {
+			f = flow_get(tab, &from[i]);
+			if(f)
+				flow_account(f, buf[i], msg[i].msg_len,
+					arrival_time(&msg[i].msg_hdr, rt));
+
+			if(!dl->pool || rnd(&imp->seed) < imp->loss)
+				continue;
+
+			release = now + imp->delay;
+			if(imp->jitter)
+				release += rnd(&imp->seed) * imp->jitter;
+			if(rnd(&imp->seed) < imp->reorder)
+				release += imp->gap;
+			dline_push(dl, buf[i], msg[i].msg_len, release);
+		}
+	} while(n == VLEN);
+}
+
+// ---
+// Print command line usage
+// char* name: program name
+// return: void
+// ---
+static void usage(char* name) {
+	printf("usage: %s [-p port] [-f fwd_port] [-a fwd_ip] [-d delay_ms] "
+		"[-j jitter_ms]\n\t[-l loss_%%] [-o reorder_%%] [-g gap_ms] "
+		"[-i report_ms] [-s seed]\n", name);
+}
+
+//----------------------
+// MAIN FUNCTION
+//----------------------
+
+int main(int argc, char** argv) {
+	struct 	impair imp = {0};		// impairment parameters
+	struct 	flow tab[MAXFLOW];		// sender statistics
+	struct 	dline dl = {0};			// delay line
+	struct 	pollfd pfd;				// poll descriptor of sink socket
+	char* 	fwd_ip = FWD_IP;		// forward address
+	int 	port = UDP_PORT;		// listening port
+	int 	fwd_port = 0;			// forward port (0 = no forward)
+	int 	rep_ms = REPORT_MS;		// report interval
+	int 	sock, fwd = -1, opt, on = 1;
+	uint64_t now, last_rep, next_rep;
+
+	imp.seed = 1;
+	imp.gap = -1;
+	while((opt = getopt(argc, argv, "p:f:a:d:j:l:o:g:i:s:h")) != -1) {
+		switch(opt) {
+			case 'p': port = atoi(optarg); break;
+			case 'f': fwd_port = atoi(optarg); break;
+			case 'a': fwd_ip = optarg; break;
+			case 'd': imp.delay = atof(optarg) * 1000; break;
+			case 'j': imp.jitter = atof(optarg) * 1000; break;
+			case 'l': imp.loss = atof(optarg) / 100; break;
+			case 'o': imp.reorder = atof(optarg) / 100; break;
+			case 'g': imp.gap = atof(optarg) * 1000; break;
+			case 'i': rep_ms = atoi(optarg); break;
+			case 's': imp.seed = atoi(optarg); break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+
+	// by default a held back datagram is overtaken by the next one
+	if(imp.gap < 0)
+		imp.gap = 2 * imp.jitter + 30000;
+
+	sock = udp_bind(port, RCVBUF);
+	if(sock < 0) {
+		perror("udp_bind");
+		return 1;
+	}
+	setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+	setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+
+	if(fwd_port) {
+		fwd = udp_init(fwd_ip, fwd_port);
+		if(fwd < 0 || dline_init(&dl)) {
+			perror("forward");
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	memset(tab, 0, sizeof(tab));
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+
+	last_rep = udp_stamp();
+	next_rep = last_rep + rep_ms * 1000;
+	while(!stop) {
+		now = udp_stamp();
+		if(poll(&pfd, 1, next_timeout(&dl, now, next_rep)) > 0)
+			drain(sock, tab, &dl, &imp);
+
+		now = udp_stamp();
+		if(fwd >= 0)
+			dline_flush(&dl, fwd, now);
+
+		if(now >= next_rep) {
+			flow_report(tab, &dl, (now - last_rep) / 1e6);
+			last_rep = now;
+			next_rep = now + rep_ms * 1000;
+		}
+	}
+
+	flow_report(tab, &dl, (udp_stamp() - last_rep) / 1e6);
+	return 0;
+}
@@ -1,13 +1,178 @@
 #include "userpanel.h"
+#include "spsc.h"
 #include <allegro.h>
 #include <float.h>
 #include <string.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+//-----------------------------------
+// PRIVATE: PERSISTENT LAYERS AND DIRTY RECTANGLES
+//-----------------------------------
+#define MAXDIRTY 	32				// max dirty rects blitted in a frame
+#define FULLREDRAW	0				// 1: redraw every box each frame (A/B)
+
+struct drect {						// dirty rectangle (inclusive coord)
+	int 	x1, y1;					// top left corner
+	int 	x2, y2;					// bottom right corner
+};
+
+struct pnl_stat {					// panel rendering statistics
+	long 	frames;					// number of frames
+	long 	blits;					// number of rects blitted on screen
+	long 	pixels;					// number of pixels blitted on screen
+	double 	cpu;					// thread cpu time spent in frames (s)
+	long 	events;					// input events seen by frames
+	long 	ev_lost;				// input events lost (queue full)
+	uint64_t ev_lat_sum;			// sum of event to frame latencies (us)
+	uint64_t ev_lat_max;			// max event to frame latency (us)
+};
+
+static BITMAP* 	chrome;				// static layer, drawn once at init
+static BITMAP* 	frame;				// persistent back buffer
+static struct 	drect dirty[MAXDIRTY];	// regions of frame to be blitted
+static int 		n_dirty;			// number of dirty regions
+static struct 	pstate shown;		// panel state displayed on screen
+static int 		shown_valid;		// 0 forces a redraw of every box
+static struct 	pnl_stat stat;		// rendering statistics
+
+//-----------------------------------
+// PRIVATE: PANEL BACKENDS
+//-----------------------------------
+#define MAXEVENT 	4096			// max events in an input script
+#define EVKEY 		0				// script event: key down/up
+#define EVMOUSE		1				// script event: mouse pos and buttons
+#define EVSHOT		2				// script event: save screen as bitmap
+#define SHOTLEN		64				// max length of a bitmap file name
+#define INQLEN		256				// input events between frames (power of 2)
+
+struct pnl_input {					// input seen by a frame
+	char 	key[KEY_MAX];			// 1 if key (by scancode) is down
+	char 	hit[KEY_MAX];			// 1 if key went down during frame
+	int 	mouse_x, mouse_y;		// mouse position
+	int 	mouse_b;				// mouse buttons (bit 0 left, 1 right)
+	int 	mouse_hit;				// mouse buttons pressed during frame
+};
+
+struct pnl_ievent {					// input event, queued as it arrives
+	int 	type;					// EVKEY or EVMOUSE
+	int 	arg[3];					// scancode/down or x/y/buttons
+	uint64_t stamp;					// arrival time (us, monotonic clock)
+};
+
+struct pnl_backend {				// where panel is drawn and input comes
+	void 	(*init)();				// open display or memory target
+	void 	(*exit)();				// close it
+	void 	(*poll)(struct pnl_input* in);		// input of next frame
+	void 	(*present)(struct drect* r, int n);	// show dirty rects
+};
+
+struct pnl_event {					// input event injected by script
+	long 	frame;					// frame at which event happens
+	int 	type;					// EVKEY, EVMOUSE or EVSHOT
+	int 	arg[3];					// scancode/down or x/y/buttons
+	char 	file[SHOTLEN];			// bitmap file name for EVSHOT
+};
+
+static struct 	pnl_input in;		// input of current frame
+static struct 	spsc* in_queue;		// input events not yet seen by a frame
+static uint64_t in_first;			// arrival of first event of frame (0 none)
+static struct 	pnl_backend* back;	// backend in use
+static BITMAP* 	offscreen;			// screen of offscreen backend
+static struct 	pnl_event* script;	// events of offscreen backend
+static int 		n_event, next_event;// number of events, next to be done
+static const char* script_file;		// file with events (NULL if none)
+
+//-----------------------------------
+// PRIVATE: STRIP CHARTS (TELEMETRY VIEW)
+//-----------------------------------
+#define CHRTX1		(PWRSQX1 + 1)	// charts top left x-coord
+#define CHRTY1		(PWRSQY2 + 1)	// charts top left y-coord
+#define CHRTW		(SQLBOX - 1)	// charts width
+#define CHRTH		(SQHBOX - 1)	// charts height
+
+static struct 	telem* tlm;			// telemetry shown (NULL if none)
+static BITMAP* 	charts;				// strips, scrolled one column a frame
+static uint64_t tlm_pos[TELEM_MAXSIG];	// read position of each signal
+static int 		tlm_y[TELEM_MAXSIG];	// y of last sample drawn
+static int 		show_charts;		// charts replace the launch box
+static int 		t_was_down;			// T key was down at previous frame
+
+//-----------------------------------
+// PRIVATE: PREDICTION OVERLAY
+//-----------------------------------
+#define MAPW		(MAPSQX2 - MAPSQX1 + 1)	// map box width
+#define MAPH		(MAPSQY1 - MAPSQY2 + 1)	// map box height
+#define OVLMARK		4				// half size of landing point cross
+#define OVLZSCALE	20				// trajectory dot grows 1 px each (m)
+
+static BITMAP* 	map_base;			// map background and overlay
+static BITMAP* 	map_layer;			// map base and trails, under objects
+static struct 	predict pred;		// prediction to be shown
+static int 		has_pred;			// pred is valid
+static struct 	predict shown_pred;	// prediction drawn on map layer
+static int 		shown_has_pred;		// shown_pred is valid
+
+//-----------------------------------
+// PRIVATE: CATCHABILITY HEATMAP
+//-----------------------------------
+static struct 	heat* heat;			// heat cache (NULL if none)
+static struct 	heat_map* heat_map;	// map to be shown (NULL if none)
+static int 		show_heat;			// heatmap is blended into map
+static int 		h_was_down;			// H key was down at previous frame
+static struct 	heat_map* shown_heat;	// map drawn on map layer
+static uint32_t shown_heat_done;	// samples of map drawn on map layer
+
+//-----------------------------------
+// PRIVATE: TRAJECTORY TRAILS
+//-----------------------------------
+#define TRAIL_CAP	10000			// points kept by each trail
+#define TRAIL_BANDS	4				// age bands, each one with its color
+#define TRAIL_NUM	2				// trails: drone and ball
+
+struct trail {						// ring of past positions (layer coord)
+	int16_t x[TRAIL_CAP];			// x of points
+	int16_t y[TRAIL_CAP];			// y of points
+	uint32_t head;					// points pushed so far
+};
+
+static struct 	trail trails[TRAIL_NUM];	// drone and ball trails
+static uint32_t trail_owner[TRAIL_NUM][MAPW * MAPH];	// newest point + 1
+static int 		show_trail = 1;		// trails are drawn on map layer
+static int 		shown_trail;		// trails drawn at last layer redraw
+static int 		l_was_down;			// L key was down at previous frame
+static const int trail_age[TRAIL_BANDS] = 	// end of age bands (points)
+	{TRAIL_CAP / 100, TRAIL_CAP / 10, TRAIL_CAP / 3, TRAIL_CAP};
+static const int trail_col[TRAIL_NUM][TRAIL_BANDS] = {	// newest to oldest
+	{12, 4, 6, 8}, {11, 9, 1, 8}};
+
+//-----------------------------------
+// PRIVATE: REPLAY VIEW
+//-----------------------------------
+#define RPLTXTLEN	64				// max length of playback state line
+
+static struct 	replay_stat rpl;	// playback state to be shown
+static int 		has_rpl;			// panel shows a replay
+static int 		shown_seeks;		// seeks of playback shown on map
+static char 	shown_rpl[RPLTXTLEN];	// playback state line on screen
 
 //-----------------------------------
 // PRIVATE: KEYBOARD RELATED FUNCTIONS
 //-----------------------------------
 
+// ---
+// Return 1 if key is down or went down during frame: a press shorter than
+// a frame is not lost
+// int scancode: Allegro scancode of key
+// return: int - 1 if key is pressed in this frame, 0 otherwise
+// ---
+static int key_down(int scancode) {
+	return in.key[scancode] || in.hit[scancode];
+}
+
 // ---
 // Waits for a key pressed and extracts the corresponding scan code
 // return: char - scancode of pressed key
@@ -46,7 +211,7 @@ static void wait_back_key() {
 // return: int - 1 if BACKSPACE, 0 otherwise
 // ---
 static int nb_get_back_key() {
-	return key[KEY_BACKSPACE] != 0;
+	return key_down(KEY_BACKSPACE);
 }
 
 // ---
@@ -65,7 +230,31 @@ static void wait_enter_key() {
 // return: int - 1 if ENTER, 0 otherwise
 // ---
 static int nb_get_enter_key() {
-	return key[KEY_ENTER] != 0;
+	return key_down(KEY_ENTER);
+}
+
+// ---
+// Non blocking: Return 1 if T key is pressed, 0 otherwise
+// return: int - 1 if T, 0 otherwise
+// ---
+static int nb_get_t_key() {
+	return key_down(KEY_T);
+}
+
+// ---
+// Non blocking: Return 1 if L key is down, 0 otherwise
+// return: int - 1 if L key is down, 0 otherwise
+// ---
+static int nb_get_l_key() {
+	return key_down(KEY_L);
+}
+
+// ---
+// Non blocking: Return 1 if H key is down, 0 otherwise
+// return: int - 1 if H key is down, 0 otherwise
+// ---
+static int nb_get_h_key() {
+	return key_down(KEY_H);
 }
 
 // ---
@@ -73,7 +262,7 @@ static int nb_get_enter_key() {
 // return: int - 1 if ENTER, 0 otherwise
 // ---
 static int nb_get_r_key() {
-	return key[KEY_R] != 0;
+	return key_down(KEY_R);
 }
 
 //--------------------------------
@@ -89,8 +278,8 @@ static int nb_get_r_key() {
 // return: int - 1 if mouse is placed inside the rectangle, 0 otherwise
 // ---
 static int is_mouse_in(float x1, float y1, float x2, float y2) {
-	if(mouse_x > x1 && mouse_x < x2)
-		if(mouse_y > y1 && mouse_y < y2)
+	if(in.mouse_x > x1 && in.mouse_x < x2)
+		if(in.mouse_y > y1 && in.mouse_y < y2)
 			return 1;	
 	return 0;
 }
@@ -127,7 +316,7 @@ static int is_mouse_in_thbox() {
 // return: int - 1 if mouse left button is pressed, 0 otherwise
 // ---
 static int get_mouse_left_click() {
-	return mouse_b & 1;
+	return (in.mouse_b | in.mouse_hit) & 1;
 }
 
 // ---
@@ -135,13 +324,33 @@ static int get_mouse_left_click() {
 // return: int - 1 if mouse right button is pressed, 0 otherwise
 // ---
 static int get_mouse_right_click() {
-	return mouse_b & 2;
+	return (in.mouse_b | in.mouse_hit) & 2;
 }
 
 //----------------------------
 // PUBLIC: KEYBOARD RELATED FUNCTIONS
 //----------------------------
 
+// ---
+// Non blocking: Return the replay key (arrows, P or a digit) pressed during
+// last frame, RPLK_NONE if none
+// return: int - RPLK_* key, RPLK_JUMP + digit for a digit
+// ---
+int nb_get_replay_key() {
+	static const int keys[][2] = {{KEY_LEFT, RPLK_BACK}, 
+		{KEY_RIGHT, RPLK_FWD}, {KEY_UP, RPLK_FASTER}, 
+		{KEY_DOWN, RPLK_SLOWER}, {KEY_P, RPLK_PAUSE}};
+	int 	i;	// key index
+
+	for(i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		if(in.hit[keys[i][0]])
+			return keys[i][1];
+	for(i = 0; i <= 9; i++)
+		if(in.hit[KEY_0 + i])
+			return RPLK_JUMP + i;
+	return RPLK_NONE;
+}
+
 // ---
 // Blocking: Return only after ESC key press
 // return: void
@@ -158,7 +367,7 @@ void wait_esc_key() {
 // return: int - 1 if ESC, 0 otherwise
 // ---
 int nb_get_esc_key() {
-	return key[KEY_ESC] != 0;
+	return key_down(KEY_ESC);
 }
 
 //----------------------------------------------------
@@ -253,8 +462,8 @@ static float calc_dir(float lw_bound, float up_bound, float current) {
 // return: void
 // ---
 static void set_obj_position(float* pos, int* positioned) {
-	pos[X] = mouse_x;
-	pos[Y] = mouse_y;
+	pos[X] = in.mouse_x;
+	pos[Y] = in.mouse_y;
 	*positioned = 1;
 }
 
@@ -303,6 +512,9 @@ static void draw_text(BITMAP* buff) {
 	textout_ex(buff, font, PAUSECMD, RXMARG, VARMARG(6), MCOL, -1);
 	textout_ex(buff, font, ENDCMD, RXMARG, VARMARG(7), MCOL, -1);
 	textout_ex(buff, font, RESETCMD, RXMARG, VARMARG(8), MCOL, -1);
+	textout_ex(buff, font, TRAILCMD, XWIN / 2, VARMARG(6), MCOL, -1);
+	textout_ex(buff, font, HEATCMD, XWIN / 2, VARMARG(7), MCOL, -1);
+	textout_ex(buff, font, CHARTCMD, XWIN / 2, VARMARG(8), MCOL, -1);
 }
 
 // ---
@@ -421,23 +633,514 @@ static BITMAP* create_bitmap_buff(int dim_x, int dim_y, int color) {
 }
 
 // ---
-// Transfer a bitmap on screen safely and destroy the buffer
-// BITMAP* buff: pointer to BITMAP buffer that has to be copied
-// int xs: top left x-coord of rect in buffer
-// int xy: top left y-coord of rect in buffer
-// int xd: top left x-coord of rect in screen
-// int yd: top left y-coord of rect in screen
-// int w: width of the rect that has to be copied
-// int h: height of the rect that has to be copied
+// Add a region of back buffer to be blitted on screen in this frame
+// int x1: top left x-coord of region
+// int y1: top left y-coord of region
+// int x2: bottom right x-coord of region
+// int y2: bottom right y-coord of region
 // return: void
 // ---
-static void bmp_2_screen(
-		BITMAP* buff, int xs, int ys, int xd, int yd, int w, int h) {
-	
-	scare_mouse();
-	blit(buff, screen, xs, ys, xd, yd, w, h);	
-	unscare_mouse();
-	destroy_bitmap(buff);
+static void mark_dirty(int x1, int y1, int x2, int y2) {
+	int 	i;	// dirty rect index [0-MAXDIRTY]
+
+	if(x1 < 0) x1 = 0;
+	if(y1 < 0) y1 = 0;
+	if(x2 > XWIN - 1) x2 = XWIN - 1;
+	if(y2 > YWIN - 1) y2 = YWIN - 1;
+	if(x1 > x2 || y1 > y2)
+		return;
+
+	// when list is full, everything collapses in the bounding rect
+	if(n_dirty == MAXDIRTY) {
+		for(i = 1; i < n_dirty; i++) {
+			if(dirty[i].x1 < dirty[0].x1) dirty[0].x1 = dirty[i].x1;
+			if(dirty[i].y1 < dirty[0].y1) dirty[0].y1 = dirty[i].y1;
+			if(dirty[i].x2 > dirty[0].x2) dirty[0].x2 = dirty[i].x2;
+			if(dirty[i].y2 > dirty[0].y2) dirty[0].y2 = dirty[i].y2;
+		}
+		n_dirty = 1;
+	}
+
+	dirty[n_dirty].x1 = x1;
+	dirty[n_dirty].y1 = y1;
+	dirty[n_dirty].x2 = x2;
+	dirty[n_dirty].y2 = y2;
+	n_dirty++;
+}
+
+// ---
+// Copy a region of static layer on back buffer and mark it dirty
+// int x1: top left x-coord of region
+// int y1: top left y-coord of region
+// int x2: bottom right x-coord of region
+// int y2: bottom right y-coord of region
+// return: void
+// ---
+static void restore_chrome(int x1, int y1, int x2, int y2) {
+	blit(chrome, frame, x1, y1, x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+	mark_dirty(x1, y1, x2, y2);
+}
+
+// ---
+// Transfer dirty regions of back buffer on screen of backend
+// return: void
+// ---
+static void flush_dirty() {
+	int 	i;		// dirty rect index [0-MAXDIRTY]
+
+	if(n_dirty == 0)
+		return;
+
+	back->present(dirty, n_dirty);
+	for(i = 0; i < n_dirty; i++)
+		stat.pixels += (dirty[i].x2 - dirty[i].x1 + 1) * 
+			(dirty[i].y2 - dirty[i].y1 + 1);
+
+	stat.blits += n_dirty;
+	n_dirty = 0;
+}
+
+// ---
+// Blit dirty regions of back buffer on a destination bitmap
+// BITMAP* dest: pointer to destination bitmap
+// drect* r: pointer to vector of dirty rects
+// int n: number of dirty rects
+// return: void
+// ---
+static void blit_dirty(BITMAP* dest, struct drect* r, int n) {
+	int 	i;	// dirty rect index
+
+	for(i = 0; i < n; i++)
+		blit(frame, dest, r[i].x1, r[i].y1, r[i].x1, r[i].y1, 
+			r[i].x2 - r[i].x1 + 1, r[i].y2 - r[i].y1 + 1);
+}
+
+// ---
+// Draw once everything that does not change on the static layer
+// return: void
+// ---
+static void draw_chrome() {
+	chrome = create_bitmap_buff(XWIN, YWIN, BKG);
+
+	// map box background and border
+	rectfill(chrome, MAPSQX1, MAPSQY2, MAPSQX2, MAPSQY1, MAPBKG);
+	draw_map_box(chrome);
+
+	// launch box bar, legend and border
+	draw_bar(chrome);
+	draw_legend(chrome);
+	draw_pwr_box(chrome);
+
+	// top box commands and border
+	draw_text(chrome);
+	draw_top_box(chrome);
+
+	frame = create_bitmap(XWIN, YWIN);
+	blit(chrome, frame, 0, 0, 0, 0, XWIN, YWIN);
+	map_base = create_bitmap(MAPW, MAPH);
+	map_layer = create_bitmap(MAPW, MAPH);
+	blit(chrome, map_base, MAPSQX1, MAPSQY2, 0, 0, MAPW, MAPH);
+	blit(chrome, map_layer, MAPSQX1, MAPSQY2, 0, 0, MAPW, MAPH);
+	mark_dirty(0, 0, XWIN - 1, YWIN - 1);
+}
+
+// ---
+// Return 1 if the object on map is drawn at a different pixel than shown
+// float* pos: pointer to Vector[2] with new map position
+// float* old: pointer to Vector[2] with shown map position
+// int posit: new positioned flag
+// int old_posit: shown positioned flag
+// return: int - 1 if object has to be redrawn, 0 otherwise
+// ---
+static int obj_moved(float* pos, float* old, int posit, int old_posit) {
+	if(posit != old_posit)
+		return 1;
+	return posit && 
+		((int)pos[X] != (int)old[X] || (int)pos[Y] != (int)old[Y]);
+}
+
+// ---
+// Get the bounding box, clipped inside map, of an object drawn on map
+// float* pos: pointer to Vector[2] with map position of object
+// int r: radius of object
+// drect* box: pointer to rect that will contain the bounding box
+// return: int - 1 if bounding box is not empty, 0 otherwise
+// ---
+static int obj_box(float* pos, int r, struct drect* box) {
+	box->x1 = (int)pos[X] - r;
+	box->y1 = (int)pos[Y] - r;
+	box->x2 = (int)pos[X] + r;
+	box->y2 = (int)pos[Y] + r;
+	if(box->x1 < MAPSQX1) box->x1 = MAPSQX1;
+	if(box->y1 < MAPSQY2) box->y1 = MAPSQY2;
+	if(box->x2 > MAPSQX2) box->x2 = MAPSQX2;
+	if(box->y2 > MAPSQY1) box->y2 = MAPSQY1;
+	return box->x1 <= box->x2 && box->y1 <= box->y2;
+}
+
+// ---
+// Erase an object drawn on map restoring the map layer around it
+// float* pos: pointer to Vector[2] with map position of object
+// int r: radius of object
+// return: void
+// ---
+static void erase_obj_on_map(float* pos, int r) {
+	struct 	drect box;	// bounding box of object
+
+	if(!obj_box(pos, r, &box))
+		return;
+	blit(map_layer, frame, box.x1 - MAPSQX1, box.y1 - MAPSQY2, box.x1, box.y1,
+		box.x2 - box.x1 + 1, box.y2 - box.y1 + 1);
+	mark_dirty(box.x1, box.y1, box.x2, box.y2);
+}
+
+// ---
+// Mark dirty the bounding box of an object just drawn on map
+// float* pos: pointer to Vector[2] with map position of object
+// int r: radius of object
+// return: void
+// ---
+static void mark_obj_dirty(float* pos, int r) {
+	struct 	drect box;	// bounding box of object
+
+	if(obj_box(pos, r, &box))
+		mark_dirty(box.x1, box.y1, box.x2, box.y2);
+}
+
+// ---
+// Convert real world coordinates to map layer coordinates
+// float* real: pointer to Vector[2] with real world coord
+// int* x: pointer to x-coord on map layer
+// int* y: pointer to y-coord on map layer
+// return: int - 1 if point is inside the world, 0 otherwise
+// ---
+static int real_to_layer(float* real, int* x, int* y) {
+	float 	map[GR_DIM];	// map coord of point
+
+	if(real[X] < WRL_I || real[X] > WRL_F || 
+			real[Y] < WRL_I || real[Y] > WRL_F)
+		return 0;
+
+	coord_real_to_map(real, map);
+	*x = (int)map[X] - MAPSQX1;
+	*y = (int)map[Y] - MAPSQY2;
+	return 1;
+}
+
+// ---
+// Draw predicted trajectory, landing and catch point on a map sized bitmap.
+// Color tells the rollout outcome, unknown until predict task has done.
+// BITMAP* buff: pointer to map sized bitmap
+// predict* p: pointer to prediction
+// return: void
+// ---
+static void draw_predict(BITMAP* buff, struct predict* p) {
+	int 	col;				// overlay color
+	int 	x, y, px = 0, py = 0;	// point and previous point on layer
+	int 	in, p_in = 0;		// point and previous point inside world
+	int 	i;					// trajectory point index
+	char 	str[32];			// outcome caption
+
+	if(p->outcome == SIM_CAUGHT)
+		col = OVLCATCH;
+	else if(p->outcome == SIM_UNKNOWN)
+		col = OVLWAIT;
+	else
+		col = OVLMISS;
+
+	// height of the arc is shown by the size of its dots
+	for(i = 0; i < SIM_TRJ; i++) {
+		in = real_to_layer(p->traj[i], &x, &y);
+		if(in && p_in)
+			line(buff, px, py, x, y, col);
+		if(in)
+			circle(buff, x, y, 1 + p->traj[i][Z] / OVLZSCALE, col);
+		px = x;
+		py = y;
+		p_in = in;
+	}
+
+	if(real_to_layer(p->land, &x, &y)) {
+		line(buff, x - OVLMARK, y - OVLMARK, x + OVLMARK, y + OVLMARK, col);
+		line(buff, x - OVLMARK, y + OVLMARK, x + OVLMARK, y - OVLMARK, col);
+	}
+	if(real_to_layer(p->catch_pos, &x, &y))
+		circle(buff, x, y, MAPDRONER + 2, col);
+
+	if(p->outcome == SIM_CAUGHT)
+		sprintf(str, "catchable");
+	else if(p->outcome == SIM_UNKNOWN)
+		sprintf(str, "simulating...");
+	else
+		sprintf(str, "missed by %.1f m", p->miss);
+	textout_ex(buff, font, str, STM, STM, col, -1);
+}
+
+// ---
+// Blend the heatmap into a map sized bitmap, one pixel every two is
+// painted so that the map is still visible under it
+// BITMAP* buff: pointer to map sized bitmap
+// heat_map* m: pointer to heatmap
+// return: void
+// ---
+static void draw_heat(BITMAP* buff, struct heat_map* m) {
+	int 	i, j;		// column and row of cell
+	int 	x, y;		// pixel on bitmap
+	int 	col;		// color of cell
+
+	for(j = 0; j < HEAT_GRID; j++)
+		for(i = 0; i < HEAT_GRID; i++) {
+			switch(heat_cell(m, i, j)) {
+				case SIM_CAUGHT:
+					col = HEATCATCH;
+					break;
+				case SIM_UNKNOWN:
+					continue;
+				default:
+					col = HEATMISS;
+			}
+			for(y = j * MAPH / HEAT_GRID; y < (j + 1) * MAPH / HEAT_GRID; y++)
+				for(x = i * MAPW / HEAT_GRID + (y & 1); 
+						x < (i + 1) * MAPW / HEAT_GRID; x += 2)
+					putpixel(buff, x, y, col);
+		}
+}
+
+// ---
+// Ask the heatmap of the throw configured in panel, only when it is shown
+// and the drone is placed before a simulation
+// pstate* panel: pointer to panel state structure
+// return: void
+// ---
+static void request_heat(struct pstate* panel) {
+	struct 	heat_cfg cfg;	// configuration of heatmap
+
+	if(heat == NULL)
+		return;
+	if(!show_heat || panel->simul_state != STOPPED || 
+			!panel->drone_positioned) {
+		if(heat_map != NULL)
+			heat_map = heat_request(heat, NULL);
+		return;
+	}
+
+	memset(&cfg, 0, sizeof(cfg));
+	coord_map_to_real(panel->drone_pos, cfg.d_pos);
+	cfg.d_pos[Z] = panel->drone_pos[Z];
+	cfg.b_z = panel->ball_pos[Z];
+	cfg.pw = panel->power;
+	cfg.dir = panel->dir;
+	cfg.wrl_i = WRL_I;
+	cfg.wrl_f = WRL_F;
+	heat_map = heat_request(heat, &cfg);
+}
+
+// ---
+// Return the color of a point of trail k that has age newer points
+// int k: trail index
+// uint32_t age: number of newer points
+// return: int - color of point
+// ---
+static int trail_color(int k, uint32_t age) {
+	int 	b;	// age band
+
+	for(b = 0; b < TRAIL_BANDS - 1 && age >= trail_age[b]; b++)
+		;
+	return trail_col[k][b];
+}
+
+// ---
+// Draw every point kept by trails on map layer, oldest first, ball trail
+// over drone trail
+// return: void
+// ---
+static void draw_trails() {
+	struct 	trail* t;	// trail drawn
+	uint32_t n;			// point number
+	int 	k, p;		// trail index, point index in ring
+
+	if(!show_trail)
+		return;
+
+	memset(trail_owner, 0, sizeof(trail_owner));
+	for(k = 0; k < TRAIL_NUM; k++) {
+		t = &trails[k];
+		n = t->head > TRAIL_CAP ? t->head - TRAIL_CAP : 0;
+		for(; n < t->head; n++) {
+			p = n % TRAIL_CAP;
+			trail_owner[k][t->y[p] * MAPW + t->x[p]] = n + 1;
+			putpixel(map_layer, t->x[p], t->y[p], 
+				trail_color(k, t->head - 1 - n));
+		}
+	}
+}
+
+// ---
+// Repaint a pixel of map layer and back buffer as draw_trails would:
+// newest point of last trail owning it, or map base if none
+// int x: x-coord on map layer
+// int y: y-coord on map layer
+// return: void
+// ---
+static void repaint_pixel(int x, int y) {
+	uint32_t own;	// point number + 1 owning pixel
+	int 	col;	// color of pixel
+	int 	k;		// trail index
+
+	col = getpixel(map_base, x, y);
+	for(k = TRAIL_NUM - 1; k >= 0; k--) {
+		own = trail_owner[k][y * MAPW + x];
+		if(own) {
+			col = trail_color(k, trails[k].head - own);
+			break;
+		}
+	}
+	putpixel(map_layer, x, y, col);
+	putpixel(frame, x + MAPSQX1, y + MAPSQY2, col);
+	mark_dirty(x + MAPSQX1, y + MAPSQY2, x + MAPSQX1, y + MAPSQY2);
+}
+
+// ---
+// Repaint the pixel of point n of trail k if it is still the newest there;
+// a dropped point gives its pixel back
+// int k: trail index
+// uint32_t n: point number
+// int drop: 1 if point is dropped from trail, 0 if it changes color
+// return: void
+// ---
+static void update_point(int k, uint32_t n, int drop) {
+	struct 	trail* t = &trails[k];	// trail of point
+	int 	p = n % TRAIL_CAP;		// point index in ring
+	uint32_t* own;					// owner of point pixel
+
+	own = &trail_owner[k][t->y[p] * MAPW + t->x[p]];
+	if(*own != n + 1)
+		return;
+	if(drop)
+		*own = 0;
+	repaint_pixel(t->x[p], t->y[p]);
+}
+
+// ---
+// Add a map position to trail k, if it is on a new pixel. Only the points
+// that change color are repainted: the new one, one for each band it
+// leaves and the one dropped, so the cost does not depend on TRAIL_CAP.
+// int k: trail index
+// float* pos: pointer to Vector[2] with map position
+// return: void
+// ---
+static void push_trail(int k, float* pos) {
+	struct 	trail* t = &trails[k];	// trail
+	uint32_t n = t->head;			// number of new point
+	int 	x, y;					// new point on layer
+	int 	b, p;					// age band, point index in ring
+
+	x = (int)pos[X] - MAPSQX1;
+	y = (int)pos[Y] - MAPSQY2;
+	if(x < 1 || y < 1 || x > MAPW - 2 || y > MAPH - 2)
+		return;
+	p = (n + TRAIL_CAP - 1) % TRAIL_CAP;
+	if(n > 0 && t->x[p] == x && t->y[p] == y)
+		return;
+
+	if(show_trail && n >= TRAIL_CAP)
+		update_point(k, n - TRAIL_CAP, 1);
+
+	p = n % TRAIL_CAP;
+	t->x[p] = x;
+	t->y[p] = y;
+	t->head++;
+	if(!show_trail)
+		return;
+
+	trail_owner[k][y * MAPW + x] = n + 1;
+	update_point(k, n, 0);
+	for(b = 0; b < TRAIL_BANDS - 1; b++)
+		if(n >= trail_age[b])
+			update_point(k, n - trail_age[b], 0);
+}
+
+// ---
+// Show or hide the trails when L is pressed
+// return: void
+// ---
+static void toggle_trails() {
+	int 	l_down = nb_get_l_key();	// L key is down now
+
+	if(l_down && !l_was_down)
+		show_trail = !show_trail;
+	l_was_down = l_down;
+}
+
+// ---
+// Forget the trails, map layer is redrawn
+// return: void
+// ---
+static void clear_trails() {
+	int 	k;	// trail index
+
+	for(k = 0; k < TRAIL_NUM; k++)
+		trails[k].head = 0;
+	shown_valid = 0;
+}
+
+// ---
+// Return 1 if heatmap to be shown differs from the one on map layer
+// return: int - 1 if map layer has to be redrawn, 0 otherwise
+// ---
+static int heat_changed() {
+	if(heat_map != shown_heat)
+		return 1;
+	return heat_map != NULL && heat_done(heat_map) != shown_heat_done;
+}
+
+// ---
+// Show or hide the heatmap when H is pressed
+// return: void
+// ---
+static void toggle_heat() {
+	int 	h_down = nb_get_h_key();	// H key is down now
+
+	if(h_down && !h_was_down && heat != NULL)
+		show_heat = !show_heat;
+	h_was_down = h_down;
+}
+
+// ---
+// Return 1 if prediction to be shown differs from the one on map layer
+// return: int - 1 if map layer has to be redrawn, 0 otherwise
+// ---
+static int predict_changed() {
+	if(has_pred != shown_has_pred)
+		return 1;
+	return has_pred && memcmp(&pred, &shown_pred, sizeof(pred));
+}
+
+// ---
+// Redraw map layer (map background and overlay) and copy it on back buffer
+// return: void
+// ---
+static void update_map_layer() {
+	blit(chrome, map_base, MAPSQX1, MAPSQY2, 0, 0, MAPW, MAPH);
+
+	// overlay stays inside the border, prediction above heatmap
+	set_clip_rect(map_base, 1, 1, MAPW - 2, MAPH - 2);
+	if(heat_map != NULL) {
+		shown_heat_done = heat_done(heat_map);
+		draw_heat(map_base, heat_map);
+	}
+	if(has_pred)
+		draw_predict(map_base, &pred);
+	set_clip_rect(map_base, 0, 0, MAPW - 1, MAPH - 1);
+
+	blit(map_base, map_layer, 0, 0, 0, 0, MAPW, MAPH);
+	draw_trails();
+	blit(map_layer, frame, 0, 0, MAPSQX1, MAPSQY2, MAPW, MAPH);
+	mark_dirty(MAPSQX1, MAPSQY2, MAPSQX2, MAPSQY1);
+	shown_pred = pred;
+	shown_has_pred = has_pred;
+	shown_heat = heat_map;
+	shown_trail = show_trail;
 }
 
 //-------------------------------------
@@ -452,27 +1155,61 @@ static void bmp_2_screen(
 // return: void
 // ---
 static void update_map_box(struct pstate* panel, float* d_pos, float* b_pos) {
-	BITMAP* buff; // buffer to be printed
-	buff = create_bitmap_buff(XWIN, YWIN, MAPBKG);
+	int 	d_moved, b_moved;	// drone/ball has to be redrawn
+	int 	layer;				// map layer has to be redrawn
 
 	// if simul is running we can accept new pos from extern
 	if(panel->simul_state == RUNNING)
 		set_map_pos(panel, d_pos, b_pos);
 
-	// if drone is positioned we draw on map, else we can choose its pos
-	if(panel->drone_positioned)
-		draw_obj_on_map(buff, panel->drone_pos, MAPDRONER, MAPDRONECOL);
-	else if(is_mouse_in_map() && get_mouse_left_click())
+	// if drone is not positioned we can choose its pos
+	if(!panel->drone_positioned && is_mouse_in_map() && get_mouse_left_click())
 		set_obj_position(panel->drone_pos, &panel->drone_positioned);
 
-	// if ball is positioned we draw on map, else we can choose its pos
-	if(panel->ball_positioned)
-		draw_obj_on_map(buff, panel->ball_pos, MAPBALLR, MAPBALLCOL);
-	else if(is_mouse_in_map() && get_mouse_right_click())
+	// if ball is not positioned we can choose its pos
+	if(!panel->ball_positioned && is_mouse_in_map() && get_mouse_right_click())
 		set_obj_position(panel->ball_pos, &panel->ball_positioned);
 
-	draw_map_box(buff);
-	bmp_2_screen(buff, MAPSQX1, MAPSQY2, MAPSQX1, MAPSQY2, SQLBOX+1, SQHBOX+1);	
+	d_moved = obj_moved(panel->drone_pos, shown.drone_pos, 
+		panel->drone_positioned, shown.drone_positioned);
+	b_moved = obj_moved(panel->ball_pos, shown.ball_pos,
+		panel->ball_positioned, shown.ball_positioned);
+	request_heat(panel);
+	layer = !shown_valid || predict_changed() || heat_changed() ||
+		show_trail != shown_trail;
+	if(!layer && !d_moved && !b_moved)
+		return;
+
+	// old objects are erased, new ones drawn where they are
+	if(layer)
+		update_map_layer();
+	if(!layer && shown.drone_positioned)
+		erase_obj_on_map(shown.drone_pos, MAPDRONER);
+	if(!layer && shown.ball_positioned)
+		erase_obj_on_map(shown.ball_pos, MAPBALLR);
+
+	// trails grow only with positions coming from simulation
+	if(panel->simul_state == RUNNING) {
+		push_trail(0, panel->drone_pos);
+		push_trail(1, panel->ball_pos);
+	}
+
+	set_clip_rect(frame, MAPSQX1, MAPSQY2, MAPSQX2, MAPSQY1);
+	if(panel->drone_positioned) {
+		draw_obj_on_map(frame, panel->drone_pos, MAPDRONER, MAPDRONECOL);
+		mark_obj_dirty(panel->drone_pos, MAPDRONER);
+	}
+	if(panel->ball_positioned) {
+		draw_obj_on_map(frame, panel->ball_pos, MAPBALLR, MAPBALLCOL);
+		mark_obj_dirty(panel->ball_pos, MAPBALLR);
+	}
+	draw_map_box(frame);
+	set_clip_rect(frame, 0, 0, XWIN - 1, YWIN - 1);
+
+	memcpy(shown.drone_pos, panel->drone_pos, sizeof(shown.drone_pos));
+	memcpy(shown.ball_pos, panel->ball_pos, sizeof(shown.ball_pos));
+	shown.drone_positioned = panel->drone_positioned;
+	shown.ball_positioned = panel->ball_positioned;
 }
 
 // ---
@@ -481,28 +1218,52 @@ static void update_map_box(struct pstate* panel, float* d_pos, float* b_pos) {
 // return: void
 // ---
 static void update_launch_box(struct pstate* panel) {
-	BITMAP* buff;	// buffer to be printed	
 	int 	drag;	// indicates if ball is draggable
 
-	buff = create_bitmap_buff(XWIN, YWIN, BKG);
 	drag = is_mouse_in_thbox() && is_mouse_in_ball(panel->launch_ball, BALLR);
 
 	// if ball is draggable and user click with left mouse button
 	if(drag && get_mouse_left_click()) {
 		// ball pos, power and dir are updated
-		panel->launch_ball[X] = mouse_x;
-		panel->launch_ball[Y] = mouse_y;
-		panel->power = calc_power(LNCBARY2, LNCBARY1, mouse_y);
-		panel->dir = calc_dir(DIRLINEX, DIRLINEX+DIRLINEW, mouse_x);
+		panel->launch_ball[X] = in.mouse_x;
+		panel->launch_ball[Y] = in.mouse_y;
+		panel->power = calc_power(LNCBARY2, LNCBARY1, in.mouse_y);
+		panel->dir = calc_dir(DIRLINEX, DIRLINEX+DIRLINEW, in.mouse_x);
 	}
 
-	// draw everything
-	draw_ball(buff, panel->launch_ball[X], panel->launch_ball[Y]);
-	draw_bar(buff);
-	draw_legend(buff);
-	draw_filled_bar(buff, panel->power);
-	draw_pwr_box(buff);
-	bmp_2_screen(buff, PWRSQX1, PWRSQY2, PWRSQX1, PWRSQY2, SQLBOX+1, SQHBOX+1);	
+	if(shown_valid && panel->power == shown.power &&
+			(int)panel->launch_ball[X] == (int)shown.launch_ball[X] &&
+			(int)panel->launch_ball[Y] == (int)shown.launch_ball[Y])
+		return;
+
+	// box is small and changes only while dragging: redraw it whole
+	restore_chrome(PWRSQX1, PWRSQY2, PWRSQX2, PWRSQY1);
+	draw_filled_bar(frame, panel->power);
+	draw_ball(frame, panel->launch_ball[X], panel->launch_ball[Y]);
+	draw_legend(frame);
+	draw_pwr_box(frame);
+
+	memcpy(shown.launch_ball, panel->launch_ball, sizeof(shown.launch_ball));
+	shown.power = panel->power;
+}
+
+// ---
+// Redraw the simulation state line with the playback state, if changed
+// return: void
+// ---
+static void update_replay_line() {
+	char 	txt[RPLTXTLEN];	// playback state line
+
+	snprintf(txt, RPLTXTLEN, "Replay %.1f / %.1f s at %gx%s", rpl.t, rpl.len,
+		rpl.speed, rpl.paused ? " (paused)" : "");
+	if(shown_valid && !strcmp(txt, shown_rpl))
+		return;
+
+	restore_chrome(RXMARG, VARMARG(9), 
+		TPBOXX2 - 1, VARMARG(9) + text_height(font) - 1);
+	textout_ex(frame, font, txt, RXMARG, VARMARG(9), MCOL, -1);
+	textout_ex(frame, font, RPLCMD, XWIN / 2, VARMARG(9), MCOL, -1);
+	strcpy(shown_rpl, txt);
 }
 
 // ---
@@ -511,15 +1272,439 @@ static void update_launch_box(struct pstate* panel) {
 // return: void
 // ---
 static void update_panel_box(struct pstate* panel) {
-	BITMAP*	buff; // buffer to be printed
-	
-	buff = create_bitmap_buff(XWIN, YWIN, BKG);	
-	draw_text(buff);
-	draw_simulat_text(buff, panel->simul_state);
-	draw_top_box(buff);		
-	bmp_2_screen(buff, TPBOXX1, TPBOXY2, TPBOXX1, TPBOXY2, PNLBOX+1, PNHBOX+1);
+	if(has_rpl) {
+		update_replay_line();
+		return;
+	}
+	if(shown_valid && panel->simul_state == shown.simul_state)
+		return;
+
+	// only the simulation state line changes
+	restore_chrome(RXMARG, VARMARG(9), 
+		TPBOXX2 - 1, VARMARG(9) + text_height(font) - 1);
+	draw_simulat_text(frame, panel->simul_state);
+
+	shown.simul_state = panel->simul_state;
+}
+
+//-------------------------------------
+// PRIVATE: STRIP CHART RELATED FUNCTIONS
+//-------------------------------------
+
+// ---
+// Return the height of a strip, one for each signal
+// return: int - height of a strip (pixel)
+// ---
+static int strip_h() {
+	return CHRTH / tlm->nsig;
+}
+
+// ---
+// Return y-coord in charts of value v of signal i, clamped in its strip
+// int i: signal identifier
+// float v: value of signal
+// return: int - y-coord in charts bitmap
+// ---
+static int chart_y(int i, float v) {
+	struct 	telem_sig* s = &tlm->sig[i];
+	float 	frac;	// position of v in range of signal [0-1]
+
+	frac = (v - s->lo) / (s->hi - s->lo);
+	if(frac < 0) frac = 0;
+	if(frac > 1) frac = 1;
+	return (i + 1) * strip_h() - 2 - (int)(frac * (strip_h() - 3));
+}
+
+// ---
+// Create the charts bitmap with empty strips
+// return: void
+// ---
+static void init_charts() {
+	int 	i;	// signal index
+
+	charts = create_bitmap_buff(CHRTW, CHRTH, BKG);
+	for(i = 0; i < tlm->nsig; i++) {
+		hline(charts, 0, (i + 1) * strip_h() - 1, CHRTW - 1, CHARTGRID);
+		tlm_y[i] = chart_y(i, tlm->sig[i].lo);
+	}
+}
+
+// ---
+// Scroll charts one column left and draw new samples in the last column.
+// All samples arrived since previous frame go in the same column.
+// return: int - 1 if charts changed, 0 if no new sample
+// ---
+static int scroll_charts() {
+	int 	i;				// signal index
+	int 	ylo[TELEM_MAXSIG], yhi[TELEM_MAXSIG];	// span of new samples
+	int 	y, got = 0;		// y of a sample, some sample arrived
+	float 	v;				// value of a sample
+
+	for(i = 0; i < tlm->nsig; i++) {
+		ylo[i] = yhi[i] = tlm_y[i];
+		while(telem_get(tlm, i, &tlm_pos[i], &v)) {
+			y = chart_y(i, v);
+			if(y < ylo[i]) ylo[i] = y;
+			if(y > yhi[i]) yhi[i] = y;
+			tlm_y[i] = y;
+			got = 1;
+		}
+	}
+	if(!got)
+		return 0;
+
+	// existing pixels are moved, only the new column is drawn
+	blit(charts, charts, 1, 0, 0, 0, CHRTW - 1, CHRTH);
+	vline(charts, CHRTW - 1, 0, CHRTH - 1, BKG);
+	for(i = 0; i < tlm->nsig; i++) {
+		putpixel(charts, CHRTW - 1, (i + 1) * strip_h() - 1, CHARTGRID);
+		vline(charts, CHRTW - 1, ylo[i], yhi[i], CHARTCOL);
+	}
+	return 1;
+}
+
+// ---
+// Update the telemetry charts, shown in place of launch box
+// return: void
+// ---
+static void update_chart_box() {
+	int 	i;			// signal index
+	int 	changed;	// new samples have been drawn
+
+	if(tlm == NULL || tlm->nsig == 0)
+		return;
+	if(charts == NULL)
+		init_charts();
+
+	// rings are drained even when hidden, so charts are always up to date
+	changed = scroll_charts();
+	if(!show_charts || (shown_valid && !changed))
+		return;
+
+	blit(charts, frame, 0, 0, CHRTX1, CHRTY1, CHRTW, CHRTH);
+	for(i = 0; i < tlm->nsig; i++)
+		textout_ex(frame, font, tlm->sig[i].name, 
+			CHRTX1 + PAD, CHRTY1 + i * strip_h() + 1, MCOL, -1);
+	mark_dirty(CHRTX1, CHRTY1, CHRTX1 + CHRTW - 1, CHRTY1 + CHRTH - 1);
+}
+
+// ---
+// Switch between launch box and charts when T is pressed
+// return: void
+// ---
+static void toggle_charts() {
+	int 	t_down = nb_get_t_key();	// T key is down now
+
+	if(t_down && !t_was_down && tlm != NULL) {
+		show_charts = !show_charts;
+		shown_valid = 0;
+	}
+	t_was_down = t_down;
 }
 
+//-------------------------------------
+// PRIVATE: INPUT EVENTS (CAPTURED AS THEY ARRIVE)
+//-------------------------------------
+
+// ---
+// Return the current time of the monotonic clock in microseconds
+// return: uint64_t - microseconds elapsed from an unspecified point
+// ---
+static uint64_t input_stamp() {
+	struct 	timespec t;	// current time
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+// ---
+// Queue an input event stamped with its arrival time, never blocks.
+// Only one thread may capture events (Allegro input thread or panel).
+// int type: EVKEY or EVMOUSE
+// int a0: scancode or mouse x
+// int a1: down or mouse y
+// int a2: unused or mouse buttons
+// return: void
+// ---
+static void push_event(int type, int a0, int a1, int a2) {
+	struct 	pnl_ievent e;	// event to be queued
+
+	e.type = type;
+	e.arg[0] = a0;
+	e.arg[1] = a1;
+	e.arg[2] = a2;
+	e.stamp = input_stamp();
+	if(spsc_push(in_queue, &e))
+		stat.ev_lost++;
+}
+
+// ---
+// Apply to in every event arrived since last frame. Keys and buttons that
+// went down are latched for the frame, even if they are already up.
+// pnl_input* in: pointer to input of next frame
+// return: void
+// ---
+static void drain_events(struct pnl_input* in) {
+	struct 	pnl_ievent e;	// event to be applied
+	uint64_t now;			// time the frame sees the events
+	uint64_t lat;			// event to frame latency (us)
+	int 	sc;				// scancode of key event
+
+	now = input_stamp();
+	memset(in->hit, 0, sizeof(in->hit));
+	in->mouse_hit = 0;
+	in_first = 0;
+
+	while(spsc_pop(in_queue, &e) == 0) {
+		sc = e.arg[0];
+		if(e.type == EVKEY && sc > 0 && sc < KEY_MAX) {
+			in->key[sc] = e.arg[1] != 0;
+			in->hit[sc] |= in->key[sc];
+		} else if(e.type == EVMOUSE) {
+			in->mouse_x = e.arg[0];
+			in->mouse_y = e.arg[1];
+			in->mouse_hit |= e.arg[2] & ~in->mouse_b;
+			in->mouse_b = e.arg[2];
+		}
+
+		if(in_first == 0)
+			in_first = e.stamp;
+		lat = now - e.stamp;
+		if(lat > stat.ev_lat_max)
+			stat.ev_lat_max = lat;
+		stat.ev_lat_sum += lat;
+		stat.events++;
+	}
+}
+
+//-------------------------------------
+// PRIVATE: ALLEGRO BACKEND (WINDOW ON DISPLAY)
+//-------------------------------------
+
+// ---
+// Keyboard callback, run by Allegro input thread for every key change
+// int scancode: scancode of key, bit 7 set if key is released
+// return: void
+// ---
+static void alg_key_event(int scancode) {
+	push_event(EVKEY, scancode & 0x7f, !(scancode & 0x80), 0);
+}
+
+// ---
+// Mouse callback, run by Allegro input thread for every mouse change
+// int flags: MOUSE_FLAG_* of change (unused, whole state is queued)
+// return: void
+// ---
+static void alg_mouse_event(int flags) {
+	push_event(EVMOUSE, mouse_x, mouse_y, mouse_b);
+}
+
+// ---
+// Open the panel window and install keyboard and mouse
+// return: void
+// ---
+static void alg_init() {
+	allegro_init(); 
+	install_keyboard();
+	install_mouse();
+	set_color_depth(VGA);
+	set_gfx_mode(GFX_AUTODETECT_WINDOWED, XWIN, YWIN, 0, 0); 
+	clear_to_color(screen, BKG);
+	set_window_title(WNDTITLE);
+	show_mouse(screen);
+
+	// from now on input reaches the panel as events
+	keyboard_lowlevel_callback = alg_key_event;
+	mouse_callback = alg_mouse_event;
+}
+
+// ---
+// Close the panel window
+// return: void
+// ---
+static void alg_exit() {
+	allegro_exit();
+}
+
+// ---
+// Take keyboard and mouse events captured by Allegro callbacks
+// pnl_input* in: pointer to input of next frame
+// return: void
+// ---
+static void alg_poll(struct pnl_input* in) {
+	drain_events(in);
+}
+
+// ---
+// Transfer dirty rects of back buffer on screen safely
+// drect* r: pointer to vector of dirty rects
+// int n: number of dirty rects
+// return: void
+// ---
+static void alg_present(struct drect* r, int n) {
+	scare_mouse();
+	blit_dirty(screen, r, n);
+	unscare_mouse();
+}
+
+static struct pnl_backend alg_backend = {
+	alg_init, alg_exit, alg_poll, alg_present
+};
+
+//-------------------------------------
+// PRIVATE: OFFSCREEN BACKEND (MEMORY, SCRIPTED INPUT)
+//-------------------------------------
+
+// ---
+// Return scancode of a key name used in scripts, -1 if unknown
+// char* name: key name (ESC, ENTER, BACKSPACE, R or scancode number)
+// return: int - scancode of key, -1 if unknown
+// ---
+static int key_of_name(const char* name) {
+	static const struct { const char* name; int code; } keys[] = {
+		{"ESC", KEY_ESC}, {"ENTER", KEY_ENTER}, 
+		{"BACKSPACE", KEY_BACKSPACE}, {"R", KEY_R}, {"T", KEY_T},
+		{"H", KEY_H}, {"L", KEY_L}, {"P", KEY_P}, {"LEFT", KEY_LEFT},
+		{"RIGHT", KEY_RIGHT}, {"UP", KEY_UP}, {"DOWN", KEY_DOWN}
+	};
+	int 	i;		// key index
+	char* 	end;	// end of number in name
+
+	for(i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		if(!strcmp(name, keys[i].name))
+			return keys[i].code;
+
+	i = strtol(name, &end, 0);
+	if(*end || i <= 0 || i >= KEY_MAX)
+		return -1;
+	return i;
+}
+
+// ---
+// Read events from script file, one per line (# starts a comment), any order:
+//   <frame> key <name> <1 down|0 up>
+//   <frame> mouse <x> <y> <buttons>
+//   <frame> shot <file.bmp>
+// char* file: name of script file
+// return: int - number of events read, -1 in case of error
+// ---
+static int load_script(const char* file) {
+	FILE* 	f;					// script file
+	char 	line[128];			// line of script
+	char 	type[16], name[SHOTLEN];	// event type and argument
+	struct 	pnl_event* e;		// event being parsed
+	int 	n = 0;				// number of events
+	int 	nl = 0;				// line number
+	char 	lead;				// first non blank char of line
+	struct 	pnl_event tmp;		// event being sorted
+	int 	i, j;				// event indexes
+
+	f = fopen(file, "r");
+	if(f == NULL)
+		return -1;
+	script = calloc(MAXEVENT, sizeof(struct pnl_event));
+
+	while(fgets(line, sizeof(line), f) && n < MAXEVENT) {
+		nl++;
+		lead = line[strspn(line, " \t\r\n")];
+		if(lead == '#' || lead == 0)
+			continue;
+
+		e = &script[n];
+		if(sscanf(line, "%ld %15s", &e->frame, type) != 2)
+			type[0] = 0;
+
+		if(!strcmp(type, "key") && sscanf(line, "%*d %*s %63s %d",
+				name, &e->arg[1]) == 2 && (e->arg[0] = key_of_name(name)) > 0)
+			e->type = EVKEY;
+		else if(!strcmp(type, "mouse") && sscanf(line, "%*d %*s %d %d %d",
+				&e->arg[0], &e->arg[1], &e->arg[2]) == 3)
+			e->type = EVMOUSE;
+		else if(!strcmp(type, "shot") && 
+				sscanf(line, "%*d %*s %63s", e->file) == 1)
+			e->type = EVSHOT;
+		else {
+			fprintf(stderr, "%s:%d: bad event ignored\n", file, nl);
+			continue;
+		}
+		n++;
+	}
+	fclose(f);
+
+	// stable sort by frame, events of a frame keep file order
+	for(i = 1; i < n; i++) {
+		tmp = script[i];
+		for(j = i; j > 0 && script[j-1].frame > tmp.frame; j--)
+			script[j] = script[j-1];
+		script[j] = tmp;
+	}
+	return n;
+}
+
+// ---
+// Init Allegro without display and create the memory screen
+// return: void
+// ---
+static void off_init() {
+	install_allegro(SYSTEM_NONE, &errno, atexit);
+	set_color_depth(VGA);
+	offscreen = create_bitmap(XWIN, YWIN);
+	clear_to_color(offscreen, BKG);
+
+	n_event = next_event = 0;
+	if(script_file != NULL && (n_event = load_script(script_file)) < 0) {
+		fprintf(stderr, "cannot read input script %s\n", script_file);
+		n_event = 0;
+	}
+}
+
+// ---
+// Release memory screen and script
+// return: void
+// ---
+static void off_exit() {
+	destroy_bitmap(offscreen);
+	free(script);
+	script = NULL;
+	allegro_exit();
+}
+
+// ---
+// Apply script events of this frame and injected input
+// pnl_input* in: pointer to input of next frame
+// return: void
+// ---
+static void off_poll(struct pnl_input* in) {
+	struct 	pnl_event* e;	// event to be applied
+
+	// events of the script are applied at the frame they are bound
+	while(next_event < n_event && script[next_event].frame <= stat.frames) {
+		e = &script[next_event++];
+		if(e->type == EVKEY)
+			inject_key(e->arg[0], e->arg[1]);
+		else if(e->type == EVMOUSE)
+			inject_mouse(e->arg[0], e->arg[1], e->arg[2]);
+		else if(save_bitmap(e->file, offscreen, default_palette))
+			fprintf(stderr, "cannot save %s\n", e->file);
+	}
+
+	drain_events(in);
+}
+
+// ---
+// Transfer dirty rects of back buffer on memory screen
+// drect* r: pointer to vector of dirty rects
+// int n: number of dirty rects
+// return: void
+// ---
+static void off_present(struct drect* r, int n) {
+	blit_dirty(offscreen, r, n);
+}
+
+static struct pnl_backend off_backend = {
+	off_init, off_exit, off_poll, off_present
+};
+
 //---------------------------------
 // PRIVATE: EVENT RELEATED FUNCTIONS
 //---------------------------------
@@ -530,14 +1715,31 @@ static void update_panel_box(struct pstate* panel) {
 // return: void
 // ---
 static void change_state(struct pstate* panel) {
-	if(nb_get_r_key())
+	if(nb_get_r_key()) {
 		p_reset(panel);
+		clear_trails();
+	}
 	else if(nb_get_enter_key() && are_obj_posit(panel))
 		panel->simul_state = RUNNING;
 	else if(nb_get_back_key() && panel->simul_state == RUNNING)
 		panel->simul_state = PAUSED;
 }
 
+// ---
+// Replay: objects always come from outside, trails restart at each seek
+// pstate* panel: pointer to panel state structure
+// return: void
+// ---
+static void replay_state(struct pstate* panel) {
+	panel->simul_state = RUNNING;
+	panel->drone_positioned = 1;
+	panel->ball_positioned = 1;
+	if(rpl.seeks != shown_seeks) {
+		clear_trails();
+		shown_seeks = rpl.seeks;
+	}
+}
+
 //----------------------------
 // PUBLIC: INIT AND EXIT ALLEGRO LIB
 //----------------------------
@@ -547,14 +1749,13 @@ static void change_state(struct pstate* panel) {
 // return: void
 // ---
 void init_panel() {
-	allegro_init(); 
-	install_keyboard();
-	install_mouse();
-	set_color_depth(VGA);
-	set_gfx_mode(GFX_AUTODETECT_WINDOWED, XWIN, YWIN, 0, 0); 
-	clear_to_color(screen, BKG);
-	set_window_title(WNDTITLE);
-	show_mouse(screen);
+	if(back == NULL)
+		back = &alg_backend;
+	in_queue = spsc_create(NULL, INQLEN, sizeof(struct pnl_ievent));
+	back->init();
+
+	draw_chrome();
+	shown_valid = 0;
 }
 
 // ---
@@ -562,7 +1763,28 @@ void init_panel() {
 // return: void
 // ---
 void exit_panel() {
-	allegro_exit();
+	if(stat.frames) {
+		printf("-----------------------------------------------\n");
+		printf("USER PANEL RENDERING (per frame):\n");
+		printf("\tframes: %ld - cpu: %.1f us\n", 
+			stat.frames, stat.cpu * 1E6 / stat.frames);
+		printf("\tblits: %.2f - pixels: %ld\n", 
+			(double)stat.blits / stat.frames, stat.pixels / stat.frames);
+		if(stat.events)
+			printf("\tinput events: %ld (lost %ld) - event to frame avg: "
+				"%lu us - max: %lu us\n", stat.events, stat.ev_lost,
+				(unsigned long)(stat.ev_lat_sum / stat.events),
+				(unsigned long)stat.ev_lat_max);
+		printf("-----------------------------------------------\n");
+	}
+
+	if(charts != NULL)
+		destroy_bitmap(charts);
+	destroy_bitmap(map_layer);
+	destroy_bitmap(map_base);
+	destroy_bitmap(frame);
+	destroy_bitmap(chrome);
+	back->exit();
 }
 
 // ---
@@ -570,13 +1792,121 @@ void exit_panel() {
 // return: void
 // ---
 void graphic_loop(struct pstate* panel, float* d_new_pos, float* b_new_pos) {
+	struct 	timespec t0, t1;	// thread cpu time at begin and end of frame
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t0);
+	if(FULLREDRAW)
+		shown_valid = 0;
+	back->poll(&in);
+
 	// check for event that change internal state
-	change_state(panel);
+	if(has_rpl)
+		replay_state(panel);
+	else
+		change_state(panel);
+	toggle_charts();
+	toggle_heat();
+	toggle_trails();
 
-	// update the three boxes
+	// update the boxes, only changed regions reach the screen
 	update_map_box(panel, d_new_pos, b_new_pos);
-	update_launch_box(panel);
+	if(!show_charts)
+		update_launch_box(panel);
+	update_chart_box();
 	update_panel_box(panel);
+	flush_dirty();
+	shown_valid = 1;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t1);
+	stat.cpu += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1E9;
+	stat.frames++;
+}
+
+//----------------------------
+// PUBLIC: PANEL BACKEND AND INPUT INJECTION
+//----------------------------
+
+// ---
+// Choose where panel is drawn, must be called before init_panel
+// int backend: PNL_ALLEGRO (window) or PNL_OFFSCREEN (memory, no display)
+// char* script: file of input events for PNL_OFFSCREEN, NULL if none
+// return: void
+// ---
+void set_panel_backend(int backend, const char* script) {
+	back = (backend == PNL_OFFSCREEN) ? &off_backend : &alg_backend;
+	script_file = script;
+}
+
+// ---
+// Set telemetry shown by strip charts (toggled with T), NULL if none
+// telem* t: pointer to telemetry filled by rt tasks
+// return: void
+// ---
+void set_panel_telem(struct telem* t) {
+	tlm = t;
+}
+
+// ---
+// Return arrival time of first input event seen by last frame, so that
+// the reaction to it can be timed from the event and not from the frame
+// return: uint64_t - arrival time (us, monotonic clock), 0 if none
+// ---
+uint64_t get_input_stamp() {
+	return in_first;
+}
+
+// ---
+// Set heat cache of heatmap shown on map (toggled with H), NULL if none
+// heat* h: pointer to heat cache
+// return: void
+// ---
+void set_panel_heat(struct heat* h) {
+	heat = h;
+}
+
+// ---
+// Set prediction shown on map (copied), NULL hides it
+// predict* p: pointer to prediction of throw configured in panel
+// return: void
+// ---
+void set_panel_predict(struct predict* p) {
+	has_pred = (p != NULL);
+	if(has_pred)
+		pred = *p;
+}
+
+// ---
+// Set playback state of a replay (copied): simulation controls are off and
+// map objects come from the record. NULL for a live simulation.
+// replay_stat* s: pointer to playback state, NULL if none
+// return: void
+// ---
+void set_panel_replay(struct replay_stat* s) {
+	has_rpl = (s != NULL);
+	if(has_rpl)
+		rpl = *s;
+}
+
+// ---
+// Inject a key press or release, seen from next frame (offscreen only)
+// int scancode: Allegro scancode of key
+// int down: 1 if key is pressed, 0 if released
+// return: void
+// ---
+void inject_key(int scancode, int down) {
+	if(scancode > 0 && scancode < KEY_MAX)
+		push_event(EVKEY, scancode, down != 0, 0);
+}
+
+// ---
+// Inject mouse position and buttons, seen from next frame (offscreen only)
+// int x: mouse x-coord
+// int y: mouse y-coord
+// int buttons: bit 0 left button, bit 1 right button
+// return: void
+// ---
+void inject_mouse(int x, int y, int buttons) {
+	push_event(EVMOUSE, x, y, buttons);
 }
 
 //----------------------------
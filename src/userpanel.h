@@ -5,6 +5,11 @@
 #ifndef USERPANEL_H
 #define USERPANEL_H
 
+#include "telem.h"
+#include "sim.h"
+#include "heat.h"
+#include "replay.h"
+
 //-----------------------------------------------------
 // GRAPHICS CONSTANTS (DIMENSION)
 //-----------------------------------------------------
@@ -66,6 +71,13 @@
 #define MAPBKG 		2					// map background color
 #define MAPDRONECOL 4					// on map drone color
 #define MAPBALLCOL	1					// on map ball color
+#define CHARTGRID	7					// strip chart separator color
+#define CHARTCOL	4					// strip chart trace color
+#define OVLWAIT		7					// prediction color, rollout running
+#define OVLCATCH	11					// prediction color, catchable throw
+#define OVLMISS		12					// prediction color, missed throw
+#define HEATCATCH	14					// heatmap color, catchable start
+#define HEATMISS	0					// heatmap color, missed start
 
 //-----------------------------------
 // USER PANEL STRING
@@ -78,6 +90,10 @@
 #define PAUSECMD			"Press BACKSPACE to pause simulation!"						
 #define ENDCMD				"Press ESC to quit the simulatator"							
 #define RESETCMD 			"Press R to reset the simulation"							
+#define CHARTCMD			"Press T to toggle telemetry charts"
+#define HEATCMD				"Press H to toggle catch heatmap"
+#define TRAILCMD			"Press L to toggle trails"
+#define RPLCMD				"Arrows seek/speed, P pause, 0-9 jump"
 #define STCAPT(STATE)	 	"Simulation is " #STATE									
 #define BARCAPT 			"Power Bar"													
 #define PWRLINCPT 			"PWR"														
@@ -106,6 +122,23 @@
 #define RUNNING 1						// game is running
 #define PAUSED	2						// game is in pause
 
+//-----------------------------------
+// REPLAY KEYS
+//-----------------------------------
+#define RPLK_NONE		0				// no replay key pressed
+#define RPLK_BACK		1				// seek backward (LEFT)
+#define RPLK_FWD		2				// seek forward (RIGHT)
+#define RPLK_FASTER		3				// double speed (UP)
+#define RPLK_SLOWER		4				// halve speed (DOWN)
+#define RPLK_PAUSE		5				// pause or resume (P)
+#define RPLK_JUMP		10				// jump to tenth N of record (digit N)
+
+//-----------------------------------
+// PANEL BACKENDS
+//-----------------------------------
+#define PNL_ALLEGRO		0				// window on display, real input
+#define PNL_OFFSCREEN	1				// memory only, injected input
+
 struct pstate {							// panel state structure
 	int 	ball_positioned;			// ball is positioned in map
 	int 	drone_positioned;			// drone is positioned in map
@@ -127,6 +160,9 @@ void wait_esc_key();
 // Non blocking: Return 1 if ESC key is pressed, 0 otherwise
 int nb_get_esc_key();
 
+// Non blocking: Return the replay key pressed during last frame, 0 if none
+int nb_get_replay_key();
+
 //----------------------------------
 // PUBLIC: INIT AND EXIT ALLEGRO LIB
 //----------------------------------
@@ -140,6 +176,34 @@ void exit_panel();
 // Main graphic loop
 void graphic_loop(struct pstate* panel, float* d_new_pos, float* b_new_pos);
 
+//----------------------------
+// PUBLIC: PANEL BACKEND AND INPUT INJECTION
+//----------------------------
+
+// Choose where panel is drawn, must be called before init_panel
+void set_panel_backend(int backend, const char* script);
+
+// Inject a key press or release, seen from next frame (offscreen only)
+void inject_key(int scancode, int down);
+
+// Inject mouse position and buttons, seen from next frame (offscreen only)
+void inject_mouse(int x, int y, int buttons);
+
+// Set telemetry shown by strip charts (toggled with T), NULL if none
+void set_panel_telem(struct telem* t);
+
+// Return arrival time of first input event seen by last frame (0 if none)
+uint64_t get_input_stamp();
+
+// Set heat cache of heatmap shown on map (toggled with H), NULL if none
+void set_panel_heat(struct heat* h);
+
+// Set prediction shown on map (copied), NULL hides it
+void set_panel_predict(struct predict* p);
+
+// Set playback state of a replay (copied), NULL for a live simulation
+void set_panel_replay(struct replay_stat* s);
+
 //----------------------------
 // PUBLIC: GETTER AND SETTER
 //----------------------------
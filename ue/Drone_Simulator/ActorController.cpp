@@ -27,11 +27,76 @@ void AActorController::BeginPlay()
 void AActorController::Tick( float DeltaTime )
 {
 	Super::Tick( DeltaTime );
+
+	if (bUseJitterBuffer) {
+		TickJitterBuffer();
+		EvaluateBallModel();
+		return;
+	}
 	
 	// Get Data
 	if(OurCommunicationComponent->GetNewPacketRecvd()) {
 		OurCommunicationComponent->GetData(&ReceivedData);
+
+		double Transit = ReceivedData.RecvTime - ReceivedData.SendStamp * 1e-6;
+		if (MinTransit == 0.0 || Transit < MinTransit)
+			MinTransit = Transit;
 	}
+	EvaluateBallModel();
+}
+
+void AActorController::EvaluateBallModel()
+{
+	double SenderNow;
+	double LastStamp = ReceivedData.SendStamp * 1e-6;
+
+	if (ReceivedData.BallModel.Epoch == 0 || ReceivedData.SendStamp == 0)
+		return;
+
+	if (bUseJitterBuffer)
+		SenderNow = FPlatformTime::Seconds() - PoseBuffer.ClockOffset() - PlayoutDelay;
+	else
+		SenderNow = FPlatformTime::Seconds() - MinTransit;
+
+	// When the stream stops (simulation paused) the ball stops as well
+	SenderNow = FMath::Min(SenderNow, LastStamp + MaxExtrapolation);
+
+	ReceivedData.ballPosition = ReceivedData.BallModel.Evaluate((uint64)(SenderNow * 1e6));
+}
+
+void AActorController::TickJitterBuffer()
+{
+	FCustomData Packet;
+	FVector* Pose[] = { &ReceivedData.dronePosition, &ReceivedData.droneRotation, &ReceivedData.ballPosition };
+	float Values[PoseChannels];
+
+	// Push every packet received since last frame
+	while (OurCommunicationComponent->PopData(&Packet)) {
+		ReceivedData.BallModel = Packet.BallModel;
+		ReceivedData.SendStamp = Packet.SendStamp;
+
+		Values[0] = Packet.dronePosition.X;
+		Values[1] = Packet.dronePosition.Y;
+		Values[2] = Packet.dronePosition.Z;
+		Values[3] = Packet.droneRotation.X;
+		Values[4] = Packet.droneRotation.Y;
+		Values[5] = Packet.droneRotation.Z;
+		Values[6] = Packet.ballPosition.X;
+		Values[7] = Packet.ballPosition.Y;
+		Values[8] = Packet.ballPosition.Z;
+
+		// Older simulators do not stamp packets: use the arrival time
+		if (Packet.SendStamp)
+			PoseBuffer.Push(Packet.Seq, Packet.SendStamp, Packet.RecvTime, Values);
+		else
+			PoseBuffer.Push(Packet.RecvTime, Packet.RecvTime, Values);
+	}
+
+	if (!PoseBuffer.Sample(FPlatformTime::Seconds(), Values))
+		return;
+
+	for (int i = 0; i < 3; i++)
+		*Pose[i] = FVector(Values[3 * i], Values[3 * i + 1], Values[3 * i + 2]);
 }
 
 void AActorController::ReturnNewData(FCustomData* NewData) {
@@ -41,6 +106,11 @@ void AActorController::ReturnNewData(FCustomData* NewData) {
 void AActorController::PreInitializeComponents()
 {
 	Super::PreInitializeComponents();
+
+	PoseBuffer.SetPlayoutDelay(PlayoutDelay);
+	PoseBuffer.SetMaxExtrapolation(MaxExtrapolation);
+	OurCommunicationComponent->SetQueuePackets(bUseJitterBuffer);
+
 	OurCommunicationComponent->StartUDPComm("PawnCommunicationComponent");
 }
 
@@ -4,6 +4,7 @@
 
 #include "GameFramework/Actor.h"
 #include "UDP_Com.h"
+#include "JitterBuffer.h"
 #include "ActorController.generated.h"
 
 UCLASS()
@@ -34,5 +35,30 @@ private:
 	class UUdp_Com* OurCommunicationComponent;
 
 	FCustomData ReceivedData;
+
+	// Play received poses back through a jitter buffer instead of snapping to the last one
+	UPROPERTY(EditAnywhere, Category = "Jitter Buffer")
+	bool bUseJitterBuffer = false;
+
+	// Delay of the playback respect to the sender [s]
+	UPROPERTY(EditAnywhere, Category = "Jitter Buffer")
+	float PlayoutDelay = 0.06f;
+
+	// Longest dead-reckoning when packets are late [s]
+	UPROPERTY(EditAnywhere, Category = "Jitter Buffer")
+	float MaxExtrapolation = 0.1f;
+
+	// Drone position, drone rotation and ball position
+	static const int PoseChannels = 9;
+	TJitterBuffer<PoseChannels> PoseBuffer;
+
+	// Feed the jitter buffer with queued packets and sample it at current time
+	void TickJitterBuffer();
+
+	// Smallest arrival minus send time seen without jitter buffer [s]
+	double MinTransit = 0.0;
+
+	// Place the ball on the streamed model at current sender time
+	void EvaluateBallModel();
 	
 };
@@ -4,6 +4,50 @@
 #define SPACEDIM 3
 #define NROTOR 4
 
+// Packets of the model streaming protocol start with their type
+#define UDP_MSG_DRONE 1
+#define UDP_MSG_BALL 2
+#define UDP_DRONE_MSG_LEN 40
+#define UDP_BALL_MSG_LEN 64
+
+// Ball trajectory sent by the simulator at each discontinuity
+struct FBallModel
+{
+	// Number of discontinuities so far (0 = no model received)
+	uint32 Epoch = 0;
+
+	// Sender time [us] at which Position and Velocity hold
+	uint64 T0 = 0;
+
+	FVector Position;
+	FVector Velocity;
+
+	// Downward acceleration [m/s^2], sender integration step [s], floor height [m]
+	float Acc = 0.0f;
+	float Step = 0.0f;
+	float Floor = 0.0f;
+
+	// Ball position [m] at sender time T [us]: the curve passes through
+	// every integration step of the sender and it is smooth between them
+	FVector Evaluate(uint64 T) const
+	{
+		float Dt = T > T0 ? (T - T0) / 1e6f : 0.0f;
+		float A = -Acc / 2;
+		float B = Velocity.Z - Acc * Step / 2;
+		float C = Position.Z - Floor;
+
+		// Once on the floor the ball does not move anymore
+		if (C <= 0)
+			Dt = 0;
+		else if (A * Dt * Dt + B * Dt + C < 0)
+			Dt = A < 0 ? (-B - FMath::Sqrt(B * B - 4 * A * C)) / (2 * A) : -C / B;
+
+		FVector Result = Position + Velocity * Dt;
+		Result.Z = FMath::Max(Position.Z + (A * Dt + B) * Dt, Floor);
+		return Result;
+	}
+};
+
 USTRUCT()
 struct FCustomData
 {
@@ -13,6 +57,16 @@ struct FCustomData
 	FVector droneRotation;
 	FVector ballPosition;
 
+	// Sequence number and send time [us] appended by the simulator
+	uint32 Seq = 0;
+	uint64 SendStamp = 0;
+
+	// Local arrival time [s], not serialized
+	double RecvTime = 0.0;
+
+	// Last ball model received (model streaming only)
+	FBallModel BallModel;
+
 	FCustomData() {}
 };
 
@@ -44,6 +98,13 @@ FORCEINLINE FArchive& operator<<(FArchive &Ar, FCustomData& TheStruct)
 	Ar << TheStruct.droneRotation;
 	Ar << TheStruct.ballPosition;
 
+	// Older simulators send only the positions
+	if (Ar.IsLoading() && Ar.TotalSize() - Ar.Tell() < (int64)(sizeof(uint32) + sizeof(uint64)))
+		return Ar;
+
+	Ar << TheStruct.Seq;
+	Ar << TheStruct.SendStamp;
+
 	return Ar;
 }
 
@@ -58,3 +119,34 @@ FORCEINLINE FArchive& operator<<(FArchive &Ar, FCustomOutputData& TheStruct)
 
 	return Ar;
 }
+
+// Read a drone pose packet of the model streaming protocol
+FORCEINLINE void ReadDroneMessage(FArchive &Ar, FCustomData& TheStruct)
+{
+	uint32 Type;
+
+	Ar << Type;
+	Ar << TheStruct.Seq;
+	Ar << TheStruct.SendStamp;
+	Ar << TheStruct.dronePosition;
+	Ar << TheStruct.droneRotation;
+}
+
+// Read a ball model packet of the model streaming protocol
+FORCEINLINE void ReadBallMessage(FArchive &Ar, FCustomData& TheStruct)
+{
+	uint32 Type, Seq;
+	uint64 SendStamp;
+	FBallModel& Model = TheStruct.BallModel;
+
+	Ar << Type;
+	Ar << Seq;
+	Ar << SendStamp;
+	Ar << Model.T0;
+	Ar << Model.Position;
+	Ar << Model.Velocity;
+	Ar << Model.Acc;
+	Ar << Model.Step;
+	Ar << Model.Floor;
+	Ar << Model.Epoch;
+}
@@ -0,0 +1,219 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+// Portable jitter buffer for timestamped pose samples.
+// It does not depend on the engine, so it can be built and tested on any
+// platform with a plain C++11 compiler.
+//
+// Samples are stamped with the sender clock. The buffer estimates the offset
+// between sender and local clock from the fastest packet seen, and plays the
+// stream back PlayoutDelay seconds late. Queries between two samples are
+// linearly interpolated; queries past the newest sample are dead-reckoned from
+// the last two samples for at most MaxExtrapolation seconds.
+//
+// Query times are expected to grow (one per render frame), so the playback
+// cursor only moves forward and each query costs O(1) amortized.
+//
+// Packets carry a sequence number and a stamp in us that may wrap around:
+// Push with those compares them by their difference to the newest sample,
+// as serial numbers, and feed the buffer with the sender time they give in
+// seconds, unwrapped: it stays absolute, as the stamps and models of the
+// sender, so ClockOffset can be used on those too.
+
+#include <cstring>
+#include <cstdint>
+
+template <int NumChannels, int Capacity = 64>
+class TJitterBuffer
+{
+public:
+	TJitterBuffer()
+		: PlayoutDelay(0.06), MaxExtrapolation(0.1), OffsetDecay(0.001)
+	{
+		Reset();
+	}
+
+	// Drop every sample and forget the clock offset
+	void Reset()
+	{
+		Head = 0;
+		Count = 0;
+		Cursor = 0;
+		bHasOffset = false;
+		Offset = 0.0;
+		LastLocalTime = 0.0;
+		LateSamples = 0;
+		bHasStamp = false;
+		LastSeq = 0;
+		LastStamp = 0;
+		StampTime = 0.0;
+	}
+
+	// Delay between sender time and playback time [s]
+	void SetPlayoutDelay(double Seconds) { PlayoutDelay = Seconds; }
+
+	// Longest dead-reckoning past the newest sample [s]
+	void SetMaxExtrapolation(double Seconds) { MaxExtrapolation = Seconds; }
+
+	// Drift allowed to the offset estimate per second of local time [s/s]
+	void SetOffsetDecay(double Rate) { OffsetDecay = Rate; }
+
+	// Insert a sample stamped SenderTime received at LocalTime.
+	// Samples older than the newest one are late and are dropped.
+	// Return true if the sample has been stored
+	bool Push(double SenderTime, double LocalTime, const float* Values)
+	{
+		double Transit = LocalTime - SenderTime;
+
+		// The minimum transit is the one with no queuing: it is tracked and
+		// slowly relaxed so that a drift between the two clocks is followed
+		if (!bHasOffset || Transit < Offset)
+		{
+			Offset = Transit;
+			bHasOffset = true;
+		}
+		else if (LocalTime > LastLocalTime)
+		{
+			Offset += OffsetDecay * (LocalTime - LastLocalTime);
+			if (Offset > Transit)
+				Offset = Transit;
+		}
+		LastLocalTime = LocalTime;
+
+		if (Count > 0 && SenderTime <= At(Count - 1).Time)
+		{
+			LateSamples++;
+			return false;
+		}
+
+		// When full, the oldest sample is overwritten
+		if (Count == Capacity)
+		{
+			Head = (Head + 1) % Capacity;
+			Count--;
+			if (Cursor > 0)
+				Cursor--;
+		}
+
+		FSample& Slot = At(Count);
+		Slot.Time = SenderTime;
+		std::memcpy(Slot.Values, Values, sizeof(Slot.Values));
+		Count++;
+		return true;
+	}
+
+	// Insert a sample numbered Seq and stamped StampUs [us] by the sender,
+	// received at LocalTime. Samples not newer than the newest one (in
+	// sequence or in stamp) are late and are dropped; a sequence far behind
+	// it is a restarted sender and starts the buffer again.
+	// Return true if the sample has been stored
+	bool Push(uint32_t Seq, uint64_t StampUs, double LocalTime, const float* Values)
+	{
+		int32_t SeqStep = (int32_t)(Seq - LastSeq);
+		int64_t StampStep = (int64_t)(StampUs - LastStamp);
+
+		if (bHasStamp && SeqStep < -Capacity)
+			Reset();
+
+		if (!bHasStamp)
+			StampTime = StampUs * 1e-6;
+		else if (SeqStep <= 0 || StampStep <= 0)
+		{
+			LateSamples++;
+			return false;
+		}
+		else
+			StampTime += StampStep * 1e-6;
+
+		bHasStamp = true;
+		LastSeq = Seq;
+		LastStamp = StampUs;
+		return Push(StampTime, LocalTime, Values);
+	}
+
+	// Evaluate the stream at local time LocalTime and leave it in Out.
+	// Return false if no sample has been received yet
+	bool Sample(double LocalTime, float* Out)
+	{
+		if (Count == 0)
+			return false;
+
+		double Target = LocalTime - Offset - PlayoutDelay;
+
+		// A query back in time (new offset) restarts from the oldest sample
+		if (Target < At(Cursor).Time)
+			Cursor = 0;
+
+		while (Cursor + 1 < Count && At(Cursor + 1).Time <= Target)
+			Cursor++;
+
+		const FSample& A = At(Cursor);
+		if (Target <= A.Time || Count == 1)
+		{
+			std::memcpy(Out, A.Values, sizeof(A.Values));
+			return true;
+		}
+
+		// Interpolate inside the buffer, dead-reckon past its end
+		if (Cursor + 1 < Count)
+		{
+			Blend(A, At(Cursor + 1), Target, Out);
+			return true;
+		}
+
+		const FSample& P = At(Cursor - 1);
+		if (Target > A.Time + MaxExtrapolation)
+			Target = A.Time + MaxExtrapolation;
+		Blend(P, A, Target, Out);
+		return true;
+	}
+
+	// Number of samples held
+	int Num() const { return Count; }
+
+	// Number of samples dropped because older than the newest one
+	int NumLate() const { return LateSamples; }
+
+	// Estimated local minus sender clock [s]
+	double ClockOffset() const { return Offset; }
+
+private:
+	struct FSample
+	{
+		double Time;
+		float Values[NumChannels];
+	};
+
+	// Sample I positions after the oldest one
+	FSample& At(int I) { return Samples[(Head + I) % Capacity]; }
+
+	// Linear blend (or extrapolation) of A and B at time T
+	static void Blend(const FSample& A, const FSample& B, double T, float* Out)
+	{
+		double Alpha = (T - A.Time) / (B.Time - A.Time);
+
+		for (int i = 0; i < NumChannels; i++)
+			Out[i] = (float)(A.Values[i] + Alpha * (B.Values[i] - A.Values[i]));
+	}
+
+	FSample Samples[Capacity];
+	int Head;
+	int Count;
+	int Cursor;
+
+	double PlayoutDelay;
+	double MaxExtrapolation;
+	double OffsetDecay;
+
+	bool bHasOffset;
+	double Offset;
+	double LastLocalTime;
+	int LateSamples;
+
+	// Newest sequence and stamp, its sender time unwrapped [s]
+	bool bHasStamp;
+	uint32_t LastSeq;
+	uint64_t LastStamp;
+	double StampTime;
+};
@@ -64,8 +64,23 @@ void UUdp_Com::EndPlay(const EEndPlayReason::Type EndPlayReason)
 
 void UUdp_Com::Recv(const FArrayReaderPtr & ArrayReaderPtr, const FIPv4Endpoint & EndPt)
 {
-	*ArrayReaderPtr << Data;
+	int32 Len = ArrayReaderPtr->Num();
+
+	// A ball model carries no pose: it is kept and sent along with next poses
+	if (Len == UDP_BALL_MSG_LEN) {
+		ReadBallMessage(*ArrayReaderPtr, Data);
+		return;
+	}
+
+	if (Len == UDP_DRONE_MSG_LEN)
+		ReadDroneMessage(*ArrayReaderPtr, Data);
+	else
+		*ArrayReaderPtr << Data;
+	Data.RecvTime = FPlatformTime::Seconds();
 	NewPacketRecvd = true;
+
+	if (bQueuePackets)
+		PacketQueue.Enqueue(Data);
 }
 
 bool UUdp_Com::StartUDPComm(const FString & YourChosenSocketName)
@@ -143,3 +158,13 @@ bool UUdp_Com::GetNewPacketRecvd()
 	return NewPacketRecvd;
 }
 
+void UUdp_Com::SetQueuePackets(bool bQueue)
+{
+	bQueuePackets = bQueue;
+}
+
+bool UUdp_Com::PopData(FCustomData * RetData)
+{
+	return PacketQueue.Dequeue(*RetData);
+}
+
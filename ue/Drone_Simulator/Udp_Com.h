@@ -54,6 +54,12 @@ public:
 	// Get first packet received value
 	bool GetNewPacketRecvd();
 
+	// Keep every packet received in a queue, not only the last one
+	void SetQueuePackets(bool bQueue);
+
+	// Pop the oldest queued packet, return false if queue is empty
+	bool PopData(FCustomData* RetData);
+
 private:
 
 	// ----------------
@@ -75,4 +81,9 @@ private:
 	FCustomOutputData DataOut;
 
 	bool NewPacketRecvd = false;	
+
+	// Packets received and not yet popped (receiver thread -> game thread)
+	TQueue<FCustomData, EQueueMode::Spsc> PacketQueue;
+
+	bool bQueuePackets = false;
 };
@@ -0,0 +1,214 @@
+// Unit tests of TJitterBuffer, built with a plain C++11 compiler (see makefile)
+// outside the game module, that would compile them with the engine
+
+#include "../Drone_Simulator/JitterBuffer.h"
+#include <cmath>
+#include <cstdio>
+
+static int Failures = 0;
+
+#define CHECK(Cond) \
+	do { \
+		if (!(Cond)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Cond); \
+			Failures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(A, B) CHECK(std::fabs((double)(A) - (double)(B)) < 1e-4)
+
+typedef TJitterBuffer<1, 8> FBuffer;
+
+// Buffer with sender and local clocks equal and no playout delay
+static void MakeBuffer(FBuffer& Buffer)
+{
+	Buffer.SetPlayoutDelay(0.0);
+	Buffer.SetMaxExtrapolation(0.1);
+	Buffer.SetOffsetDecay(0.0);
+}
+
+static bool Push(FBuffer& Buffer, double Time, float Value)
+{
+	return Buffer.Push(Time, Time, &Value);
+}
+
+static float SampleAt(FBuffer& Buffer, double Time)
+{
+	float Value = NAN;
+
+	CHECK(Buffer.Sample(Time, &Value));
+	return Value;
+}
+
+static void TestEmpty()
+{
+	FBuffer Buffer;
+	float Value = 0.0f;
+
+	CHECK(!Buffer.Sample(1.0, &Value));
+	CHECK(Buffer.Num() == 0);
+}
+
+static void TestInterpolation()
+{
+	FBuffer Buffer;
+
+	MakeBuffer(Buffer);
+	CHECK(Push(Buffer, 1.0, 0.0f));
+	CHECK(Push(Buffer, 1.1, 1.0f));
+	CHECK(Push(Buffer, 1.2, 3.0f));
+	CHECK_NEAR(SampleAt(Buffer, 0.5), 0.0f);
+	CHECK_NEAR(SampleAt(Buffer, 1.05), 0.5f);
+	CHECK_NEAR(SampleAt(Buffer, 1.1), 1.0f);
+	CHECK_NEAR(SampleAt(Buffer, 1.15), 2.0f);
+
+	// Queries back in time restart from the oldest sample
+	CHECK_NEAR(SampleAt(Buffer, 1.025), 0.25f);
+}
+
+static void TestPlayoutDelay()
+{
+	FBuffer Buffer;
+
+	MakeBuffer(Buffer);
+	Buffer.SetPlayoutDelay(0.1);
+	Push(Buffer, 1.0, 0.0f);
+	Push(Buffer, 1.1, 1.0f);
+	CHECK_NEAR(SampleAt(Buffer, 1.15), 0.5f);
+}
+
+static void TestExtrapolationClamp()
+{
+	FBuffer Buffer;
+
+	MakeBuffer(Buffer);
+	Push(Buffer, 1.0, 0.0f);
+	Push(Buffer, 1.1, 1.0f);
+
+	// Dead-reckoned past the newest sample, for MaxExtrapolation at most
+	CHECK_NEAR(SampleAt(Buffer, 1.15), 1.5f);
+	CHECK_NEAR(SampleAt(Buffer, 1.2), 2.0f);
+	CHECK_NEAR(SampleAt(Buffer, 5.0), 2.0f);
+}
+
+static void TestLateAndOutOfOrder()
+{
+	FBuffer Buffer;
+	float Value = 7.0f;
+
+	MakeBuffer(Buffer);
+	CHECK(Push(Buffer, 1.0, 0.0f));
+	CHECK(Push(Buffer, 1.2, 2.0f));
+
+	// Older than (or as old as) the newest sample: dropped
+	CHECK(!Buffer.Push(1.1, 1.3, &Value));
+	CHECK(!Buffer.Push(1.2, 1.3, &Value));
+	CHECK(Buffer.NumLate() == 2);
+	CHECK(Buffer.Num() == 2);
+	CHECK_NEAR(SampleAt(Buffer, 1.1), 1.0f);
+
+	// Sequence numbers out of order are dropped even with a newer stamp
+	FBuffer Stamped;
+	MakeBuffer(Stamped);
+	CHECK(Stamped.Push(10u, 1000000ull, 1.0, &Value));
+	CHECK(Stamped.Push(12u, 1100000ull, 1.1, &Value));
+	CHECK(!Stamped.Push(11u, 1200000ull, 1.2, &Value));
+	CHECK(!Stamped.Push(13u, 1050000ull, 1.2, &Value));
+	CHECK(Stamped.NumLate() == 2);
+	CHECK(Stamped.Num() == 2);
+}
+
+static void TestCapacity()
+{
+	FBuffer Buffer;
+
+	MakeBuffer(Buffer);
+	for (int i = 0; i < 20; i++)
+		Push(Buffer, 1.0 + 0.1 * i, (float)i);
+	CHECK(Buffer.Num() == 8);
+	CHECK_NEAR(SampleAt(Buffer, 2.85), 18.5f);
+}
+
+static void TestSequenceWrap()
+{
+	FBuffer Buffer;
+	float Values[] = { 0.0f, 1.0f, 2.0f };
+
+	MakeBuffer(Buffer);
+	CHECK(Buffer.Push(0xFFFFFFFEu, 1000000ull, 1.0, &Values[0]));
+	CHECK(Buffer.Push(0xFFFFFFFFu, 1100000ull, 1.1, &Values[1]));
+	CHECK(Buffer.Push(0u, 1200000ull, 1.2, &Values[2]));
+	CHECK(!Buffer.Push(0xFFFFFFFFu, 1300000ull, 1.3, &Values[2]));
+	CHECK(Buffer.Num() == 3);
+	CHECK(Buffer.NumLate() == 1);
+	CHECK_NEAR(SampleAt(Buffer, 1.15), 1.5f);
+
+	// A sequence far behind is a restarted sender
+	FBuffer Restarted;
+	MakeBuffer(Restarted);
+	CHECK(Restarted.Push(1000u, 1000000ull, 1.0, &Values[0]));
+	CHECK(Restarted.Push(1001u, 1100000ull, 1.1, &Values[1]));
+	CHECK(Restarted.Push(5u, 100000ull, 1.2, &Values[2]));
+	CHECK(Restarted.Num() == 1);
+	CHECK(Restarted.NumLate() == 0);
+}
+
+static void TestStampWrap()
+{
+	FBuffer Buffer;
+	float Values[] = { 0.0f, 1.0f, 2.0f };
+
+	// Stamps wrap from 2^64 - 50 ms to 50 ms: samples stay in order (times
+	// so large keep a few ms of precision only, so samples are not checked
+	// exactly)
+	MakeBuffer(Buffer);
+	CHECK(Buffer.Push(1u, ~0ull - 149999ull, 1.0, &Values[0]));
+	CHECK(Buffer.Push(2u, ~0ull - 49999ull, 1.1, &Values[1]));
+	CHECK(Buffer.Push(3u, 50000ull, 1.2, &Values[2]));
+	CHECK(!Buffer.Push(4u, ~0ull - 9999ull, 1.3, &Values[2]));
+	CHECK(Buffer.Num() == 3);
+	CHECK(Buffer.NumLate() == 1);
+	CHECK(std::fabs(SampleAt(Buffer, 1.05) - 0.5f) < 0.1f);
+	CHECK(std::fabs(SampleAt(Buffer, 1.15) - 1.5f) < 0.1f);
+}
+
+static void TestAbsoluteStamps()
+{
+	FBuffer Buffer;
+	float Values[] = { 0.0f, 1.0f, 2.0f };
+
+	// Sender stamps from a clock up for a day, local clock up for 1000 s,
+	// 10 ms of transit and 30 ms more of queuing for the second packet
+	MakeBuffer(Buffer);
+	CHECK(Buffer.Push(1u, 86400000000ull, 1000.01, &Values[0]));
+	CHECK(Buffer.Push(2u, 86400100000ull, 1000.14, &Values[1]));
+	CHECK(Buffer.Push(3u, 86400200000ull, 1000.21, &Values[2]));
+
+	// The offset is local minus sender time, so it maps local times to the
+	// absolute sender time of stamps and ball models
+	CHECK_NEAR(Buffer.ClockOffset(), 1000.01 - 86400.0);
+	CHECK_NEAR(1000.16 - Buffer.ClockOffset(), 86400.15);
+	CHECK_NEAR(SampleAt(Buffer, 1000.06), 0.5f);
+	CHECK_NEAR(SampleAt(Buffer, 1000.16), 1.5f);
+}
+
+int main()
+{
+	TestEmpty();
+	TestInterpolation();
+	TestPlayoutDelay();
+	TestExtrapolationClamp();
+	TestLateAndOutOfOrder();
+	TestCapacity();
+	TestSequenceWrap();
+	TestStampWrap();
+	TestAbsoluteStamps();
+
+	if (Failures)
+	{
+		std::printf("jitterbuffer_test: %d checks failed\n", Failures);
+		return 1;
+	}
+	std::printf("jitterbuffer_test: all checks passed\n");
+	return 0;
+}